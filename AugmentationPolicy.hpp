@@ -0,0 +1,77 @@
+#ifndef AUGMENTATION_POLICY_HPP
+#define AUGMENTATION_POLICY_HPP
+/* AugmentationPolicy.hpp
+ *
+ * Augmentation policies for BinarySearchTree. An augmentation stores a
+ * summary of each subtree in its root node and keeps it up to date as
+ * the tree changes. A policy is selected through the fifth template
+ * parameter of BinarySearchTree:
+ *
+ *   BinarySearchTree<int>                      // NoAugmentation (default)
+ *   BinarySearchTree<int, std::less<int>, AVLBalance, HeapNodeAllocator,
+ *                    OrderStatistics>
+ *
+ * Every policy provides
+ *
+ *   struct Node_data;
+ *   static const bool tracks_subtree_sizes;
+ *   template <typename Node> static void update(Node *node);
+ *   template <typename Node> static void assign_balanced(Node *node,
+ *                                                         size_t n);
+ *
+ * Node_data is a base class of every tree node and holds the summary.
+ * update() recomputes the summary of 'node' from its children, which
+ * must already be up to date, and does nothing for a null 'node'.
+ * assign_balanced() sets the summary of a node at the root of a
+ * perfectly balanced subtree of n nodes built by from_sorted(), before
+ * its children are linked. When tracks_subtree_sizes is true, the tree
+ * also refreshes every ancestor of a changed node, not just the ones its
+ * Balance policy restructures.
+ */
+
+#include <cstddef> //size_t
+
+// No summary at all. Node_data is empty, so nodes are no larger than
+// they would be without augmentation, and every hook compiles away.
+struct NoAugmentation {
+  struct Node_data { };
+
+  static const bool tracks_subtree_sizes = false;
+
+  template <typename Node>
+  static void update(Node *) { }
+
+  template <typename Node>
+  static void assign_balanced(Node *, size_t) { }
+};
+
+// Stores the number of nodes in each subtree, which lets the tree find
+// the k-th smallest element and the rank of an element in O(height).
+struct OrderStatistics {
+  struct Node_data {
+    size_t subtree_size = 1;
+  };
+
+  static const bool tracks_subtree_sizes = true;
+
+  // EFFECTS: Returns the number of nodes in the subtree rooted at 'node',
+  //          or 0 if 'node' is null.
+  template <typename Node>
+  static size_t size_of(const Node *node) {
+    return node == nullptr ? 0 : node->subtree_size;
+  }
+
+  template <typename Node>
+  static void update(Node *node) {
+    if (node != nullptr) {
+      node->subtree_size = 1 + size_of(node->left) + size_of(node->right);
+    }
+  }
+
+  template <typename Node>
+  static void assign_balanced(Node *node, size_t n) {
+    node->subtree_size = n;
+  }
+};
+
+#endif // AUGMENTATION_POLICY_HPP
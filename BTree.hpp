@@ -0,0 +1,1074 @@
+#ifndef B_TREE_HPP
+#define B_TREE_HPP
+/* BTree.hpp
+ *
+ * A B-tree with the same interface as BinarySearchTree, so that Map can
+ * use either one as its backend:
+ *
+ *   Map<std::string, int, std::less<std::string>, PoolNodeAllocator,
+ *       BTreeBackend> counts;
+ *
+ * Each node holds up to Max_keys elements in a contiguous array (and, if
+ * it is not a leaf, Max_keys + 1 child pointers). Wide nodes make the tree
+ * shallow, searching a node scans adjacent memory, and the per-element
+ * pointer overhead is a small fraction of that of a binary tree.
+ * Max_keys is a compile-time constant; values between 16 and 64 work
+ * well in practice. Unused slots of a node hold no element, so T need not
+ * be default-constructible, and elements are constructed in place.
+ *
+ * INVARIANTS: Like BinarySearchTree, a BTree holds no duplicates. The
+ * elements of every node are in strictly ascending order according to
+ * Compare, every element in the subtree children[i] of a node lies
+ * between elts[i - 1] and elts[i] of that node, every node but the root
+ * holds at least (Max_keys - 1) / 2 elements, and all leaves are at the
+ * same depth.
+ *
+ * Insertion splits full nodes on the way down, so it never has to walk
+ * back up the tree. No operation recurses.
+ */
+
+#include <algorithm>  //lower_bound, upper_bound, rotate, fill
+#include <cassert>    //assert
+#include <cstddef>    //size_t
+#include <functional> //less
+#include <iostream>   //ostream
+#include <iterator>   //forward_iterator_tag
+#include <new>        //placement new, launder
+#include <type_traits> //is_trivially_destructible
+#include <utility>    //pair, move, forward
+#include "NodeAllocator.hpp"
+#include "FrozenSearchTree.hpp"
+#include "IteratorRange.hpp"
+
+template <typename T,
+          typename Compare=std::less<T>,
+          int Max_keys=32,
+          template <typename> class NodeAllocator=HeapNodeAllocator
+         >
+class BTree {
+
+  static_assert(Max_keys >= 3 && Max_keys <= 65535,
+                "BTree nodes must hold between 3 and 65535 elements");
+
+private:
+
+  struct Internal_node;
+
+  // A leaf stores up to Max_keys elements in ascending order, a pointer
+  // to its parent (null for the root) and its position among the
+  // parent's children. Only the first count slots of 'storage' hold
+  // elements; they are constructed and destroyed individually.
+  struct Leaf_node {
+    Leaf_node()
+      : parent(nullptr), parent_index(0), count(0), is_leaf(true) { }
+
+    Leaf_node(const Leaf_node &) = delete;
+    Leaf_node &operator=(const Leaf_node &) = delete;
+
+    ~Leaf_node() {
+      for (int i = count; i > 0; --i) {
+        elts()[i - 1].~T();
+      }
+    }
+
+    T *elts() {
+      return std::launder(reinterpret_cast<T *>(storage));
+    }
+
+    const T *elts() const {
+      return std::launder(reinterpret_cast<const T *>(storage));
+    }
+
+    Internal_node *parent;
+    unsigned short parent_index;
+    unsigned short count;
+    bool is_leaf;
+    alignas(T) unsigned char storage[sizeof(T) * Max_keys];
+  };
+
+  // An internal node also stores count + 1 children. children[i] holds
+  // the elements between elts[i - 1] and elts[i].
+  struct Internal_node : Leaf_node {
+    Internal_node() {
+      this->is_leaf = false;
+      std::fill(children, children + Max_keys + 1, nullptr);
+    }
+
+    Leaf_node *children[Max_keys + 1];
+  };
+
+  using Node = Leaf_node;
+
+public:
+
+  // Default constructor
+  BTree()
+    : root(nullptr), elt_count(0), levels(0) { }
+
+  // Copy constructor
+  BTree(const BTree &other)
+    : root(nullptr), elt_count(0), levels(0) {
+    root = copy_nodes(other.root);
+    elt_count = other.elt_count;
+    levels = other.levels;
+  }
+
+  // Move constructor
+  // EFFECTS: Takes over the nodes of 'other' in constant time, leaving
+  //          'other' empty.
+  BTree(BTree &&other) noexcept
+    : root(other.root), elt_count(other.elt_count), levels(other.levels),
+      less(std::move(other.less)), leaf_alloc(std::move(other.leaf_alloc)),
+      internal_alloc(std::move(other.internal_alloc)) {
+    other.root = nullptr;
+    other.elt_count = 0;
+    other.levels = 0;
+  }
+
+  // Assignment operator
+  BTree &operator=(const BTree &rhs) {
+    if (this == &rhs) {
+      return *this;
+    }
+    destroy_all_nodes();
+    root = copy_nodes(rhs.root);
+    elt_count = rhs.elt_count;
+    levels = rhs.levels;
+    return *this;
+  }
+
+  // Move assignment operator
+  BTree &operator=(BTree &&rhs) noexcept {
+    if (this == &rhs) {
+      return *this;
+    }
+    destroy_all_nodes();
+    root = rhs.root;
+    elt_count = rhs.elt_count;
+    levels = rhs.levels;
+    less = std::move(rhs.less);
+    leaf_alloc = std::move(rhs.leaf_alloc);
+    internal_alloc = std::move(rhs.internal_alloc);
+    rhs.root = nullptr;
+    rhs.elt_count = 0;
+    rhs.levels = 0;
+    return *this;
+  }
+
+  // Destructor
+  ~BTree() {
+    destroy_all_nodes();
+  }
+
+  // EFFECTS: Returns whether this BTree is empty.
+  bool empty() const {
+    return root == nullptr;
+  }
+
+  // EFFECTS: Returns the height of the tree, which is the number of
+  //          nodes on any path from the root to a leaf.
+  size_t height() const {
+    return static_cast<size_t>(levels);
+  }
+
+  // EFFECTS: Returns the number of elements in this BTree.
+  size_t size() const {
+    return elt_count;
+  }
+
+  class Iterator {
+    // OVERVIEW: Iterates over the elements in ascending order. An
+    //           Iterator is a node and a position within it; advancing
+    //           it follows child and parent links without comparing
+    //           elements.
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = T *;
+    using reference = T &;
+
+    Iterator()
+      : node(nullptr), index(0) { }
+
+    // WARNING: As with BinarySearchTree, modifying an element through
+    //          an iterator must not change how it compares.
+    T &operator*() const {
+      return node->elts()[index];
+    }
+
+    T *operator->() const {
+      return &node->elts()[index];
+    }
+
+    // Prefix ++
+    Iterator &operator++() {
+      if (!node->is_leaf) {
+        // the next element is the first one in the subtree to the right
+        node = leftmost_leaf(child_of(node, index + 1));
+        index = 0;
+      }
+      else if (index + 1 < node->count) {
+        ++index;
+      }
+      else {
+        // climb out of every subtree we have finished
+        while (node->parent != nullptr &&
+               node->parent_index == node->parent->count) {
+          node = node->parent;
+        }
+        index = node->parent_index;
+        node = node->parent;
+        if (node == nullptr) {
+          index = 0;
+        }
+      }
+      return *this;
+    }
+
+    // Postfix ++
+    Iterator operator++(int) {
+      Iterator result(*this);
+      ++(*this);
+      return result;
+    }
+
+    bool operator==(const Iterator &rhs) const {
+      return node == rhs.node && index == rhs.index;
+    }
+
+    bool operator!=(const Iterator &rhs) const {
+      return !(*this == rhs);
+    }
+
+  private:
+    friend class BTree;
+
+    Node *node;
+    int index;
+
+    Iterator(Node *node_in, int index_in)
+      : node(node_in), index(index_in) { }
+  }; // BTree::Iterator
+
+  // EFFECTS: Returns an iterator to the first element.
+  Iterator begin() const {
+    return min_element();
+  }
+
+  // EFFECTS: Returns an iterator to past-the-end.
+  Iterator end() const {
+    return Iterator();
+  }
+
+  // EFFECTS: Returns an Iterator to the minimum element, or an end
+  //          Iterator if the tree is empty.
+  Iterator min_element() const {
+    if (root == nullptr) {
+      return end();
+    }
+    return Iterator(leftmost_leaf(root), 0);
+  }
+
+  // EFFECTS: Returns an Iterator to the maximum element, or an end
+  //          Iterator if the tree is empty.
+  Iterator max_element() const {
+    if (root == nullptr) {
+      return end();
+    }
+    Node *node = root;
+    while (!node->is_leaf) {
+      node = child_of(node, node->count);
+    }
+    return Iterator(node, node->count - 1);
+  }
+
+  // EFFECTS: Returns an Iterator to the minimum element greater than the
+  //          given value, or an end Iterator if there is none.
+  template <typename Key>
+  Iterator min_greater_than(const Key &value) const {
+    Iterator result;
+    Node *node = root;
+    while (node != nullptr) {
+      int pos = upper_bound_in(node, value);
+      if (pos < node->count) {
+        result = Iterator(node, pos);
+      }
+      node = node->is_leaf ? nullptr : child_of(node, pos);
+    }
+    return result;
+  }
+
+  // EFFECTS: Returns an Iterator to the first element that is not less
+  //          than key, or an end Iterator if there is none.
+  template <typename Key>
+  Iterator lower_bound(const Key &key) const {
+    Iterator result;
+    Node *node = root;
+    while (node != nullptr) {
+      int pos = lower_bound_in(node, key);
+      if (pos < node->count) {
+        result = Iterator(node, pos);
+        if (!less(key, node->elts()[pos])) {
+          // an equivalent element: nothing smaller qualifies
+          break;
+        }
+      }
+      node = node->is_leaf ? nullptr : child_of(node, pos);
+    }
+    return result;
+  }
+
+  // EFFECTS: Returns an Iterator to the first element that is greater
+  //          than key, or an end Iterator if there is none.
+  template <typename Key>
+  Iterator upper_bound(const Key &key) const {
+    return min_greater_than(key);
+  }
+
+  // EFFECTS: Returns the range of elements equivalent to key, which holds
+  //          at most one element.
+  template <typename Key>
+  std::pair<Iterator, Iterator> equal_range(const Key &key) const {
+    return unique_equal_range(lower_bound(key), end(), key, less);
+  }
+
+  // EFFECTS: Returns a view of the elements that are not less than lo and
+  //          less than hi, in ascending order.
+  template <typename Key>
+  IteratorRange<Iterator> range(const Key &lo, const Key &hi) const {
+    return bounded_range(lower_bound(lo), lower_bound(hi), end(), less);
+  }
+
+  // EFFECTS: Searches this tree for an element equivalent to query,
+  //          which may be of any type Compare can compare against T.
+  //          Returns an iterator to it, or an end iterator if not found.
+  template <typename Key>
+  Iterator find(const Key &query) const {
+    Node *node = root;
+    while (node != nullptr) {
+      int pos = lower_bound_in(node, query);
+      if (pos < node->count && !less(query, node->elts()[pos])) {
+        return Iterator(node, pos);
+      }
+      node = node->is_leaf ? nullptr : child_of(node, pos);
+    }
+    return end();
+  }
+
+  // REQUIRES: The given item is not already contained in this BTree
+  // MODIFIES: this BTree
+  // EFFECTS : Inserts a copy of item and returns an iterator to it.
+  Iterator insert(const T &item) {
+    std::pair<Iterator, bool> result = try_emplace(item, item);
+    assert(result.second);
+    return result.first;
+  }
+
+  // REQUIRES: The given item is not already contained in this BTree
+  // MODIFIES: this BTree
+  // EFFECTS : Same as above, but moves item into the tree.
+  Iterator insert(T &&item) {
+    std::pair<Iterator, bool> result = try_emplace(item, std::move(item));
+    assert(result.second);
+    return result.first;
+  }
+
+  // MODIFIES: this BTree
+  // EFFECTS : Constructs an element from args and inserts it unless an
+  //           equivalent element is already contained. Returns an iterator
+  //           to the new or existing element along with whether the
+  //           insertion took place.
+  // NOTE:     The element must exist before the search for its position,
+  //           so it is built as a temporary and then moved into place. Use
+  //           try_emplace to construct it directly in its node.
+  template <typename... Args>
+  std::pair<Iterator, bool> emplace(Args&&... args) {
+    T item(std::forward<Args>(args)...);
+    return try_emplace(item, std::move(item));
+  }
+
+  // MODIFIES: this BTree
+  // EFFECTS : Inserts item unless an equivalent element is already
+  //           contained, and returns an iterator to the new or existing
+  //           element.
+  // NOTE:     Provided so that Map can offer hinted insertion over any
+  //           backend. A B-tree descent touches only O(log n / log
+  //           Max_keys) nodes, so the hint is not used.
+  Iterator insert(Iterator, const T &item) {
+    return try_emplace(item, item).first;
+  }
+
+  // MODIFIES: this BTree
+  // EFFECTS : Same as above, but moves item into the tree if it is
+  //           inserted.
+  Iterator insert(Iterator, T &&item) {
+    return try_emplace(item, std::move(item)).first;
+  }
+
+  // MODIFIES: this BTree
+  // EFFECTS : Same as emplace(args...), but returns only the iterator.
+  //           The hint is not used.
+  template <typename... Args>
+  Iterator emplace_hint(Iterator, Args&&... args) {
+    return emplace(std::forward<Args>(args)...).first;
+  }
+
+  // MODIFIES: this BTree
+  // EFFECTS : Searches for an element equivalent to key. If one is found,
+  //           returns an iterator to it along with false, and the tree is
+  //           left untouched. Otherwise constructs an element from args in
+  //           place and returns an iterator to it along with true. Nodes
+  //           are split only when the leaf it belongs in is full.
+  // REQUIRES: The element constructed from args is equivalent to key.
+  template <typename Key, typename... Args>
+  std::pair<Iterator, bool> try_emplace(const Key &key, Args&&... args) {
+    // a read-only descent first, so that a failed insert is a lookup
+    Node *node = root;
+    while (node != nullptr) {
+      int pos = lower_bound_in(node, key);
+      if (pos < node->count && !less(key, node->elts()[pos])) {
+        return std::make_pair(Iterator(node, pos), false);
+      }
+      if (!node->is_leaf) {
+        node = child_of(node, pos);
+      }
+      else if (node->count < Max_keys) {
+        insert_into_leaf(Iterator(node, pos), std::forward<Args>(args)...);
+        return std::make_pair(Iterator(node, pos), true);
+      }
+      else {
+        break;
+      }
+    }
+
+    // the leaf is full or the tree is empty: descend again, splitting
+    bool found = false;
+    Iterator slot = descend_for_insert(found, [&](const Node *node) {
+      int pos = lower_bound_in(node, key);
+      bool equal = pos < node->count && !less(key, node->elts()[pos]);
+      return std::make_pair(pos, equal);
+    });
+    if (found) {
+      return std::make_pair(slot, false);
+    }
+    insert_into_leaf(slot, std::forward<Args>(args)...);
+    return std::make_pair(slot, true);
+  }
+
+  // REQUIRES: [first, last) is a forward range whose elements are in
+  //           strictly ascending order according to Compare
+  // EFFECTS : Returns a BTree holding the elements of [first, last), built
+  //           bottom-up in linear time: each element is appended to the
+  //           rightmost node of the lowest level that has room, without
+  //           any comparisons, and the rightmost path is topped up from
+  //           its left siblings at the end. If 'verify' is true, first
+  //           checks the requirement and throws std::invalid_argument if
+  //           it does not hold.
+  template <typename ForwardIt>
+  static BTree from_sorted(ForwardIt first, ForwardIt last,
+                           bool verify = true) {
+    BTree result;
+    if (verify) {
+      require_strictly_ascending(first, last, result.less);
+    }
+    Node *last_leaf = nullptr;
+    for (; first != last; ++first) {
+      last_leaf = result.append_greatest(last_leaf, *first);
+    }
+    result.fill_right_spine();
+    return result;
+  }
+
+  // EFFECTS: Returns an immutable snapshot of this tree with its elements
+  //          laid out contiguously (see FrozenSearchTree.hpp).
+  FrozenSearchTree<T, Compare> freeze() const {
+    return FrozenSearchTree<T, Compare>(begin(), end(), size());
+  }
+
+  // REQUIRES: pos points to an element of this tree
+  // MODIFIES: this BTree
+  // EFFECTS : Removes the element at pos and returns an Iterator to the
+  //           element that followed it. Nodes left with too few elements
+  //           borrow from a sibling or merge with one, and emptied nodes
+  //           go back to the allocator.
+  // WARNING : Unlike BinarySearchTree, elements move between nodes, so
+  //           every other Iterator into this tree is invalidated.
+  Iterator erase(Iterator pos) {
+    Node *leaf = pos.node;
+    int removed = pos.index;
+    Iterator next;
+    if (!leaf->is_leaf) {
+      // replace the element with its successor, the first element of
+      // the leftmost leaf to its right, and remove that instead
+      leaf = leftmost_leaf(child_of(pos.node, pos.index + 1));
+      pos.node->elts()[pos.index] = std::move(leaf->elts()[0]);
+      next = pos;
+      removed = 0;
+    }
+    else {
+      next = std::next(pos);
+      if (next.node == leaf) {
+        --next.index;
+      }
+    }
+    erase_at(leaf, removed);
+    --elt_count;
+    fix_underflow(leaf, next);
+    return next;
+  }
+
+  // MODIFIES: this BTree
+  // EFFECTS : Removes the elements in [first, last) and returns an
+  //           Iterator to the element that followed them.
+  Iterator erase(Iterator first, Iterator last) {
+    // 'last' is invalidated by the first erase, so count instead
+    for (std::ptrdiff_t n = std::distance(first, last); n > 0; --n) {
+      first = erase(first);
+    }
+    return first;
+  }
+
+  // MODIFIES: this BTree
+  // EFFECTS : Removes the element equivalent to key, if there is one,
+  //           and returns the number of elements removed (0 or 1).
+  template <typename Key>
+  size_t erase(const Key &key) {
+    Iterator pos = find(key);
+    if (pos == end()) {
+      return 0;
+    }
+    erase(pos);
+    return 1;
+  }
+
+  // MODIFIES: this BTree
+  // EFFECTS : Removes every element. The nodes are handed back to the
+  //           allocators one by one, so a pool allocator keeps its
+  //           storage for the tree to grow into again.
+  void clear() {
+    destroy_nodes(root);
+    root = nullptr;
+    elt_count = 0;
+    levels = 0;
+  }
+
+  // EFFECTS: Returns whether every element compares strictly less than
+  //          the next one in ascending order.
+  bool check_sorting_invariant() const {
+    return is_strictly_ascending(begin(), end(), less);
+  }
+
+  // EFFECTS: Prints each element to os in ascending order, each followed
+  //          by a space.
+  void traverse_inorder(std::ostream &os) const {
+    for (Iterator it = begin(); it != end(); ++it) {
+      os << *it << " ";
+    }
+  }
+
+private:
+
+  // DATA REPRESENTATION
+  Node *root;
+  size_t elt_count;
+  int levels;
+  Compare less;
+
+  // Leaves and internal nodes have different sizes, so each kind has its
+  // own allocator.
+  NodeAllocator<Leaf_node> leaf_alloc;
+  NodeAllocator<Internal_node> internal_alloc;
+
+  // REQUIRES: node is an internal node
+  // EFFECTS : Returns the i-th child of node.
+  static Node *child_of(const Node *node, int i) {
+    return static_cast<const Internal_node *>(node)->children[i];
+  }
+
+  // EFFECTS : Returns the leftmost leaf of the subtree rooted at node.
+  static Node *leftmost_leaf(Node *node) {
+    while (!node->is_leaf) {
+      node = child_of(node, 0);
+    }
+    return node;
+  }
+
+  // EFFECTS : Returns the position of the first element in node that is
+  //           not less than key.
+  template <typename Key>
+  int lower_bound_in(const Node *node, const Key &key) const {
+    const T *elts = node->elts();
+    const T *pos = std::lower_bound(elts, elts + node->count, key,
+                                    [this](const T &elt, const Key &k) {
+                                      return less(elt, k);
+                                    });
+    return static_cast<int>(pos - elts);
+  }
+
+  // EFFECTS : Returns the position of the first element in node that is
+  //           greater than key.
+  template <typename Key>
+  int upper_bound_in(const Node *node, const Key &key) const {
+    const T *elts = node->elts();
+    const T *pos = std::upper_bound(elts, elts + node->count, key,
+                                    [this](const Key &k, const T &elt) {
+                                      return less(k, elt);
+                                    });
+    return static_cast<int>(pos - elts);
+  }
+
+  // MODIFIES: this BTree
+  // EFFECTS : Descends from the root to where an element belongs, as
+  //           directed by locate(node), which returns the position of the
+  //           element in 'node' or of the child to descend into, and
+  //           whether the element itself was found there. Every full node
+  //           met on the way is split first, so the returned leaf has room
+  //           for one more element. Sets 'found' and returns the position.
+  template <typename Locate>
+  Iterator descend_for_insert(bool &found, Locate locate) {
+    if (root == nullptr) {
+      root = leaf_alloc.create();
+      levels = 1;
+    }
+    else if (root->count == Max_keys) {
+      Internal_node *new_root = internal_alloc.create();
+      new_root->children[0] = root;
+      root->parent = new_root;
+      root->parent_index = 0;
+      root = new_root;
+      ++levels;
+      split_child(new_root, 0);
+    }
+
+    Node *node = root;
+    while (true) {
+      std::pair<int, bool> located = locate(node);
+      if (located.second || node->is_leaf) {
+        found = located.second;
+        return Iterator(node, located.first);
+      }
+      Node *child = child_of(node, located.first);
+      if (child->count == Max_keys) {
+        // the median moves up into 'node'; look again from there
+        split_child(static_cast<Internal_node *>(node), located.first);
+      }
+      else {
+        node = child;
+      }
+    }
+  }
+
+  // REQUIRES: parent is not full and its i-th child is full
+  // MODIFIES: parent, its i-th child
+  // EFFECTS : Moves the upper half of the child into a new sibling that
+  //           becomes child i + 1, and its median element into parent at
+  //           position i.
+  void split_child(Internal_node *parent, int i) {
+    Node *child = parent->children[i];
+    const int mid = Max_keys / 2;
+    const int moved = Max_keys - mid - 1;
+
+    Node *sibling;
+    if (child->is_leaf) {
+      sibling = leaf_alloc.create();
+    }
+    else {
+      Internal_node *inner = internal_alloc.create();
+      Internal_node *full = static_cast<Internal_node *>(child);
+      for (int c = 0; c <= moved; ++c) {
+        inner->children[c] = full->children[mid + 1 + c];
+        adopt(inner, c);
+      }
+      sibling = inner;
+    }
+    for (int j = 0; j < moved; ++j) {
+      insert_at(sibling, j, std::move(child->elts()[mid + 1 + j]));
+    }
+
+    // open a gap at position i in parent
+    for (int c = parent->count; c > i; --c) {
+      parent->children[c + 1] = parent->children[c];
+      adopt(parent, c + 1);
+    }
+    insert_at(parent, i, std::move(child->elts()[mid]));
+    parent->children[i + 1] = sibling;
+    adopt(parent, i + 1);
+    while (child->count > mid) {
+      erase_at(child, child->count - 1);
+    }
+  }
+
+  // REQUIRES: value is greater than every element, and last_leaf is the
+  //           rightmost leaf (null if the tree is empty). Every node off
+  //           the rightmost path is full.
+  // MODIFIES: this BTree
+  // EFFECTS : Appends value to the rightmost leaf if it has room, and
+  //           otherwise to the lowest rightmost node above it that does
+  //           (a new root if there is none), under which it hangs a new,
+  //           empty rightmost path. Returns the rightmost leaf. Nodes on
+  //           the rightmost path may be left underfull; see
+  //           fill_right_spine.
+  Node *append_greatest(Node *last_leaf, const T &value) {
+    if (last_leaf == nullptr) {
+      root = last_leaf = leaf_alloc.create();
+      levels = 1;
+    }
+    if (last_leaf->count < Max_keys) {
+      insert_into_leaf(Iterator(last_leaf, last_leaf->count), value);
+      return last_leaf;
+    }
+
+    // climb past the full nodes, counting the levels below 'node'
+    Internal_node *node = last_leaf->parent;
+    int below = 1;
+    while (node != nullptr && node->count == Max_keys) {
+      node = node->parent;
+      ++below;
+    }
+    if (node == nullptr) {
+      node = internal_alloc.create();
+      node->children[0] = root;
+      adopt(node, 0);
+      root = node;
+      ++levels;
+    }
+
+    insert_at(node, node->count, value);
+    ++elt_count;
+    while (--below > 0) {
+      Internal_node *inner = internal_alloc.create();
+      node->children[node->count] = inner;
+      adopt(node, node->count);
+      node = inner;
+    }
+    last_leaf = leaf_alloc.create();
+    node->children[node->count] = last_leaf;
+    adopt(node, node->count);
+    return last_leaf;
+  }
+
+  // REQUIRES: every node off the rightmost path is full
+  // MODIFIES: this BTree
+  // EFFECTS : Brings each node on the rightmost path below the root up to
+  //           the minimum occupancy by rotating elements in from its left
+  //           sibling, working down from the root. A left sibling always
+  //           exists, as the parent was topped up first, and keeps at
+  //           least Max_keys - (Max_keys - 1) / 2 elements.
+  void fill_right_spine() {
+    const int min_keys = (Max_keys - 1) / 2;
+    Iterator unused;
+    for (Node *node = root; node != nullptr && !node->is_leaf;) {
+      Internal_node *parent = static_cast<Internal_node *>(node);
+      node = parent->children[parent->count];
+      while (node->count < min_keys) {
+        rotate_right(parent, parent->count - 1, unused);
+      }
+    }
+  }
+
+  // MODIFIES: this BTree, cursor
+  // EFFECTS : Restores the minimum occupancy of 'node' and its ancestors
+  //           after an element was removed from it, then shrinks the tree
+  //           by one level if the root was emptied. 'cursor' is kept
+  //           pointing at the same element as elements move.
+  void fix_underflow(Node *node, Iterator &cursor) {
+    const int min_keys = (Max_keys - 1) / 2;
+    while (node != root && node->count < min_keys) {
+      Internal_node *parent = node->parent;
+      int i = node->parent_index;
+      if (i > 0 && parent->children[i - 1]->count > min_keys) {
+        rotate_right(parent, i - 1, cursor);
+        return;
+      }
+      if (i < parent->count && parent->children[i + 1]->count > min_keys) {
+        rotate_left(parent, i, cursor);
+        return;
+      }
+      merge_children(parent, i > 0 ? i - 1 : i, cursor);
+      node = parent;
+    }
+
+    if (root->count == 0) {
+      Node *old_root = root;
+      if (root->is_leaf) {
+        root = nullptr;
+        leaf_alloc.destroy(old_root);
+      }
+      else {
+        root = child_of(old_root, 0);
+        root->parent = nullptr;
+        root->parent_index = 0;
+        internal_alloc.destroy(static_cast<Internal_node *>(old_root));
+      }
+      --levels;
+    }
+  }
+
+  // MODIFIES: parent and its children k and k + 1, cursor
+  // EFFECTS : Moves the last element of child k up into parent and the
+  //           separating element of parent down to the front of child
+  //           k + 1, along with the last child of child k if any.
+  void rotate_right(Internal_node *parent, int k, Iterator &cursor) {
+    Node *left = parent->children[k];
+    Node *right = parent->children[k + 1];
+    if (cursor.node == right) {
+      ++cursor.index;
+    }
+    else if (cursor == Iterator(parent, k)) {
+      cursor = Iterator(right, 0);
+    }
+    else if (cursor == Iterator(left, left->count - 1)) {
+      cursor = Iterator(parent, k);
+    }
+
+    if (!right->is_leaf) {
+      Internal_node *to = static_cast<Internal_node *>(right);
+      Internal_node *from = static_cast<Internal_node *>(left);
+      for (int c = right->count; c >= 0; --c) {
+        to->children[c + 1] = to->children[c];
+        adopt(to, c + 1);
+      }
+      to->children[0] = from->children[left->count];
+      from->children[left->count] = nullptr;
+      adopt(to, 0);
+    }
+    insert_at(right, 0, std::move(parent->elts()[k]));
+    parent->elts()[k] = std::move(left->elts()[left->count - 1]);
+    erase_at(left, left->count - 1);
+  }
+
+  // MODIFIES: parent and its children k and k + 1, cursor
+  // EFFECTS : Mirror image of rotate_right: moves the first element of
+  //           child k + 1 up into parent and the separating element down
+  //           to the end of child k.
+  void rotate_left(Internal_node *parent, int k, Iterator &cursor) {
+    Node *left = parent->children[k];
+    Node *right = parent->children[k + 1];
+    if (cursor == Iterator(parent, k)) {
+      cursor = Iterator(left, left->count);
+    }
+    else if (cursor == Iterator(right, 0)) {
+      cursor = Iterator(parent, k);
+    }
+    else if (cursor.node == right) {
+      --cursor.index;
+    }
+
+    if (!right->is_leaf) {
+      Internal_node *to = static_cast<Internal_node *>(left);
+      Internal_node *from = static_cast<Internal_node *>(right);
+      to->children[left->count + 1] = from->children[0];
+      adopt(to, left->count + 1);
+      for (int c = 0; c < right->count; ++c) {
+        from->children[c] = from->children[c + 1];
+        adopt(from, c);
+      }
+      from->children[right->count] = nullptr;
+    }
+    insert_at(left, left->count, std::move(parent->elts()[k]));
+    parent->elts()[k] = std::move(right->elts()[0]);
+    erase_at(right, 0);
+  }
+
+  // MODIFIES: this BTree, cursor
+  // EFFECTS : Appends the separating element k of parent and all of
+  //           child k + 1 to child k, removes them from parent and
+  //           destroys child k + 1.
+  void merge_children(Internal_node *parent, int k, Iterator &cursor) {
+    Node *left = parent->children[k];
+    Node *right = parent->children[k + 1];
+    const int offset = left->count + 1;
+    if (cursor == Iterator(parent, k)) {
+      cursor = Iterator(left, left->count);
+    }
+    else if (cursor.node == parent && cursor.index > k) {
+      --cursor.index;
+    }
+    else if (cursor.node == right) {
+      cursor = Iterator(left, offset + cursor.index);
+    }
+
+    if (!left->is_leaf) {
+      Internal_node *to = static_cast<Internal_node *>(left);
+      Internal_node *from = static_cast<Internal_node *>(right);
+      for (int c = 0; c <= right->count; ++c) {
+        to->children[offset + c] = from->children[c];
+        adopt(to, offset + c);
+      }
+    }
+    insert_at(left, left->count, std::move(parent->elts()[k]));
+    for (int j = 0; j < right->count; ++j) {
+      insert_at(left, left->count, std::move(right->elts()[j]));
+    }
+
+    for (int c = k + 1; c < parent->count; ++c) {
+      parent->children[c] = parent->children[c + 1];
+      adopt(parent, c);
+    }
+    parent->children[parent->count] = nullptr;
+    erase_at(parent, k);
+
+    if (right->is_leaf) {
+      leaf_alloc.destroy(right);
+    }
+    else {
+      internal_alloc.destroy(static_cast<Internal_node *>(right));
+    }
+  }
+
+  // MODIFIES: parent->children[c]
+  // EFFECTS : Records that parent->children[c] is the c-th child of parent.
+  static void adopt(Internal_node *parent, int c) {
+    parent->children[c]->parent = parent;
+    parent->children[c]->parent_index = static_cast<unsigned short>(c);
+  }
+
+  // REQUIRES: slot is a position in a leaf that is not full
+  // MODIFIES: this BTree
+  // EFFECTS : Constructs the new element from args at slot, shifting the
+  //           elements from slot onwards up by one.
+  template <typename... Args>
+  void insert_into_leaf(Iterator slot, Args&&... args) {
+    insert_at(slot.node, slot.index, std::forward<Args>(args)...);
+    ++elt_count;
+  }
+
+  // REQUIRES: node is not full and 0 <= pos <= node->count
+  // MODIFIES: node
+  // EFFECTS : Constructs an element from args in the first free slot of
+  //           node and rotates it down to position pos. If construction
+  //           throws, node is unchanged.
+  template <typename... Args>
+  static void insert_at(Node *node, int pos, Args&&... args) {
+    T *elts = node->elts();
+    ::new (static_cast<void *>(elts + node->count))
+      T(std::forward<Args>(args)...);
+    ++node->count;
+    std::rotate(elts + pos, elts + node->count - 1, elts + node->count);
+  }
+
+  // REQUIRES: 0 <= pos < node->count
+  // MODIFIES: node
+  // EFFECTS : Shifts the elements after pos down by one and destroys
+  //           the last one, whose slot is then free.
+  static void erase_at(Node *node, int pos) {
+    T *elts = node->elts();
+    std::move(elts + pos + 1, elts + node->count, elts + pos);
+    --node->count;
+    elts[node->count].~T();
+  }
+
+  // EFFECTS : Returns a new node holding copies of the elements of node,
+  //           with no parent and no children yet.
+  Node *copy_one_node(const Node *node) {
+    Node *copy = node->is_leaf ? leaf_alloc.create()
+                               : static_cast<Node *>(internal_alloc.create());
+    try {
+      for (int j = 0; j < node->count; ++j) {
+        insert_at(copy, j, node->elts()[j]);
+      }
+    }
+    catch (...) {
+      destroy_nodes(copy);
+      throw;
+    }
+    return copy;
+  }
+
+  // EFFECTS : Returns a copy of the tree rooted at node, built by walking
+  //           both trees in lock step. If copying throws, the partial copy
+  //           is destroyed first.
+  Node *copy_nodes(const Node *node) {
+    if (node == nullptr) {
+      return nullptr;
+    }
+    Node *copy_root = copy_one_node(node);
+    try {
+      const Node *src = node;
+      Node *dst = copy_root;
+      int next_child = 0;
+      while (true) {
+        if (!src->is_leaf && next_child <= src->count) {
+          Internal_node *parent = static_cast<Internal_node *>(dst);
+          parent->children[next_child] = copy_one_node(child_of(src, next_child));
+          adopt(parent, next_child);
+          src = child_of(src, next_child);
+          dst = parent->children[next_child];
+          next_child = 0;
+        }
+        else if (src == node) {
+          return copy_root;
+        }
+        else {
+          next_child = src->parent_index + 1;
+          src = src->parent;
+          dst = dst->parent;
+        }
+      }
+    }
+    catch (...) {
+      destroy_nodes(copy_root);
+      throw;
+    }
+  }
+
+  // EFFECTS : Destroys every node of the tree rooted at node, children
+  //           before parents. Nodes whose children have not all been
+  //           created yet (during a failed copy) are handled as well.
+  void destroy_nodes(Node *node) {
+    int next_child = 0;
+    while (node != nullptr) {
+      if (!node->is_leaf && next_child <= node->count &&
+          child_of(node, next_child) != nullptr) {
+        node = child_of(node, next_child);
+        next_child = 0;
+        continue;
+      }
+      Internal_node *parent = node->parent;
+      next_child = node->parent_index + 1;
+      if (node->is_leaf) {
+        leaf_alloc.destroy(node);
+      }
+      else {
+        internal_alloc.destroy(static_cast<Internal_node *>(node));
+      }
+      node = parent;
+    }
+  }
+
+  // MODIFIES: this BTree
+  // EFFECTS : Destroys every node and leaves the tree empty.
+  void destroy_all_nodes() {
+    bool bulk = NodeAllocator<Leaf_node>::releases_in_bulk &&
+                NodeAllocator<Internal_node>::releases_in_bulk;
+    if (!bulk || !std::is_trivially_destructible<T>::value) {
+      destroy_nodes(root);
+    }
+    leaf_alloc.release_all();
+    internal_alloc.release_all();
+    root = nullptr;
+    elt_count = 0;
+    levels = 0;
+  }
+};
+
+// MODIFIES: os
+// EFFECTS : Prints the elements in ascending order, in the same format as
+//           for a BinarySearchTree. Returns os.
+template <typename T, typename Compare, int Max_keys,
+          template <typename> class NodeAllocator>
+std::ostream &operator<<(std::ostream &os,
+                         const BTree<T, Compare, Max_keys,
+                                     NodeAllocator> &tree) {
+  os << "[ ";
+  tree.traverse_inorder(os);
+  return os << "]";
+}
+
+// Map backend (see Map.hpp): a BTree with the default node width
+template <typename T, typename Compare,
+          template <typename> class NodeAllocator>
+using BTreeBackend = BTree<T, Compare, 32, NodeAllocator>;
+
+#endif // B_TREE_HPP
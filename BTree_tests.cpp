@@ -0,0 +1,416 @@
+#include "BTree.hpp"
+#include "unit_test_framework.hpp"
+#include <algorithm>
+#include <forward_list>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Narrow nodes split after only a few insertions, so small tests still
+// build trees several levels deep.
+using Narrow_tree = BTree<int, std::less<int>, 3>;
+
+TEST(empty_tree) {
+  BTree<int> tree;
+  ASSERT_TRUE(tree.empty());
+  ASSERT_EQUAL(tree.size(), 0);
+  ASSERT_EQUAL(tree.height(), 0);
+  ASSERT_TRUE(tree.begin() == tree.end());
+  ASSERT_TRUE(tree.find(3) == tree.end());
+  ASSERT_TRUE(tree.min_element() == tree.end());
+  ASSERT_TRUE(tree.max_element() == tree.end());
+  ASSERT_TRUE(tree.min_greater_than(3) == tree.end());
+  ASSERT_TRUE(tree.check_sorting_invariant());
+}
+
+TEST(insert_find_and_iterate) {
+  for (int n : {1, 2, 3, 4, 10, 100, 1000}) {
+    Narrow_tree tree;
+    for (int i = 0; i < n; ++i) {
+      int key = (i * 37) % n * 2;
+      ASSERT_EQUAL(*tree.insert(key), key);
+    }
+    ASSERT_EQUAL(tree.size(), n);
+    ASSERT_TRUE(tree.check_sorting_invariant());
+
+    int expected = 0;
+    for (int elt : tree) {
+      ASSERT_EQUAL(elt, expected);
+      expected += 2;
+    }
+    ASSERT_EQUAL(expected, 2 * n);
+
+    for (int i = -1; i <= 2 * n; ++i) {
+      auto it = tree.find(i);
+      if (i >= 0 && i % 2 == 0 && i < 2 * n) {
+        ASSERT_EQUAL(*it, i);
+      }
+      else {
+        ASSERT_TRUE(it == tree.end());
+      }
+    }
+    ASSERT_EQUAL(*tree.min_element(), 0);
+    ASSERT_EQUAL(*tree.max_element(), 2 * n - 2);
+  }
+}
+
+TEST(min_greater_than) {
+  Narrow_tree tree;
+  for (int i = 0; i < 50; ++i) {
+    tree.insert(i * 2);
+  }
+  ASSERT_EQUAL(*tree.min_greater_than(-5), 0);
+  for (int i = 0; i < 98; ++i) {
+    ASSERT_EQUAL(*tree.min_greater_than(i), i % 2 == 0 ? i + 2 : i + 1);
+  }
+  ASSERT_TRUE(tree.min_greater_than(98) == tree.end());
+}
+
+TEST(sorted_inserts_stay_shallow) {
+  BTree<int, std::less<int>, 16> tree;
+  for (int i = 0; i < 100000; ++i) {
+    tree.insert(i);
+  }
+  // every node but the root holds at least 7 elements
+  ASSERT_TRUE(tree.height() <= 6);
+  ASSERT_EQUAL(tree.size(), 100000);
+  ASSERT_EQUAL(*tree.max_element(), 99999);
+}
+
+TEST(try_emplace_and_emplace) {
+  BTree<std::string> tree;
+  auto result = tree.try_emplace("pear", "pear");
+  ASSERT_TRUE(result.second);
+  ASSERT_EQUAL(*result.first, "pear");
+  ASSERT_FALSE(tree.try_emplace("pear", "ignored").second);
+
+  ASSERT_TRUE(tree.emplace(3, 'a').second);
+  ASSERT_FALSE(tree.emplace("aaa").second);
+  ASSERT_EQUAL(tree.size(), 2);
+
+  std::ostringstream oss;
+  oss << tree;
+  ASSERT_EQUAL(oss.str(), "[ aaa pear ]");
+}
+
+TEST(duplicate_inserts_leave_full_nodes_alone) {
+  BTree<int, std::less<int>, 4> full;
+  for (int i = 0; i < 4; ++i) {
+    full.insert(i);
+  }
+  auto last = full.find(3);
+  const int *address = &*last;
+  ASSERT_FALSE(full.try_emplace(0, 0).second);
+  ASSERT_FALSE(full.emplace(1).second);
+  ASSERT_TRUE(full.insert(full.end(), 2) == full.find(2));
+  ASSERT_EQUAL(full.height(), 1);
+  ASSERT_EQUAL(&*full.find(3), address);
+  ASSERT_EQUAL(*last, 3);
+
+  // from_sorted leaves every node but the rightmost ones full
+  std::vector<int> keys;
+  for (int i = 0; i < 200; ++i) {
+    keys.push_back(i);
+  }
+  auto tree = Narrow_tree::from_sorted(keys.begin(), keys.end());
+  std::vector<const int *> addresses;
+  for (const int &elt : tree) {
+    addresses.push_back(&elt);
+  }
+  size_t height = tree.height();
+  for (int key : keys) {
+    ASSERT_FALSE(tree.try_emplace(key, key).second);
+  }
+  ASSERT_EQUAL(tree.height(), height);
+  for (int key : keys) {
+    ASSERT_EQUAL(&*tree.find(key), addresses[key]);
+  }
+}
+
+// An element type without a default constructor that counts its live
+// instances and how often one was copied or moved.
+struct Counted {
+  static int live;
+  static int transfers;
+
+  explicit Counted(int value_in)
+    : value(value_in) {
+    ++live;
+  }
+
+  Counted(const Counted &other)
+    : value(other.value) {
+    ++live;
+    ++transfers;
+  }
+
+  Counted(Counted &&other)
+    : value(other.value) {
+    ++live;
+    ++transfers;
+  }
+
+  Counted &operator=(const Counted &) = default;
+  Counted &operator=(Counted &&) = default;
+
+  ~Counted() {
+    --live;
+  }
+
+  int value;
+};
+
+int Counted::live = 0;
+int Counted::transfers = 0;
+
+struct Counted_less {
+  bool operator()(const Counted &lhs, const Counted &rhs) const {
+    return lhs.value < rhs.value;
+  }
+  bool operator()(const Counted &lhs, int rhs) const {
+    return lhs.value < rhs;
+  }
+  bool operator()(int lhs, const Counted &rhs) const {
+    return lhs < rhs.value;
+  }
+};
+
+TEST(elements_need_not_be_default_constructible) {
+  {
+    BTree<Counted, Counted_less, 3> tree;
+    ASSERT_EQUAL(Counted::live, 0);
+    Counted::transfers = 0;
+    ASSERT_TRUE(tree.try_emplace(7, 7).second);
+    ASSERT_EQUAL(Counted::transfers, 0);
+    ASSERT_EQUAL(Counted::live, 1);
+
+    for (int i = 0; i < 500; ++i) {
+      int key = (i * 37) % 500;
+      tree.try_emplace(key, key);
+    }
+    ASSERT_EQUAL(Counted::live, 500);
+    for (int i = 0; i < 500; i += 2) {
+      ASSERT_EQUAL(tree.erase(Counted(i)), 1);
+    }
+    ASSERT_EQUAL(Counted::live, 250);
+
+    BTree<Counted, Counted_less, 3, PoolNodeAllocator> copy;
+    for (const Counted &elt : tree) {
+      copy.insert(elt);
+    }
+    auto built = BTree<Counted, Counted_less, 3>::from_sorted(copy.begin(),
+                                                             copy.end());
+    ASSERT_EQUAL(Counted::live, 750);
+    int expected = 1;
+    for (const Counted &elt : built) {
+      ASSERT_EQUAL(elt.value, expected);
+      expected += 2;
+    }
+  }
+  ASSERT_EQUAL(Counted::live, 0);
+}
+
+TEST(copy_and_move) {
+  Narrow_tree tree;
+  for (int i = 0; i < 200; ++i) {
+    tree.insert((i * 7) % 200);
+  }
+  Narrow_tree copy(tree);
+  tree.insert(1000);
+  ASSERT_EQUAL(copy.size(), 200);
+  ASSERT_TRUE(copy.find(1000) == copy.end());
+  ASSERT_TRUE(std::vector<int>(copy.begin(), copy.end()) ==
+              std::vector<int>(tree.begin(), tree.find(1000)));
+
+  auto first = copy.begin();
+  Narrow_tree moved(std::move(copy));
+  ASSERT_TRUE(copy.empty());
+  ASSERT_TRUE(moved.begin() == first);
+
+  copy = moved;
+  ASSERT_EQUAL(copy.size(), 200);
+  tree = std::move(moved);
+  ASSERT_EQUAL(tree.size(), 200);
+  ASSERT_TRUE(moved.empty());
+}
+
+TEST(pool_allocator_tree) {
+  BTree<std::string, std::less<std::string>, 8, PoolNodeAllocator> tree;
+  for (int i = 0; i < 1000; ++i) {
+    tree.insert("key" + std::to_string(i));
+  }
+  BTree<std::string, std::less<std::string>, 8, PoolNodeAllocator> copy;
+  copy = tree;
+  ASSERT_EQUAL(copy.size(), 1000);
+  ASSERT_EQUAL(*copy.find("key500"), "key500");
+  ASSERT_TRUE(copy.check_sorting_invariant());
+}
+
+TEST(from_sorted_and_freeze) {
+  std::vector<int> keys;
+  for (int i = 0; i < 1000; ++i) {
+    keys.push_back(i * 3);
+  }
+  auto tree = Narrow_tree::from_sorted(keys.begin(), keys.end());
+  ASSERT_EQUAL(tree.size(), 1000);
+  ASSERT_TRUE(std::vector<int>(tree.begin(), tree.end()) == keys);
+  ASSERT_EQUAL(*tree.find(300), 300);
+
+  FrozenSearchTree<int> frozen = tree.freeze();
+  ASSERT_TRUE(std::vector<int>(frozen.begin(), frozen.end()) == keys);
+
+  std::swap(keys[5], keys[6]);
+  bool threw = false;
+  try {
+    Narrow_tree::from_sorted(keys.begin(), keys.end());
+  }
+  catch (const std::invalid_argument &) {
+    threw = true;
+  }
+  ASSERT_TRUE(threw);
+}
+
+TEST(from_sorted_accepts_forward_only_ranges) {
+  std::forward_list<int> keys = {1, 2, 3};
+  auto tree = Narrow_tree::from_sorted(keys.begin(), keys.end());
+  ASSERT_EQUAL(tree.size(), 3);
+  ASSERT_TRUE(std::vector<int>(tree.begin(), tree.end()) ==
+              std::vector<int>({1, 2, 3}));
+
+  std::forward_list<int> unsorted = {1, 3, 2};
+  bool threw = false;
+  try {
+    Narrow_tree::from_sorted(unsorted.begin(), unsorted.end());
+  }
+  catch (const std::invalid_argument &) {
+    threw = true;
+  }
+  ASSERT_TRUE(threw);
+}
+
+TEST(from_sorted_builds_shallow_trees) {
+  for (int n : {1, 2, 3, 4, 5, 15, 16, 17, 100, 1000, 5000}) {
+    std::vector<int> keys;
+    for (int i = 0; i < n; ++i) {
+      keys.push_back(i * 2);
+    }
+    auto narrow = Narrow_tree::from_sorted(keys.begin(), keys.end());
+    auto wide = BTree<int, std::less<int>, 8>::from_sorted(keys.begin(),
+                                                           keys.end());
+    // all but the rightmost nodes are full, so the height is minimal
+    size_t narrow_height = 0, wide_height = 0;
+    for (long capacity = 0; capacity < n; capacity = capacity * 4 + 3) {
+      ++narrow_height;
+    }
+    for (long capacity = 0; capacity < n; capacity = capacity * 9 + 8) {
+      ++wide_height;
+    }
+    ASSERT_EQUAL(narrow.height(), narrow_height);
+    ASSERT_EQUAL(wide.height(), wide_height);
+    ASSERT_TRUE(std::vector<int>(narrow.begin(), narrow.end()) == keys);
+    ASSERT_TRUE(std::vector<int>(wide.begin(), wide.end()) == keys);
+
+    // the trees must stay valid under later updates
+    for (int i = 0; i < n; ++i) {
+      ASSERT_TRUE(narrow.insert(i * 2 + 1) != narrow.end());
+      ASSERT_EQUAL(wide.erase(i * 2), 1);
+    }
+    ASSERT_EQUAL(narrow.size(), 2 * n);
+    ASSERT_TRUE(narrow.check_sorting_invariant());
+    for (int i = 0; i < 2 * n; ++i) {
+      ASSERT_EQUAL(narrow.erase(i), 1);
+    }
+    ASSERT_TRUE(narrow.empty());
+    ASSERT_TRUE(wide.empty());
+    ASSERT_EQUAL(wide.height(), 0);
+  }
+}
+
+TEST(bounds_and_ranges) {
+  Narrow_tree tree;
+  for (int i = 0; i < 100; ++i) {
+    tree.insert((i * 37) % 100 * 2);
+  }
+  for (int i = -1; i <= 200; ++i) {
+    auto lower = tree.lower_bound(i);
+    auto upper = tree.upper_bound(i);
+    int expected_lower = i < 0 ? 0 : i + i % 2;
+    int expected_upper = i < 0 ? 0 : i + 2 - i % 2;
+    ASSERT_TRUE(expected_lower < 200 ? *lower == expected_lower
+                                     : lower == tree.end());
+    ASSERT_TRUE(expected_upper < 200 ? *upper == expected_upper
+                                     : upper == tree.end());
+    auto equal = tree.equal_range(i);
+    ASSERT_TRUE(equal.first == lower);
+    ASSERT_TRUE(equal.second == upper);
+  }
+
+  std::vector<int> odds;
+  for (int elt : tree.range(11, 21)) {
+    odds.push_back(elt);
+  }
+  ASSERT_TRUE(odds == std::vector<int>({12, 14, 16, 18, 20}));
+  ASSERT_TRUE(tree.range(11, 12).empty());
+  ASSERT_TRUE(tree.range(20, 10).empty());
+  ASSERT_TRUE(tree.range(500, 100).empty());
+}
+
+TEST(erase_keeps_invariants) {
+  for (int n : {1, 2, 10, 100, 1000}) {
+    Narrow_tree narrow;
+    BTree<int, std::less<int>, 8> wide;
+    for (int i = 0; i < n; ++i) {
+      narrow.insert(i);
+      wide.insert(i);
+    }
+    // erase every key in a scrambled order, checking the element that
+    // erase() reports as the next one
+    std::vector<int> remaining(narrow.begin(), narrow.end());
+    for (int i = 0; i < n; ++i) {
+      int key = (i * 7919) % n;
+      auto next = narrow.erase(narrow.find(key));
+      auto pos = std::find(remaining.begin(), remaining.end(), key);
+      pos = remaining.erase(pos);
+      if (pos == remaining.end()) {
+        ASSERT_TRUE(next == narrow.end());
+      }
+      else {
+        ASSERT_EQUAL(*next, *pos);
+      }
+      ASSERT_EQUAL(wide.erase(key), 1);
+      ASSERT_EQUAL(wide.erase(key), 0);
+      ASSERT_EQUAL(narrow.size(), remaining.size());
+      ASSERT_EQUAL(wide.size(), remaining.size());
+      if (i % 50 == 0 || n - i < 5) {
+        ASSERT_TRUE(std::vector<int>(narrow.begin(), narrow.end()) ==
+                    remaining);
+        ASSERT_TRUE(std::vector<int>(wide.begin(), wide.end()) == remaining);
+      }
+    }
+    ASSERT_TRUE(narrow.empty());
+    ASSERT_EQUAL(narrow.height(), 0);
+    ASSERT_TRUE(wide.empty());
+  }
+}
+
+TEST(erase_range_and_clear) {
+  BTree<std::string, std::less<std::string>, 4, PoolNodeAllocator> tree;
+  for (int i = 0; i < 500; ++i) {
+    tree.insert("key" + std::to_string(1000 + i));
+  }
+  auto next = tree.erase(tree.find("key1100"), tree.find("key1400"));
+  ASSERT_EQUAL(*next, "key1400");
+  ASSERT_EQUAL(tree.size(), 200);
+  ASSERT_TRUE(tree.check_sorting_invariant());
+  ASSERT_TRUE(tree.find("key1200") == tree.end());
+  ASSERT_EQUAL(*tree.find("key1099"), "key1099");
+
+  tree.clear();
+  ASSERT_TRUE(tree.empty());
+  ASSERT_TRUE(tree.begin() == tree.end());
+  tree.insert("again");
+  ASSERT_EQUAL(tree.size(), 1);
+  ASSERT_EQUAL(tree.height(), 1);
+}
+
+TEST_MAIN()
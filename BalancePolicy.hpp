@@ -0,0 +1,150 @@
+#ifndef BALANCE_POLICY_HPP
+#define BALANCE_POLICY_HPP
+/* BalancePolicy.hpp
+ *
+ * Balancing policies for BinarySearchTree. A policy is selected through
+ * the third template parameter of BinarySearchTree:
+ *
+ *   BinarySearchTree<int>                          // Unbalanced (default)
+ *   BinarySearchTree<int, std::less<int>, AVLBalance>
+ *   BinarySearchTree<int, std::less<int>, SplayBalance>
+ *
+ * Every policy provides a single static member function template
+ *
+ *   template <typename Node> static Node *rebalance(Node *node);
+ *
+ * which the tree calls on each node along the insertion path, from the
+ * new leaf back up to the root. It must refresh the cached height of
+ * 'node' and return the root of the (possibly restructured) subtree that
+ * used to be rooted at 'node'. The returned node keeps the parent of
+ * 'node'; the caller links it into that parent.
+ *
+ * A policy also declares whether the tree should adjust its shape when
+ * elements are accessed:
+ *
+ *   static const bool adjusts_on_access;
+ *
+ * If it is true, BinarySearchTree::access() and insertion move the
+ * element they reach to the root with splay rotations.
+ */
+
+#include <algorithm> //max
+
+// Helpers shared by all balancing policies. They only rely on the
+// 'left', 'right', 'parent' and 'height' members of a tree node.
+struct BalanceBase {
+
+  // Policies that move accessed elements to the root override this.
+  static const bool adjusts_on_access = false;
+
+  // EFFECTS: Returns the cached height of the subtree rooted at 'node',
+  //          or 0 if 'node' is null.
+  template <typename Node>
+  static int height_of(const Node *node) {
+    return node ? node->height : 0;
+  }
+
+  // MODIFIES: node
+  // EFFECTS:  Recomputes the cached height of 'node' from its children.
+  template <typename Node>
+  static void update_height(Node *node) {
+    node->height = 1 + std::max(height_of(node->left), height_of(node->right));
+  }
+
+  // EFFECTS: Returns height(left) - height(right) for 'node'.
+  template <typename Node>
+  static int balance_factor(const Node *node) {
+    return height_of(node->left) - height_of(node->right);
+  }
+
+  // REQUIRES: node->right is not null
+  // MODIFIES: node, node->right
+  // EFFECTS:  Rotates the subtree rooted at 'node' to the left and returns
+  //           its new root (the former right child). The new root takes
+  //           over the parent pointer of 'node'; the parent's child
+  //           pointer is left for the caller to update.
+  template <typename Node>
+  static Node *rotate_left(Node *node) {
+    Node *pivot = node->right;
+    node->right = pivot->left;
+    if (node->right) {
+      node->right->parent = node;
+    }
+    pivot->left = node;
+    pivot->parent = node->parent;
+    node->parent = pivot;
+    update_height(node);
+    update_height(pivot);
+    return pivot;
+  }
+
+  // REQUIRES: node->left is not null
+  // MODIFIES: node, node->left
+  // EFFECTS:  Mirror image of rotate_left.
+  template <typename Node>
+  static Node *rotate_right(Node *node) {
+    Node *pivot = node->left;
+    node->left = pivot->right;
+    if (node->left) {
+      node->left->parent = node;
+    }
+    pivot->right = node;
+    pivot->parent = node->parent;
+    node->parent = pivot;
+    update_height(node);
+    update_height(pivot);
+    return pivot;
+  }
+};
+
+// Plain binary search tree insertion. The shape of the tree depends
+// entirely on insertion order, so sorted input produces a chain.
+struct Unbalanced : BalanceBase {
+  template <typename Node>
+  static Node *rebalance(Node *node) {
+    update_height(node);
+    return node;
+  }
+};
+
+// AVL balancing: the heights of the two subtrees of every node differ by
+// at most one, which bounds the height of a tree with n elements by
+// roughly 1.44 * log2(n + 2) regardless of insertion order.
+struct AVLBalance : BalanceBase {
+  template <typename Node>
+  static Node *rebalance(Node *node) {
+    update_height(node);
+    int balance = balance_factor(node);
+    if (balance > 1) {
+      if (balance_factor(node->left) < 0) {
+        node->left = rotate_left(node->left);
+      }
+      return rotate_right(node);
+    }
+    if (balance < -1) {
+      if (balance_factor(node->right) > 0) {
+        node->right = rotate_right(node->right);
+      }
+      return rotate_left(node);
+    }
+    return node;
+  }
+};
+
+// Splay tree: insertion and BinarySearchTree::access() rotate the node
+// they reach up to the root, so frequently used elements stay near the
+// top. There is no bound on the height of the tree, but any sequence of
+// m accesses costs O((m + n) log n) comparisons, and on skewed access
+// patterns hot elements are found after only a few comparisons. Lookups
+// through the const find() do not adjust the tree.
+struct SplayBalance : BalanceBase {
+  static const bool adjusts_on_access = true;
+
+  template <typename Node>
+  static Node *rebalance(Node *node) {
+    update_height(node);
+    return node;
+  }
+};
+
+#endif // BALANCE_POLICY_HPP
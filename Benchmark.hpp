@@ -0,0 +1,129 @@
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+/* Benchmark.hpp
+ *
+ * Small helpers shared by the *_bench.cpp programs: a wall-clock
+ * stopwatch, key generators, a reader for the words of our CSV corpora
+ * and a reporter that prints one CSV row per measurement:
+ *
+ *   suite,structure,operation,n,ns_per_op
+ *
+ * Benchmarks are built with optimization by "make bench".
+ */
+
+#include "csvstream.hpp"
+#include <algorithm> //shuffle, lower_bound, min
+#include <chrono>    //steady_clock
+#include <cmath>     //pow
+#include <cstdint>   //uint64_t
+#include <iostream>  //cout
+#include <map>
+#include <random>    //mt19937_64
+#include <sstream>   //istringstream
+#include <string>
+#include <vector>
+
+class Stopwatch {
+public:
+  Stopwatch()
+    : start(std::chrono::steady_clock::now()) { }
+
+  // EFFECTS: Returns the number of nanoseconds since construction or the
+  //          last call to restart().
+  double elapsed_ns() const {
+    std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+  }
+
+  void restart() {
+    start = std::chrono::steady_clock::now();
+  }
+
+private:
+  std::chrono::steady_clock::time_point start;
+};
+
+// EFFECTS: Prints the CSV header row.
+inline void print_report_header() {
+  std::cout << "suite,structure,operation,n,ns_per_op" << std::endl;
+}
+
+// EFFECTS: Prints one CSV row; 'total_ns' is divided over 'ops' operations.
+inline void report(const std::string &suite, const std::string &structure,
+                   const std::string &operation, size_t n,
+                   double total_ns, size_t ops) {
+  std::cout << suite << ',' << structure << ',' << operation << ','
+            << n << ',' << (ops ? total_ns / ops : total_ns) << std::endl;
+}
+
+// EFFECTS: Returns the integers 0 .. n-1 in a random order.
+inline std::vector<int> shuffled_ints(size_t n, uint64_t seed = 280) {
+  std::vector<int> keys(n);
+  for (size_t i = 0; i < n; ++i) {
+    keys[i] = static_cast<int>(i);
+  }
+  std::mt19937_64 rng(seed);
+  std::shuffle(keys.begin(), keys.end(), rng);
+  return keys;
+}
+
+// EFFECTS: Returns 'count' keys drawn from 0 .. n-1 with Zipf-distributed
+//          frequencies: the key of rank k is drawn with probability
+//          proportional to 1 / k^s, as word frequencies in text roughly
+//          are. Which key gets which rank is shuffled, so the hot keys are
+//          spread over the whole range.
+inline std::vector<int> zipf_ints(size_t count, size_t n, double s = 1.0,
+                                  uint64_t seed = 280) {
+  std::vector<double> cumulative(n);
+  double total = 0;
+  for (size_t k = 0; k < n; ++k) {
+    total += 1 / std::pow(static_cast<double>(k + 1), s);
+    cumulative[k] = total;
+  }
+  std::vector<int> key_of_rank = shuffled_ints(n, seed + 1);
+  std::mt19937_64 rng(seed);
+  std::uniform_real_distribution<double> uniform(0, total);
+  std::vector<int> keys;
+  keys.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    size_t rank = std::lower_bound(cumulative.begin(), cumulative.end(),
+                                   uniform(rng)) - cumulative.begin();
+    keys.push_back(key_of_rank[std::min(rank, n - 1)]);
+  }
+  return keys;
+}
+
+// EFFECTS: Returns n distinct word-like strings in a random order.
+inline std::vector<std::string> shuffled_words(size_t n, uint64_t seed = 280) {
+  std::vector<std::string> words;
+  words.reserve(n);
+  for (int key : shuffled_ints(n, seed)) {
+    words.push_back("word" + std::to_string(key));
+  }
+  return words;
+}
+
+// EFFECTS: Returns the words of the content column of the CSV file
+//          'filename', in the order they appear.
+inline std::vector<std::string> read_word_trace(const std::string &filename) {
+  csvstream csvin(filename);
+  std::map<std::string, std::string> row;
+  std::vector<std::string> trace;
+  while (csvin >> row) {
+    std::istringstream source(row["content"]);
+    std::string word;
+    while (source >> word) {
+      trace.push_back(word);
+    }
+  }
+  return trace;
+}
+
+// Keeps the optimizer from discarding a computed value.
+template <typename T>
+inline void do_not_optimize(const T &value) {
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+#endif // BENCHMARK_HPP
@@ -19,12 +19,27 @@
 #include <iostream> //ostream
 #include <functional> //less
 #include <sstream>     // For std::stringstream
+#include <type_traits> //is_trivially_destructible
+#include <utility>     //pair, move, forward
+#include <iterator>    //distance
+#include <memory>      //unique_ptr
+#include <thread>      //thread, hardware_concurrency
+#include <system_error> //system_error
+#include "AugmentationPolicy.hpp"
+#include "BalancePolicy.hpp"
+#include "NodeAllocator.hpp"
+#include "FrozenSearchTree.hpp"
+#include "MemoryUsage.hpp"
+#include "IteratorRange.hpp"
 
 // You may add aditional libraries here if needed. You may use any
 // part of the STL except for containers.
 
 template <typename T,
-          typename Compare=std::less<T> // default if argument isn't provided
+          typename Compare=std::less<T>, // default if argument isn't provided
+          typename Balance=Unbalanced,
+          template <typename> class NodeAllocator=HeapNodeAllocator,
+          typename Augmentation=NoAugmentation
          >
 class BinarySearchTree {
 
@@ -33,6 +48,22 @@ class BinarySearchTree {
   // between elements. The default is std::less<T>, which orders
   // according to the < operator on T. (For simplicity, we assume only
   // comparators that can be default constructed will be used.)
+  //
+  // The Balance policy (see BalancePolicy.hpp) determines how the tree
+  // is restructured on insertion. The default, Unbalanced, keeps the
+  // shape determined by insertion order. AVLBalance keeps the height
+  // of the tree O(log n) regardless of insertion order. SplayBalance
+  // moves inserted elements and those found by access() to the root.
+  //
+  // The NodeAllocator policy (see NodeAllocator.hpp) determines where
+  // nodes live. The default, HeapNodeAllocator, allocates each node with
+  // new. PoolNodeAllocator carves nodes out of large slabs and releases
+  // them all at once when the tree is destroyed.
+  //
+  // The Augmentation policy (see AugmentationPolicy.hpp) determines what
+  // summary of its subtree each node keeps. The default, NoAugmentation,
+  // keeps none and costs nothing. OrderStatistics keeps subtree sizes,
+  // which enables select(), rank() and count_range().
 
   // INVARIANTS: All these invariants must hold for valid implementations
   // of BinarySearchTree. The invariants may also be considered as an implicit
@@ -62,25 +93,31 @@ class BinarySearchTree {
   // "greater than" end up meaning the same thing when duplicates are
   // not allowed.
 
-  // NOTE: Any operation you define must use RECURSION rather than iteration.
-  //       You may NOT use any looping constructs.
+  // NOTE: No operation recurses, so even a degenerate tree with millions
+  //       of elements can be copied, traversed and destroyed safely.
 
 private:
 
-  // A Node stores an element and pointers to its left and right children
-  // DO NOT change this struct definition.
-  struct Node {
-
-    // Default constructor - does nothing
-    Node() {}
-
-    // Custom constructor provided for convenience
-    Node(const T &datum_in, Node *left_in, Node *right_in)
-            : datum(datum_in), left(left_in), right(right_in) { }
+  // A Node stores an element, pointers to its left and right children,
+  // a pointer to its parent (null for the root) and the cached height of
+  // the subtree rooted at it. The height is maintained by the Balance
+  // policy on every insertion; the parent pointer lets Iterator step to
+  // the next element without searching from the root. The Augmentation
+  // policy's Node_data base holds its summary of the subtree.
+  struct Node : Augmentation::Node_data {
+
+    // Creates a childless node whose datum is constructed in place from
+    // the given arguments.
+    template <typename... Args>
+    explicit Node(Args&&... args)
+            : datum(std::forward<Args>(args)...), left(nullptr),
+              right(nullptr), parent(nullptr), height(1) { }
 
     T datum;
     Node *left;
     Node *right;
+    Node *parent;
+    int height;
   };
 
 public:
@@ -88,25 +125,62 @@ public:
   // Default constructor
   // (Note this will default construct the less comparator)
   BinarySearchTree()
-    : root(nullptr) { }
+    : root(nullptr), rightmost(nullptr), node_count(0) { }
 
   // Copy constructor
   BinarySearchTree(const BinarySearchTree &other)
-    : root(copy_nodes_impl(other.root)) { }
+    : root(nullptr), rightmost(nullptr), node_count(0) {
+    root = copy_nodes_impl(other.root, node_alloc);
+    rightmost = max_element_impl(root);
+    node_count = other.node_count;
+  }
+
+  // Move constructor
+  // EFFECTS: Takes over the nodes of 'other' in constant time, leaving
+  //          'other' empty.
+  BinarySearchTree(BinarySearchTree &&other) noexcept
+    : root(other.root), rightmost(other.rightmost),
+      node_count(other.node_count), less(std::move(other.less)),
+      node_alloc(std::move(other.node_alloc)) {
+    other.root = nullptr;
+    other.rightmost = nullptr;
+    other.node_count = 0;
+  }
 
   // Assignment operator
   BinarySearchTree &operator=(const BinarySearchTree &rhs) {
     if (this == &rhs) {
       return *this;
     }
-    destroy_nodes_impl(root);
-    root = copy_nodes_impl(rhs.root);
+    destroy_all_nodes();
+    root = copy_nodes_impl(rhs.root, node_alloc);
+    rightmost = max_element_impl(root);
+    node_count = rhs.node_count;
+    return *this;
+  }
+
+  // Move assignment operator
+  // EFFECTS: Destroys the elements of this tree and takes over the nodes
+  //          of 'rhs', leaving 'rhs' empty.
+  BinarySearchTree &operator=(BinarySearchTree &&rhs) noexcept {
+    if (this == &rhs) {
+      return *this;
+    }
+    destroy_all_nodes();
+    root = rhs.root;
+    rightmost = rhs.rightmost;
+    node_count = rhs.node_count;
+    less = std::move(rhs.less);
+    node_alloc = std::move(rhs.node_alloc);
+    rhs.root = nullptr;
+    rhs.rightmost = nullptr;
+    rhs.node_count = 0;
     return *this;
   }
 
   // Destructor
   ~BinarySearchTree() {
-    destroy_nodes_impl(root);
+    destroy_all_nodes();
   }
 
   // EFFECTS: Returns whether this BinarySearchTree is empty.
@@ -115,13 +189,16 @@ public:
   }
 
   // EFFECTS: Returns the height of the tree.
+  // NOTE:    Heights are cached in the nodes, so this runs in constant time.
   size_t height() const {
-    return static_cast<size_t>(height_impl(root));
+    return static_cast<size_t>(Balance::height_of(root));
   }
 
   // EFFECTS: Returns the number of elements in this BinarySearchTree.
+  // NOTE:    The count is kept up to date by every modifying operation,
+  //          so this runs in constant time.
   size_t size() const {
-    return static_cast<size_t>(size_impl(root));
+    return node_count;
   }
 
   // EFFECTS: Traverses the tree using an in-order traversal,
@@ -142,8 +219,6 @@ public:
 
   // EFFECTS: Returns whether or not the sorting invariant holds on
   //          the root of this BinarySearchTree.
-  //
-  // NOTE: This function must be recursive.
   bool check_sorting_invariant() const {
     return check_sorting_invariant_impl(root, less);
   }
@@ -154,10 +229,20 @@ public:
     //           by the sorted ordering of the BinarySearchTree.
 
     // Big Three for Iterator not needed
+    //
+    // An Iterator is just a pointer to the current node. Advancing it
+    // follows child and parent links, so it performs no comparisons and
+    // a full traversal costs amortized O(1) per step.
 
   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = T *;
+    using reference = T &;
+
     Iterator()
-      : root(nullptr), current_node(nullptr) {}
+      : current_node(nullptr) {}
 
     // EFFECTS:  Returns the current element by reference.
     // WARNING:  Dereferencing an iterator returns an element from the tree
@@ -189,14 +274,7 @@ public:
 
     // Prefix ++
     Iterator &operator++() {
-      if (current_node->right) {
-        // If has right child, next element is minimum of right subtree
-        current_node = min_element_impl(current_node->right);
-      }
-      else {
-        // Otherwise, look in the whole tree for the next biggest element
-        current_node = min_greater_than_impl(root, current_node->datum, less);
-      }
+      current_node = successor_impl(current_node);
       return *this;
     }
 
@@ -218,12 +296,10 @@ public:
   private:
     friend class BinarySearchTree;
 
-    Node *root;
     Node *current_node;
-    Compare less;
 
-    Iterator(Node *root_in, Node* current_node_in, Compare less_in)
-      : root(root_in), current_node(current_node_in), less(less_in) { }
+    explicit Iterator(Node *current_node_in)
+      : current_node(current_node_in) { }
 
   }; // BinarySearchTree::Iterator
   ////////////////////////////////////////
@@ -232,10 +308,7 @@ public:
   // EFFECTS : Returns an iterator to the first element
   //           in this BinarySearchTree.
   Iterator begin() const {
-    if (root == nullptr) {
-      return Iterator();
-    }
-    return Iterator(root, min_element_impl(root), less);
+    return Iterator(min_element_impl(root));
   }
 
   // EFFECTS: Returns an iterator to past-the-end.
@@ -247,20 +320,107 @@ public:
   // EFFECTS: Returns an Iterator to the minimum element in this
   //          BinarySearchTree or an end Iterator if the tree is empty.
   Iterator min_element() const {
-    return Iterator(root, min_element_impl(root), less);
+    return Iterator(min_element_impl(root));
   }
 
   // EFFECTS: Returns an Iterator to the maximum element in this
   //          BinarySearchTree or an end Iterator if the tree is empty.
   Iterator max_element() const {
-    return Iterator(root, max_element_impl(root), less);
+    return Iterator(rightmost);
   }
 
   // EFFECTS: Returns an Iterator to the minimum element in this
   //          BinarySearchTree greater than the given value.
   //          If the tree is empty, returns an end Iterator.
   Iterator min_greater_than(const T &value) const {
-    return Iterator(root, min_greater_than_impl(root, value, less), less);
+    return Iterator(min_greater_than_impl(root, value, less));
+  }
+
+  // EFFECTS: Returns an Iterator to the first element that is not less
+  //          than key, or an end Iterator if there is none. key may be of
+  //          any type Compare can compare against T in either order.
+  template <typename Key>
+  Iterator lower_bound(const Key &key) const {
+    return Iterator(lower_bound_impl(root, key, less));
+  }
+
+  // EFFECTS: Returns an Iterator to the first element that is greater
+  //          than key, or an end Iterator if there is none.
+  template <typename Key>
+  Iterator upper_bound(const Key &key) const {
+    return Iterator(min_greater_than_impl(root, key, less));
+  }
+
+  // EFFECTS: Returns the range of elements equivalent to key, as the pair
+  //          (lower_bound(key), upper_bound(key)). Since elements are
+  //          unique, it holds at most one element.
+  template <typename Key>
+  std::pair<Iterator, Iterator> equal_range(const Key &key) const {
+    return unique_equal_range(lower_bound(key), end(), key, less);
+  }
+
+  // EFFECTS: Returns a view of the elements that are not less than lo and
+  //          less than hi, in ascending order. Finding the ends takes
+  //          O(height) and iterating over the k elements O(k) amortized.
+  template <typename Key>
+  IteratorRange<Iterator> range(const Key &lo, const Key &hi) const {
+    return bounded_range(lower_bound(lo), lower_bound(hi), end(), less);
+  }
+
+  // REQUIRES: Augmentation is OrderStatistics
+  // EFFECTS : Returns an Iterator to the k-th smallest element, counting
+  //           from 0, or an end Iterator if k >= size(). Runs in
+  //           O(height).
+  Iterator select(size_t k) const {
+    static_assert(Augmentation::tracks_subtree_sizes,
+                  "select() requires the OrderStatistics augmentation");
+    Node *node = root;
+    while (node != nullptr) {
+      size_t left_size = Augmentation::size_of(node->left);
+      if (k < left_size) {
+        node = node->left;
+      }
+      else if (k == left_size) {
+        break;
+      }
+      else {
+        k -= left_size + 1;
+        node = node->right;
+      }
+    }
+    return Iterator(node);
+  }
+
+  // REQUIRES: Augmentation is OrderStatistics
+  // EFFECTS : Returns the number of elements less than key, which is the
+  //           position of key in ascending order if it is contained.
+  //           Runs in O(height).
+  template <typename Key>
+  size_t rank(const Key &key) const {
+    static_assert(Augmentation::tracks_subtree_sizes,
+                  "rank() requires the OrderStatistics augmentation");
+    size_t count = 0;
+    Node *node = root;
+    while (node != nullptr) {
+      if (less(node->datum, key)) {
+        count += Augmentation::size_of(node->left) + 1;
+        node = node->right;
+      }
+      else {
+        node = node->left;
+      }
+    }
+    return count;
+  }
+
+  // REQUIRES: Augmentation is OrderStatistics
+  // EFFECTS : Returns the number of elements that are not less than lo
+  //           and less than hi, in O(height).
+  template <typename Key>
+  size_t count_range(const Key &lo, const Key &hi) const {
+    size_t below_hi = rank(hi);
+    size_t below_lo = rank(lo);
+    return below_hi > below_lo ? below_hi - below_lo : 0;
   }
 
 
@@ -274,7 +434,44 @@ public:
   //          to the existing value. Otherwise, the sorting invariant
   //          will no longer hold.
   Iterator find(const T &query) const {
-    return Iterator(root, find_impl(root, query, less), less);
+    return Iterator(find_impl(root, query, less));
+  }
+
+  // EFFECTS: Same as above, but query may be of any type that Compare
+  //          can compare against T in either order (for example a bare
+  //          key when T is a key-value pair), so no T has to be built.
+  template <typename Key>
+  Iterator find(const Key &query) const {
+    return Iterator(find_impl(root, query, less));
+  }
+
+  // MODIFIES: this BinarySearchTree, if the Balance policy adjusts on
+  //           access
+  // EFFECTS : Same as find(), except that with such a policy (for
+  //           example SplayBalance) the element found, or the last one
+  //           compared on a miss, is moved to the root, so that it and
+  //           its neighbors are found faster next time. Iterators remain
+  //           valid.
+  template <typename Key>
+  Iterator access(const Key &query) {
+    Node *last = nullptr;
+    Node *node = root;
+    while (node != nullptr) {
+      last = node;
+      if (less(query, node->datum)) {
+        node = node->left;
+      }
+      else if (less(node->datum, query)) {
+        node = node->right;
+      }
+      else {
+        break;
+      }
+    }
+    if (Balance::adjusts_on_access && last != nullptr) {
+      splay_impl(root, last);
+    }
+    return Iterator(node);
   }
 
   // REQUIRES: The given item is not already contained in this BinarySearchTree
@@ -283,8 +480,307 @@ public:
   //           the sorting invariant.
   Iterator insert(const T &item) {
     assert(find(item) == end());
-    root = insert_impl(root, item, less);
-    return find(item);
+    Node *node = insert_impl(root, rightmost, item, less, node_alloc);
+    ++node_count;
+    return Iterator(node);
+  }
+
+  // REQUIRES: The given item is not already contained in this BinarySearchTree
+  // MODIFIES: this BinarySearchTree
+  // EFFECTS : Same as above, but moves 'item' into the new node.
+  Iterator insert(T &&item) {
+    assert(find(item) == end());
+    Node *node = insert_impl(root, rightmost, std::move(item), less,
+                             node_alloc);
+    ++node_count;
+    return Iterator(node);
+  }
+
+  // MODIFIES: this BinarySearchTree
+  // EFFECTS : Inserts a copy of item as close as possible to the position
+  //           just before 'hint', unless an equivalent element is already
+  //           contained. Returns an iterator to the inserted element, or
+  //           to the equivalent one.
+  // NOTE:     If item belongs immediately before or after the element at
+  //           'hint' (or at the end, if 'hint' is end()), its place is
+  //           found with at most two comparisons instead of a search from
+  //           the root. Loading ascending data with the hint end(), or
+  //           with the iterator returned for the previous element, then
+  //           costs amortized O(1) per element with AVLBalance (O(log n)
+  //           if the Augmentation tracks subtree sizes, which are
+  //           updated up to the root). A wrong hint only costs those
+  //           comparisons before the usual search.
+  Iterator insert(Iterator hint, const T &item) {
+    return insert_near_hint(hint, item);
+  }
+
+  // MODIFIES: this BinarySearchTree
+  // EFFECTS : Same as above, but moves 'item' into the new node if one is
+  //           inserted.
+  Iterator insert(Iterator hint, T &&item) {
+    return insert_near_hint(hint, std::move(item));
+  }
+
+  // MODIFIES: this BinarySearchTree
+  // EFFECTS : Constructs an element in place from 'args' and inserts it
+  //           as insert(hint, item) does. If an equivalent element is
+  //           already contained, the new element is destroyed and an
+  //           iterator to the existing one is returned.
+  template <typename... Args>
+  Iterator emplace_hint(Iterator hint, Args&&... args) {
+    Node *node = node_alloc.create(std::forward<Args>(args)...);
+    Node *parent = nullptr;
+    bool go_left = false;
+    Node *existing = find_slot_near_hint(hint.current_node, node->datum,
+                                         parent, go_left);
+    if (existing != nullptr) {
+      node_alloc.destroy(node);
+      return Iterator(existing);
+    }
+    link_leaf_impl(root, rightmost, parent, go_left, node);
+    ++node_count;
+    return Iterator(node);
+  }
+
+  // MODIFIES: this BinarySearchTree
+  // EFFECTS : Constructs an element in place from 'args' inside a new
+  //           node. If an equivalent element is already contained, the
+  //           new element is destroyed and an iterator to the existing
+  //           one is returned along with false. Otherwise the new element
+  //           is linked into the tree and returned along with true.
+  template <typename... Args>
+  std::pair<Iterator, bool> emplace(Args&&... args) {
+    Node *node = node_alloc.create(std::forward<Args>(args)...);
+    Node *parent = nullptr;
+    bool go_left = false;
+    Node *existing = find_slot_impl(root, node->datum, less, parent, go_left);
+    if (existing != nullptr) {
+      node_alloc.destroy(node);
+      return std::make_pair(Iterator(existing), false);
+    }
+    link_leaf_impl(root, rightmost, parent, go_left, node);
+    ++node_count;
+    return std::make_pair(Iterator(node), true);
+  }
+
+  // MODIFIES: this BinarySearchTree
+  // EFFECTS : Searches this tree for an element equivalent to 'key',
+  //           which may be of any type the Compare functor can compare
+  //           against T. If one is found, returns an iterator to it along
+  //           with false and leaves 'args' untouched. Otherwise constructs
+  //           a new element in place from 'args' at the position found by
+  //           that same search and returns an iterator to it along with
+  //           true.
+  // REQUIRES: The element constructed from 'args' is equivalent to 'key'.
+  template <typename Key, typename... Args>
+  std::pair<Iterator, bool> try_emplace(const Key &key, Args&&... args) {
+    Node *parent = nullptr;
+    bool go_left = false;
+    Node *existing = find_slot_impl(root, key, less, parent, go_left);
+    if (existing != nullptr) {
+      return std::make_pair(Iterator(existing), false);
+    }
+    Node *node = node_alloc.create(std::forward<Args>(args)...);
+    link_leaf_impl(root, rightmost, parent, go_left, node);
+    ++node_count;
+    return std::make_pair(Iterator(node), true);
+  }
+
+  // REQUIRES: [first, last) is a forward range whose elements are in
+  //           strictly ascending order according to Compare
+  // EFFECTS : Returns a perfectly balanced tree holding the elements of
+  //           [first, last), built in linear time without comparing
+  //           elements. If 'verify' is true, first checks the
+  //           requirement in one extra pass and throws
+  //           std::invalid_argument if the range is not strictly
+  //           ascending (this includes duplicates).
+  template <typename ForwardIt>
+  static BinarySearchTree from_sorted(ForwardIt first, ForwardIt last,
+                                      bool verify = true) {
+    BinarySearchTree result;
+    if (verify) {
+      require_strictly_ascending(first, last, result.less);
+    }
+    size_t n = static_cast<size_t>(std::distance(first, last));
+    result.root = build_balanced_impl(first, n, result.node_alloc);
+    result.rightmost = max_element_impl(result.root);
+    result.node_count = n;
+    return result;
+  }
+
+  // EFFECTS: Returns an immutable snapshot of this tree with its
+  //          elements laid out contiguously for fast searching (see
+  //          FrozenSearchTree.hpp). Later changes to this tree do not
+  //          affect the snapshot.
+  FrozenSearchTree<T, Compare> freeze() const {
+    return FrozenSearchTree<T, Compare>(begin(), end(), size());
+  }
+
+  // EFFECTS: Returns the memory used by this tree and statistics of its
+  //          shape (see MemoryUsage.hpp). Visits every node once,
+  //          following parent links, without comparing elements.
+  MemoryUsage memory_usage() const {
+    MemoryUsage usage;
+    usage.node_count = node_count;
+    usage.node_bytes = node_count * sizeof(Node);
+    usage.allocator_slack_bytes = node_alloc.slack_bytes(node_count);
+
+    // Preorder walk: arriving from the parent visits a node, arriving
+    // from its left child moves on to its right subtree, and arriving
+    // from its right child climbs further.
+    size_t depth_sum = 0;
+    size_t depth = 1;
+    const Node *prev = nullptr;
+    const Node *node = root;
+    while (node != nullptr) {
+      const Node *next;
+      if (prev == node->parent) {
+        if (usage.depth_histogram.size() < depth) {
+          usage.depth_histogram.resize(depth);
+        }
+        ++usage.depth_histogram[depth - 1];
+        depth_sum += depth;
+        usage.element_heap_bytes += owned_heap_bytes(node->datum);
+        next = node->left ? node->left
+             : node->right ? node->right : node->parent;
+      }
+      else if (prev == node->left && node->right != nullptr) {
+        next = node->right;
+      }
+      else {
+        next = node->parent;
+      }
+      if (next == node->parent) {
+        --depth;
+      }
+      else {
+        ++depth;
+      }
+      prev = node;
+      node = next;
+    }
+    usage.max_depth = usage.depth_histogram.size();
+    if (node_count != 0) {
+      usage.mean_depth = static_cast<double>(depth_sum) / node_count;
+    }
+    return usage;
+  }
+
+  // REQUIRES: pos points to an element of this tree
+  // MODIFIES: this BinarySearchTree
+  // EFFECTS : Removes the element at pos and returns an Iterator to the
+  //           element that followed it. Only iterators to the removed
+  //           element are invalidated: nodes are relinked, never copied.
+  //           The Balance policy restores balance on the path above the
+  //           removed node, and the node goes back to the allocator (the
+  //           pool allocator keeps it for reuse).
+  Iterator erase(Iterator pos) {
+    Node *node = pos.current_node;
+    Node *next = successor_impl(node);
+    if (node == rightmost) {
+      // the maximum has no right child, so its predecessor is the
+      // maximum of its left subtree, or else its parent
+      rightmost = node->left != nullptr ? max_element_impl(node->left)
+                                        : node->parent;
+    }
+    erase_impl(root, node);
+    node_alloc.destroy(node);
+    --node_count;
+    return Iterator(next);
+  }
+
+  // MODIFIES: this BinarySearchTree
+  // EFFECTS : Removes the elements in [first, last) and returns last.
+  Iterator erase(Iterator first, Iterator last) {
+    while (first != last) {
+      first = erase(first);
+    }
+    return last;
+  }
+
+  // MODIFIES: this BinarySearchTree
+  // EFFECTS : Removes the element equivalent to key, if there is one,
+  //           and returns the number of elements removed (0 or 1).
+  template <typename Key>
+  size_t erase(const Key &key) {
+    Node *node = find_impl(root, key, less);
+    if (node == nullptr) {
+      return 0;
+    }
+    erase(Iterator(node));
+    return 1;
+  }
+
+  // MODIFIES: this BinarySearchTree
+  // EFFECTS : Removes every element. The nodes are handed back to the
+  //           allocator one by one, so a pool allocator keeps its storage
+  //           for the tree to grow into again.
+  void clear() {
+    destroy_nodes_impl(root, node_alloc);
+    root = nullptr;
+    rightmost = nullptr;
+    node_count = 0;
+  }
+
+  // SET OPERATIONS
+  // The member functions below combine this tree with another one of the
+  // same type, taking over the other tree's nodes and leaving it empty.
+  // No element is copied and no node is allocated: the trees are cut
+  // apart with split_impl and glued back together with join_impl, which
+  // costs O(m log(n/m + 1)) time for trees of sizes m <= n, so merging a
+  // small tree into a large one only touches a few paths. The two halves
+  // below each level are processed on separate threads until 'threads'
+  // threads are busy (see fork_join_impl).
+  //
+  // REQUIRES: Balance is AVLBalance, which bounds the depth of the
+  //           recursion. 'combine' and the Compare functor do not throw,
+  //           and 'combine' may be called from several threads at once on
+  //           different elements.
+
+  // MODIFIES: this BinarySearchTree, other
+  // EFFECTS : Moves every element of 'other' into this tree. Where both
+  //           trees hold equivalent elements, calls
+  //           combine(mine, std::move(theirs)), which updates 'mine' in
+  //           place, and keeps only 'mine'.
+  template <typename Combine>
+  void union_with(BinarySearchTree &&other, Combine combine,
+                  unsigned threads = available_threads()) {
+    size_t total = node_count + other.node_count;
+    Set_op_state state = run_set_operation<Union_rule>(other, combine,
+                                                        threads);
+    node_count = total - state.matches;
+  }
+
+  // MODIFIES: this BinarySearchTree, other
+  // EFFECTS : Keeps only the elements of this tree that have an
+  //           equivalent in 'other', updating each with
+  //           combine(mine, std::move(theirs)), and destroys the rest of
+  //           both trees.
+  template <typename Combine>
+  void intersection(BinarySearchTree &&other, Combine combine,
+                    unsigned threads = available_threads()) {
+    Set_op_state state = run_set_operation<Intersection_rule>(other, combine,
+                                                               threads);
+    node_count = state.matches;
+  }
+
+  // MODIFIES: this BinarySearchTree, other
+  // EFFECTS : Removes the elements of this tree that have an equivalent
+  //           in 'other', and destroys every element of 'other'.
+  void difference(BinarySearchTree &&other,
+                  unsigned threads = available_threads()) {
+    size_t total = node_count;
+    Keep_mine keep_mine;
+    Set_op_state state = run_set_operation<Difference_rule>(other, keep_mine,
+                                                             threads);
+    node_count = total - state.matches;
+  }
+
+  // EFFECTS: Returns the number of threads the set operations use by
+  //          default: one per hardware thread, or 1 if that is unknown.
+  static unsigned available_threads() {
+    unsigned threads = std::thread::hardware_concurrency();
+    return threads == 0 ? 1 : threads;
   }
 
   // EFFECTS: Returns a human-readable string representation of this
@@ -301,9 +797,20 @@ private:
   // The root node of this BinarySearchTree.
   Node *root;
 
+  // The node holding the maximum element, or null if the tree is empty.
+  // Inserting at the end with a hint starts here instead of at the root.
+  Node *rightmost;
+
+  // The number of elements in this BinarySearchTree.
+  size_t node_count;
+
   // An instance of the Compare type. Use this to compare elements.
   Compare less;
 
+  // Creates and destroys the nodes of this tree.
+  using Node_allocator = NodeAllocator<Node>;
+  Node_allocator node_alloc;
+
     
   // NOTE: These member types are implemented for you in TreePrint.hpp.
   //       They support the to_string function. You do not have to do
@@ -322,90 +829,113 @@ private:
 
 
   // TREE IMPLEMENTATION FUNCTIONS
-  // You must write an implementation for each of these static member
-  // functions, which are called from the regular member functions that
-  // are included in the starter code for the BinarySearchTree class.
+  // These static member functions are called from the regular member
+  // functions above. None of them recurse: they either loop down a
+  // single path or walk the tree through parent pointers, so a
+  // degenerate (chain-shaped) tree of any size cannot overflow the call
+  // stack, and no call overhead is paid per level. The one exception is
+  // set_operation_impl, which only runs on AVL trees and so recurses at
+  // most as deep as such a tree is tall.
 
 
   // EFFECTS: Returns whether the tree rooted at 'node' is empty.
   // NOTE:    This function must run in constant time.
-  //          No iteration or recursion is allowed.
   static bool empty_impl(const Node *node) {
-    if (node == nullptr){
-      return true;
-    }
-    else{
-      return false;
-    }
+    return node == nullptr;
   }
 
 
-   
-  // EFFECTS: Returns the size of the tree rooted at 'node', which is the
-  //          total number of nodes in that tree. The size of an empty
-  //          tree is 0.
-  // NOTE:    This function must be tree recursive.
-  static int size_impl(const Node *node) {
-    if (empty_impl(node)){
-      return 0;
-    }
-    return size_impl(node->left) + size_impl(node->right) + 1;
-  }
-
-  // EFFECTS: Returns the height of the tree rooted at 'node', which is the
-  //          number of nodes in the longest path from the 'node' to a leaf.
-  //          The height of an empty tree is 0.
-  // NOTE:    This function must be tree recursive.
-  static int height_impl(const Node *node) {
-    if (empty_impl(node)){
-      return 0;
+  // EFFECTS: Creates and returns a pointer to the root of a new node structure
+  //          with the same elements and EXACTLY the same structure as the
+  //          tree rooted at 'node'. If an allocation or a copy of an
+  //          element throws, the partial copy is destroyed first.
+  static Node *copy_nodes_impl(Node *node, Node_allocator &alloc) {
+    if (node == nullptr) {
+      return nullptr;
     }
-
-    // heigt of a tree = height(left) + height(right) + 1
-
-    if (height_impl(node->left)>height_impl(node->right)){
-      return height_impl(node->left)+1;
+    Node *copy_root = copy_one_node_impl(node, nullptr, alloc);
+    try {
+      // Walk both trees in lock step. A missing child in the copy means
+      // that subtree has not been visited yet.
+      Node *src = node;
+      Node *dst = copy_root;
+      while (true) {
+        if (src->left && !dst->left) {
+          dst->left = copy_one_node_impl(src->left, dst, alloc);
+          src = src->left;
+          dst = dst->left;
+        }
+        else if (src->right && !dst->right) {
+          dst->right = copy_one_node_impl(src->right, dst, alloc);
+          src = src->right;
+          dst = dst->right;
+        }
+        else if (src == node) {
+          return copy_root;
+        }
+        else {
+          src = src->parent;
+          dst = dst->parent;
+        }
+      }
     }
-    else{
-      return height_impl(node->right)+1;
+    catch (...) {
+      destroy_nodes_impl(copy_root, alloc);
+      throw;
     }
   }
 
-  // EFFECTS: Creates and returns a pointer to the root of a new node structure
-  //          with the same elements and EXACTLY the same structure as the
-  //          tree rooted at 'node'.
-  // NOTE:    This function must be tree recursive.
-  /*
-  static Node *copy_nodes_impl(Node *node) {
-    if (node == nullptr){
-      return nullptr;
-    }
-    Node *newNode = new Node(node->datum); // here we got a problem
-    newNode->left = copy_nodes_impl(node->left);
-    newNode->right = copy_nodes_impl(node->right);
-    return newNode;
+  // EFFECTS: Returns a new childless node holding a copy of the datum
+  //          and cached height of 'node', with the given parent.
+  static Node *copy_one_node_impl(const Node *node, Node *parent,
+                                  Node_allocator &alloc) {
+    Node *copy = alloc.create(node->datum);
+    copy->parent = parent;
+    copy->height = node->height;
+    static_cast<typename Augmentation::Node_data &>(*copy) = *node;
+    return copy;
   }
-*/
-  static Node *copy_nodes_impl(Node *node) {
-    if (node == nullptr) {
-        return nullptr;
-    }
-    Node *newNode = new Node(node->datum, nullptr, nullptr);
-    newNode->left = copy_nodes_impl(node->left);
-    newNode->right = copy_nodes_impl(node->right);
-    return newNode;
-}
 
 
   // EFFECTS: Frees the memory for all nodes used in the tree rooted at 'node'.
-  // NOTE:    This function must be tree recursive.
-  static void destroy_nodes_impl(Node *node) {
+  // NOTE:    Nodes are freed in post-order by repeatedly descending to a
+  //          leaf, detaching it and freeing it, so no stack is needed.
+  static void destroy_nodes_impl(Node *node, Node_allocator &alloc) {
     if (node == nullptr){
       return;
     }
-    destroy_nodes_impl(node->left);
-    destroy_nodes_impl(node->right);
-    delete node;
+    Node *stop = node->parent;
+    while (node != stop) {
+      if (node->left) {
+        node = node->left;
+      }
+      else if (node->right) {
+        node = node->right;
+      }
+      else {
+        Node *parent = node->parent;
+        if (parent != stop) {
+          (parent->left == node ? parent->left : parent->right) = nullptr;
+        }
+        alloc.destroy(node);
+        node = parent;
+      }
+    }
+  }
+
+  // MODIFIES: this BinarySearchTree
+  // EFFECTS:  Destroys every node and leaves the tree empty. Allocators
+  //           that release their storage in bulk skip the per-node walk
+  //           entirely when T has a trivial destructor.
+  void destroy_all_nodes() {
+    if (!Node_allocator::releases_in_bulk ||
+        !std::is_trivially_destructible<T>::value) {
+      destroy_nodes_impl(root, node_alloc);
+    }
+    node_alloc.release_all();
+    root = nullptr;
+    rightmost = nullptr;
+    node_count = 0;
   }
 
   // EFFECTS : Searches the tree rooted at 'node' for an element equivalent
@@ -413,165 +943,867 @@ private:
   //           containing it. If the tree is empty or the element is not
   //           found, returns a null pointer.
   //
-  // NOTE: This function must be tail recursive.
   // HINT: Equivalence is defined according to the Compare functor
   //       associated with this instantiation of the BinarySearchTree
-  //       template, NOT according to the == operator. Use the "less"
-  //       parameter to compare elements.
+  //       template, NOT according to the == operator.
   //       Two elements A and B are equivalent if and only if A is
   //       not less than B and B is not less than A.
-  static Node * find_impl(Node *node, const T &query, Compare less) {
-    if (node == nullptr || !(less(query,node->datum)||less(node->datum,query))){
-      return node;
-    }
-    if(less(node->datum,query)){
-      return find_impl(node->right, query, less);
-    }
-    else{
-      return find_impl(node->left,query,less);
-    }
-  }
-
-  // REQUIRES: item is not already contained in the tree rooted at 'node'
-  // MODIFIES: the tree rooted at 'node'
-  // EFFECTS : If 'node' represents an empty tree, allocates a new
-  //           Node to represent a single-element tree with 'item' as
-  //           its only element and returns a pointer to the new Node.
-  //           If the tree rooted at 'node' is not empty, inserts
-  //           'item' into the proper location as a leaf in the
-  //           existing tree structure according to the sorting
-  //           invariant and returns the original parameter 'node'.
-  // NOTE: This function must be linear recursive, but does not
-  //       need to be tail recursive.
-  // HINT: Element ordering is defined according to the Compare functor
-  //       associated with this instantiation of the BinarySearchTree
-  //       template, NOT according to the < operator. Use the "less"
-  //       parameter to compare elements.
-  static Node * insert_impl(Node *node, const T &item, Compare less) {
-    if (node == nullptr){
-      return new Node(item, nullptr, nullptr);
+  template <typename Key>
+  static Node * find_impl(Node *node, const Key &query, const Compare &less) {
+    while (node != nullptr) {
+      if (less(query, node->datum)) {
+        node = node->left;
+      }
+      else if (less(node->datum, query)) {
+        node = node->right;
+      }
+      else {
+        return node;
+      }
     }
-    if (less(item,node->datum)){
-      node->left = insert_impl(node->left, item, less);
+    return nullptr;
+  }
+
+  // REQUIRES: item is not already contained in the tree rooted at 'root'
+  // MODIFIES: root, rightmost and the tree rooted at 'root'
+  // EFFECTS : Allocates a new Node holding 'item' (copied or moved,
+  //           depending on how it is passed), links it in as a leaf
+  //           according to the sorting invariant and lets the Balance
+  //           policy restructure the path back up to the root. 'root' is
+  //           updated if the root changes. Returns the new Node.
+  template <typename Item>
+  static Node * insert_impl(Node *&root, Node *&rightmost, Item &&item,
+                            Compare less, Node_allocator &alloc) {
+    Node *parent = nullptr;
+    bool go_left = false;
+    for (Node *node = root; node != nullptr;
+         node = go_left ? node->left : node->right) {
+      parent = node;
+      go_left = less(item, node->datum);
     }
-    else{
-      node->right = insert_impl(node->right, item, less);
+
+    Node *leaf = alloc.create(std::forward<Item>(item));
+    link_leaf_impl(root, rightmost, parent, go_left, leaf);
+    return leaf;
+  }
+
+  // MODIFIES: this BinarySearchTree
+  // EFFECTS : Implements insert(hint, item) for 'item' copied or moved.
+  template <typename Item>
+  Iterator insert_near_hint(Iterator hint, Item &&item) {
+    Node *parent = nullptr;
+    bool go_left = false;
+    Node *existing = find_slot_near_hint(hint.current_node, item, parent,
+                                         go_left);
+    if (existing != nullptr) {
+      return Iterator(existing);
     }
-    return node;
+    Node *node = node_alloc.create(std::forward<Item>(item));
+    link_leaf_impl(root, rightmost, parent, go_left, node);
+    ++node_count;
+    return Iterator(node);
+  }
+
+  // EFFECTS : Same as find_slot_impl on this tree, but first checks with
+  //           at most two comparisons whether 'key' belongs just before
+  //           'hint' (a null 'hint' stands for the end) or just after it.
+  template <typename Key>
+  Node * find_slot_near_hint(Node *hint, const Key &key, Node *&parent,
+                             bool &go_left) const {
+    if (hint == nullptr || less(key, hint->datum)) {
+      Node *prev = hint == nullptr ? rightmost
+                 : hint->left != nullptr ? max_element_impl(hint->left)
+                 : prev_ancestor_impl(hint);
+      if (prev == nullptr || less(prev->datum, key)) {
+        // 'key' goes between prev and hint: under hint if its left
+        // child is free, otherwise under prev, whose right child is
+        if (hint != nullptr && hint->left == nullptr) {
+          parent = hint;
+          go_left = true;
+        }
+        else {
+          parent = prev;
+          go_left = false;
+        }
+        return nullptr;
+      }
+    }
+    else if (less(hint->datum, key)) {
+      Node *next = hint == rightmost ? nullptr : successor_impl(hint);
+      if (next == nullptr || less(key, next->datum)) {
+        // 'key' goes between hint and next, mirroring the case above
+        if (hint->right == nullptr) {
+          parent = hint;
+          go_left = false;
+        }
+        else {
+          parent = next;
+          go_left = true;
+        }
+        return nullptr;
+      }
+    }
+    else {
+      return hint;
+    }
+    return find_slot_impl(root, key, less, parent, go_left);
+  }
+
+  // EFFECTS : Searches the tree rooted at 'node' for an element equivalent
+  //           to 'key'. Returns the node holding it if there is one.
+  //           Otherwise returns a null pointer and sets 'parent' and
+  //           'go_left' to where a new leaf for 'key' belongs.
+  template <typename Key>
+  static Node * find_slot_impl(Node *node, const Key &key, Compare less,
+                               Node *&parent, bool &go_left) {
+    parent = nullptr;
+    while (node != nullptr) {
+      if (less(key, node->datum)) {
+        go_left = true;
+      }
+      else if (less(node->datum, key)) {
+        go_left = false;
+      }
+      else {
+        return node;
+      }
+      parent = node;
+      node = go_left ? node->left : node->right;
+    }
+    return nullptr;
+  }
+
+  // REQUIRES: 'leaf' is a new childless node that belongs as the left
+  //           (if 'go_left') or right child of 'parent', which has no such
+  //           child; a null 'parent' means the tree is empty
+  // MODIFIES: root, rightmost and the tree rooted at 'root'
+  // EFFECTS : Links 'leaf' into the tree and rebalances the path above it.
+  //           'rightmost' becomes 'leaf' if it holds the new maximum.
+  static void link_leaf_impl(Node *&root, Node *&rightmost, Node *parent,
+                             bool go_left, Node *leaf) {
+    if (parent == nullptr || (parent == rightmost && !go_left)) {
+      rightmost = leaf;
+    }
+    leaf->parent = parent;
+    if (parent == nullptr) {
+      root = leaf;
+    }
+    else {
+      (go_left ? parent->left : parent->right) = leaf;
+      rebalance_path_impl(root, parent);
+      if (Balance::adjusts_on_access) {
+        splay_impl(root, leaf);
+      }
+    }
+  }
+
+  // REQUIRES: 'node' is in the tree rooted at 'root'
+  // MODIFIES: root and the tree rooted at it
+  // EFFECTS : Moves 'node' to the root with splay steps: if 'node' and
+  //           its parent are children on the same side, rotates the
+  //           grandparent first (zig-zig); otherwise rotates the parent
+  //           twice (zig-zag). Each step roughly halves the depth of the
+  //           nodes on the path. Heights and augmentation summaries of
+  //           every node on the path are recomputed as it is rotated.
+  static void splay_impl(Node *&root, Node *node) {
+    while (node->parent != nullptr) {
+      Node *parent = node->parent;
+      Node *grandparent = parent->parent;
+      if (grandparent != nullptr &&
+          (grandparent->left == parent) == (parent->left == node)) {
+        rotate_up_impl(root, parent);
+      }
+      rotate_up_impl(root, node);
+    }
+  }
+
+  // REQUIRES: 'node' has a parent
+  // MODIFIES: root and the tree rooted at it
+  // EFFECTS : Rotates 'node' above its parent and links it into the
+  //           former parent's place.
+  static void rotate_up_impl(Node *&root, Node *node) {
+    Node *parent = node->parent;
+    Node *grandparent = parent->parent;
+    bool was_left = grandparent != nullptr && grandparent->left == parent;
+    if (parent->left == node) {
+      Balance::rotate_right(parent);
+    }
+    else {
+      Balance::rotate_left(parent);
+    }
+    Augmentation::update(parent);
+    Augmentation::update(node);
+    if (grandparent == nullptr) {
+      root = node;
+    }
+    else {
+      (was_left ? grandparent->left : grandparent->right) = node;
+    }
+  }
+
+  // REQUIRES: The subtrees below 'node' have correct cached heights
+  //           and augmentation summaries
+  // MODIFIES: root and the tree rooted at it
+  // EFFECTS : Hands 'node' and then each of its ancestors to the Balance
+  //           policy, linking every restructured subtree back into its
+  //           parent (or into 'root'). Stops rebalancing once a subtree
+  //           comes back with the height it had before, since no height
+  //           above it can have changed; subtree sizes, if tracked, are
+  //           still refreshed up to the root.
+  static void rebalance_path_impl(Node *&root, Node *node) {
+    while (node != nullptr) {
+      Node *parent = node->parent;
+      int old_height = node->height;
+      bool was_left = parent != nullptr && parent->left == node;
+
+      Node *subtree = Balance::rebalance(node);
+      // a rotation moves at most the two children of the new subtree root
+      Augmentation::update(subtree->left);
+      Augmentation::update(subtree->right);
+      Augmentation::update(subtree);
+      if (parent == nullptr) {
+        root = subtree;
+      }
+      else {
+        (was_left ? parent->left : parent->right) = subtree;
+      }
+      if (subtree->height == old_height) {
+        if (Augmentation::tracks_subtree_sizes) {
+          for (; parent != nullptr; parent = parent->parent) {
+            Augmentation::update(parent);
+          }
+        }
+        return;
+      }
+      node = parent;
+    }
+  }
+
+  // REQUIRES: 'node' is in the tree rooted at 'root'
+  // MODIFIES: root and the tree rooted at it
+  // EFFECTS : Unlinks 'node' from the tree without destroying it and
+  //           rebalances the path above the deepest node whose subtree
+  //           changed. A node with two children is replaced by its
+  //           successor, which is moved up into its place.
+  static void erase_impl(Node *&root, Node *node) {
+    Node *rebalance_from;
+    Node *replacement;
+    if (node->left != nullptr && node->right != nullptr) {
+      replacement = min_element_impl(node->right);
+      if (replacement->parent == node) {
+        rebalance_from = replacement;
+      }
+      else {
+        // detach the successor, which has no left child, and give it
+        // the right subtree of 'node'
+        rebalance_from = replacement->parent;
+        rebalance_from->left = replacement->right;
+        if (replacement->right != nullptr) {
+          replacement->right->parent = rebalance_from;
+        }
+        replacement->right = node->right;
+        node->right->parent = replacement;
+      }
+      replacement->left = node->left;
+      node->left->parent = replacement;
+      replacement->height = node->height;
+    }
+    else {
+      replacement = node->left != nullptr ? node->left : node->right;
+      rebalance_from = node->parent;
+    }
+
+    Node *parent = node->parent;
+    if (replacement != nullptr) {
+      replacement->parent = parent;
+    }
+    if (parent == nullptr) {
+      root = replacement;
+    }
+    else {
+      (parent->left == node ? parent->left : parent->right) = replacement;
+    }
+    rebalance_path_impl(root, rebalance_from);
+  }
+
+  // An AVL tree of height h has at least F(h + 2) - 1 nodes, where F is
+  // the Fibonacci sequence, so no tree that fits in memory is 96 levels
+  // tall. split_impl records its search path in an array of this size.
+  static const int max_avl_height = 96;
+
+  // Subtrees shorter than this are too small to be worth a thread.
+  static const int min_parallel_height = 12;
+
+  // Which elements each set operation keeps: those only in this tree,
+  // those only in the other tree, and those in both (after combining the
+  // two equivalent elements into the one from this tree).
+  struct Union_rule {
+    static const bool keep_mine_only = true;
+    static const bool keep_theirs_only = true;
+    static const bool keep_matches = true;
+  };
+
+  struct Intersection_rule {
+    static const bool keep_mine_only = false;
+    static const bool keep_theirs_only = false;
+    static const bool keep_matches = true;
+  };
+
+  struct Difference_rule {
+    static const bool keep_mine_only = true;
+    static const bool keep_theirs_only = false;
+    static const bool keep_matches = false;
+  };
+
+  // The combine function of difference(), which never combines anything.
+  struct Keep_mine {
+    void operator()(T &, T &&) const { }
+  };
+
+  // What a set operation leaves behind besides its result: the subtrees
+  // it dropped, chained through the parent pointers of their roots so
+  // that none of them has to be destroyed (or anything allocated) while
+  // other threads are working, and the number of elements found in both
+  // trees.
+  struct Set_op_state {
+    Node *discarded = nullptr;
+    Node *last_discarded = nullptr;
+    size_t matches = 0;
+
+    // REQUIRES: 'node' is null or the root of a detached subtree
+    void discard(Node *node) {
+      if (node == nullptr) {
+        return;
+      }
+      node->parent = discarded;
+      discarded = node;
+      if (last_discarded == nullptr) {
+        last_discarded = node;
+      }
+    }
+
+    // MODIFIES: other
+    // EFFECTS:  Moves everything 'other' collected into this state.
+    void absorb(Set_op_state &other) {
+      if (other.discarded != nullptr) {
+        other.last_discarded->parent = discarded;
+        discarded = other.discarded;
+        if (last_discarded == nullptr) {
+          last_discarded = other.last_discarded;
+        }
+        other.discarded = nullptr;
+        other.last_discarded = nullptr;
+      }
+      matches += other.matches;
+      other.matches = 0;
+    }
+  };
+
+  // REQUIRES: 'other' is not this tree
+  // MODIFIES: this BinarySearchTree, other
+  // EFFECTS : Combines the two trees with set_operation_impl according to
+  //           Rule, keeps the result in this tree and leaves 'other'
+  //           empty. The nodes of 'other' are handed to this tree's
+  //           allocator first, and the discarded ones are destroyed once
+  //           every thread is done. Returns the final state so that the
+  //           caller can compute the new size from the number of matches.
+  template <typename Rule, typename Combine>
+  Set_op_state run_set_operation(BinarySearchTree &other, Combine &combine,
+                                 unsigned threads) {
+    static_assert(std::is_same<Balance, AVLBalance>::value,
+                  "set operations require AVLBalance");
+    assert(this != &other);
+    node_alloc.adopt(other.node_alloc);
+    Set_op_state state;
+    root = set_operation_impl<Rule>(root, other.root, less, combine, state,
+                                    threads);
+    other.root = nullptr;
+    other.rightmost = nullptr;
+    other.node_count = 0;
+    while (state.discarded != nullptr) {
+      Node *next = state.discarded->parent;
+      state.discarded->parent = nullptr;
+      destroy_nodes_impl(state.discarded, node_alloc);
+      state.discarded = next;
+    }
+    state.last_discarded = nullptr;
+    rightmost = max_element_impl(root);
+    return state;
+  }
+
+  // REQUIRES: 'mine' and 'theirs' are null or roots of AVL trees (their
+  //           parent pointers are ignored)
+  // EFFECTS : Returns the root of an AVL tree holding the elements of
+  //           both trees that Rule keeps, and hands the rest to 'state'.
+  //           Splits 'theirs' around the root of 'mine', handles the
+  //           halves on either side (see fork_join_impl), then joins the
+  //           two results around the root of 'mine' if it is kept, or
+  //           concatenates them if not. The recursion follows the paths
+  //           of 'mine', so it is no deeper than that AVL tree.
+  template <typename Rule, typename Combine>
+  static Node * set_operation_impl(Node *mine, Node *theirs,
+                                   const Compare &less, Combine &combine,
+                                   Set_op_state &state, unsigned threads) {
+    if (mine == nullptr || theirs == nullptr) {
+      Node *rest = mine != nullptr ? mine : theirs;
+      bool keep = mine != nullptr ? Rule::keep_mine_only
+                                  : Rule::keep_theirs_only;
+      if (rest == nullptr || !keep) {
+        state.discard(rest);
+        return nullptr;
+      }
+      rest->parent = nullptr;
+      return rest;
+    }
+
+    Node *mine_left = mine->left;
+    Node *mine_right = mine->right;
+    Node *theirs_left = nullptr;
+    Node *theirs_right = nullptr;
+    Node *match = split_impl(theirs, mine->datum, less, theirs_left,
+                             theirs_right);
+    Node *left = nullptr;
+    Node *right = nullptr;
+    auto left_task = [&](unsigned task_threads, Set_op_state &task_state) {
+      left = set_operation_impl<Rule>(mine_left, theirs_left, less, combine,
+                                      task_state, task_threads);
+    };
+    auto right_task = [&](unsigned task_threads, Set_op_state &task_state) {
+      right = set_operation_impl<Rule>(mine_right, theirs_right, less,
+                                       combine, task_state, task_threads);
+    };
+    fork_join_impl(threads, mine->height, state, left_task, right_task);
+
+    if (match != nullptr) {
+      ++state.matches;
+      if (Rule::keep_matches) {
+        combine(mine->datum, std::move(match->datum));
+      }
+      state.discard(match);
+    }
+    if (match != nullptr ? Rule::keep_matches : Rule::keep_mine_only) {
+      return join_impl(left, mine, right);
+    }
+    mine->left = nullptr;
+    mine->right = nullptr;
+    state.discard(mine);
+    return concat_impl(left, right);
+  }
+
+  // EFFECTS : Calls left_task(threads, state) and right_task(threads,
+  //           state), each with its share of 'threads' and a state of its
+  //           own, and gathers what they leave behind into 'state'. The
+  //           left task runs on a new thread if more than one thread is
+  //           available and the subtree being split is at least
+  //           min_parallel_height tall; otherwise, or if no thread can be
+  //           started, both tasks run on this one.
+  template <typename Left_task, typename Right_task>
+  static void fork_join_impl(unsigned threads, int height,
+                             Set_op_state &state, Left_task &left_task,
+                             Right_task &right_task) {
+    if (threads < 2 || height < min_parallel_height) {
+      left_task(1, state);
+      right_task(1, state);
+      return;
+    }
+    unsigned left_threads = threads / 2;
+    Set_op_state left_state;
+    std::thread worker;
+    try {
+      worker = std::thread([&] { left_task(left_threads, left_state); });
+    }
+    catch (const std::system_error &) {
+      left_task(left_threads, left_state);
+    }
+    right_task(threads - left_threads, state);
+    if (worker.joinable()) {
+      worker.join();
+    }
+    state.absorb(left_state);
+  }
+
+  // REQUIRES: 'node' is null or the root of an AVL tree (its parent
+  //           pointer is ignored)
+  // EFFECTS : Splits the tree rooted at 'node' around 'key' into an AVL
+  //           tree of the smaller elements, stored in 'left', and one of
+  //           the greater elements, stored in 'right'. Returns the node
+  //           holding an element equivalent to 'key', detached from both,
+  //           or a null pointer if there is none. The search path is
+  //           recorded on the way down; on the way back up, each node on
+  //           it is joined with its subtree off the path onto the side it
+  //           belongs to. The joins along one path cost O(log n) in all.
+  template <typename Key>
+  static Node * split_impl(Node *node, const Key &key, const Compare &less,
+                           Node *&left, Node *&right) {
+    Node *path[max_avl_height];
+    bool went_left[max_avl_height];
+    int depth = 0;
+    Node *match = nullptr;
+    while (node != nullptr) {
+      if (less(key, node->datum)) {
+        path[depth] = node;
+        went_left[depth++] = true;
+        node = node->left;
+      }
+      else if (less(node->datum, key)) {
+        path[depth] = node;
+        went_left[depth++] = false;
+        node = node->right;
+      }
+      else {
+        match = node;
+        break;
+      }
+    }
+
+    left = nullptr;
+    right = nullptr;
+    if (match != nullptr) {
+      left = match->left;
+      right = match->right;
+      match->left = nullptr;
+      match->right = nullptr;
+    }
+    while (depth > 0) {
+      --depth;
+      Node *above = path[depth];
+      if (went_left[depth]) {
+        right = join_impl(right, above, above->right);
+      }
+      else {
+        left = join_impl(above->left, above, left);
+      }
+    }
+    if (left != nullptr) {
+      left->parent = nullptr;
+    }
+    if (right != nullptr) {
+      right->parent = nullptr;
+    }
+    return match;
+  }
+
+  // REQUIRES: 'left' and 'right' are null or roots of AVL trees (their
+  //           parent pointers are ignored), and every element of 'left'
+  //           is less than the datum of 'mid', which is less than every
+  //           element of 'right'. 'mid' is in neither tree.
+  // EFFECTS : Links the three into one AVL tree and returns its root.
+  //           'mid' goes down the inner spine of the taller tree to the
+  //           first subtree at most one level taller than the other tree,
+  //           takes that subtree and the other tree as its children, and
+  //           the path above it is rebalanced. This takes time
+  //           proportional to the difference in heights.
+  static Node * join_impl(Node *left, Node *mid, Node *right) {
+    if (left != nullptr) {
+      left->parent = nullptr;
+    }
+    if (right != nullptr) {
+      right->parent = nullptr;
+    }
+    int left_height = Balance::height_of(left);
+    int right_height = Balance::height_of(right);
+    Node *root = mid;
+    Node *parent = nullptr;
+    bool into_left = false;
+    if (left_height > right_height + 1) {
+      root = left;
+      while (Balance::height_of(left) > right_height + 1) {
+        parent = left;
+        left = left->right;
+      }
+    }
+    else if (right_height > left_height + 1) {
+      root = right;
+      into_left = true;
+      while (Balance::height_of(right) > left_height + 1) {
+        parent = right;
+        right = right->left;
+      }
+    }
+
+    mid->left = left;
+    mid->right = right;
+    mid->parent = parent;
+    if (left != nullptr) {
+      left->parent = mid;
+    }
+    if (right != nullptr) {
+      right->parent = mid;
+    }
+    Balance::update_height(mid);
+    Augmentation::update(mid);
+    if (parent == nullptr) {
+      return mid;
+    }
+    (into_left ? parent->left : parent->right) = mid;
+    rebalance_path_impl(root, parent);
+    return root;
+  }
+
+  // REQUIRES: 'left' and 'right' are null or roots of AVL trees (their
+  //           parent pointers are ignored), and every element of 'left'
+  //           is less than every element of 'right'
+  // EFFECTS : Links the two into one AVL tree and returns its root, by
+  //           taking the maximum out of 'left' and joining around it.
+  static Node * concat_impl(Node *left, Node *right) {
+    if (left == nullptr) {
+      if (right != nullptr) {
+        right->parent = nullptr;
+      }
+      return right;
+    }
+    left->parent = nullptr;
+    if (right == nullptr) {
+      return left;
+    }
+    Node *mid = max_element_impl(left);
+    erase_impl(left, mid);
+    return join_impl(left, mid, right);
+  }
+
+  // REQUIRES: [first, first + n) is sorted
+  // EFFECTS : Creates one node per element of [first, first + n), in
+  //           order, and links them into a perfectly balanced tree: the
+  //           root is the middle element and the halves on either side
+  //           form its subtrees, recursively. Returns the root. If
+  //           creating a node throws, all nodes created so far are
+  //           destroyed first.
+  template <typename ForwardIt>
+  static Node * build_balanced_impl(ForwardIt first, size_t n,
+                                    Node_allocator &alloc) {
+    if (n == 0) {
+      return nullptr;
+    }
+    std::unique_ptr<Node *[]> nodes(new Node *[n]);
+    size_t created = 0;
+    try {
+      for (; created < n; ++created, ++first) {
+        nodes[created] = alloc.create(*first);
+      }
+    }
+    catch (...) {
+      for (size_t i = 0; i < created; ++i) {
+        alloc.destroy(nodes[i]);
+      }
+      throw;
+    }
+
+    // Link the nodes depth first with an explicit stack of index ranges.
+    // A balanced tree is at most 64 levels deep, and each level leaves
+    // at most one pending range on the stack.
+    struct Range {
+      size_t lo, hi;      // half-open range of indices into 'nodes'
+      Node *parent;
+      bool is_left;
+    };
+    Range stack[128];
+    int top = 0;
+    stack[top++] = Range{0, n, nullptr, false};
+    Node *root = nullptr;
+    while (top > 0) {
+      Range range = stack[--top];
+      if (range.lo == range.hi) {
+        continue;
+      }
+      size_t mid = range.lo + (range.hi - range.lo) / 2;
+      Node *node = nodes[mid];
+      node->parent = range.parent;
+      node->height = balanced_height(range.hi - range.lo);
+      Augmentation::assign_balanced(node, range.hi - range.lo);
+      if (range.parent == nullptr) {
+        root = node;
+      }
+      else {
+        (range.is_left ? range.parent->left : range.parent->right) = node;
+      }
+      stack[top++] = Range{mid + 1, range.hi, node, false};
+      stack[top++] = Range{range.lo, mid, node, true};
+    }
+    return root;
+  }
+
+  // EFFECTS : Returns the height of a perfectly balanced tree with n > 0
+  //           nodes, which is floor(log2(n)) + 1.
+  static int balanced_height(size_t n) {
+    int height = 0;
+    for (; n != 0; n >>= 1) {
+      ++height;
+    }
+    return height;
   }
 
   // EFFECTS : Returns a pointer to the Node containing the minimum element
   //           in the tree rooted at 'node' or a null pointer if the tree is empty.
-  // NOTE: This function must be tail recursive.
   // NOTE: This function is used in the implementation of the ++ operator for
-  //       the iterator code that is provided for you.
-  // HINT: You don't need to compare any elements! Think about the
-  //       structure, and where the smallest element lives.
+  //       the iterator.
   static Node * min_element_impl(Node *node) {
-    if (node==nullptr){
+    if (node == nullptr){
       return nullptr;
     }
-    if(node->left == nullptr){
-      return node;
+    while (node->left != nullptr) {
+      node = node->left;
     }
-    else{
-      return min_element_impl(node->left);
+    return node;
+  }
+
+  // REQUIRES: 'node' is not null and has no right child
+  // EFFECTS : Returns a pointer to the in-order successor of 'node': its
+  //           nearest ancestor whose left subtree contains 'node', or a
+  //           null pointer if 'node' holds the maximum element.
+  // NOTE: This function is used in the implementation of the ++ operator for
+  //       the iterator. It only follows parent links and never compares
+  //       elements.
+  static Node * next_ancestor_impl(Node *node) {
+    while (node->parent != nullptr && node->parent->right == node) {
+      node = node->parent;
     }
+    return node->parent;
+  }
+
+  // REQUIRES: 'node' is not null and has no left child
+  // EFFECTS : Returns a pointer to the in-order predecessor of 'node': its
+  //           nearest ancestor whose right subtree contains 'node', or a
+  //           null pointer if 'node' holds the minimum element.
+  static Node * prev_ancestor_impl(Node *node) {
+    while (node->parent != nullptr && node->parent->left == node) {
+      node = node->parent;
+    }
+    return node->parent;
+  }
+
+  // EFFECTS : Returns a pointer to the in-order successor of 'node', or a
+  //           null pointer if 'node' holds the maximum element.
+  static Node * successor_impl(Node *node) {
+    if (node->right != nullptr) {
+      return min_element_impl(node->right);
+    }
+    return next_ancestor_impl(node);
   }
 
   // EFFECTS : Returns a pointer to the Node containing the maximum element
   //           in the tree rooted at 'node' or a null pointer if the tree is empty.
-  // NOTE: This function must be tail recursive.
-  // HINT: You don't need to compare any elements! Think about the
-  //       structure, and where the largest element lives.
   static Node * max_element_impl(Node *node) {
-    if (node==nullptr){
+    if (node == nullptr){
       return nullptr;
     }
-    if (node->right==nullptr){
-      return node;
-    }
-    else{
-      return max_element_impl(node->right);
+    while (node->right != nullptr) {
+      node = node->right;
     }
+    return node;
   }
 
 
   // EFFECTS: Returns whether the sorting invariant holds on the tree
-  //          rooted at 'node'.
-  // NOTE:    This function must be tree recursive.
-  static bool check_sorting_invariant_impl(const Node *node, Compare less) {
-    if (node==nullptr){
+  //          rooted at 'node', i.e. whether every element compares
+  //          strictly less than the next one in an in-order traversal.
+  static bool check_sorting_invariant_impl(Node *node, Compare less) {
+    Node *prev = min_element_impl(node);
+    if (prev == nullptr) {
       return true;
     }
-    if (node->left != nullptr && !(less(node->left->datum,node->datum))){
-      return false;
-    }
-    if (node->right != nullptr && (less(node->right->datum,node->datum))){
-      return false;
+    Node *stop = next_ancestor_of_subtree_impl(node);
+    for (Node *next = successor_impl(prev); next != stop;
+         prev = next, next = successor_impl(next)) {
+      if (!less(prev->datum, next->datum)) {
+        return false;
+      }
     }
-    return check_sorting_invariant_impl(node->left, less)&&check_sorting_invariant_impl(node->right,less);
+    return true;
+  }
+
+  // REQUIRES: 'node' is not null
+  // EFFECTS : Returns the node that follows the whole subtree rooted at
+  //           'node' in an in-order traversal of the tree (a null pointer
+  //           if nothing does). In-order walks of that subtree stop there.
+  static Node * next_ancestor_of_subtree_impl(Node *node) {
+    return next_ancestor_impl(max_element_impl(node));
   }
 
   // EFFECTS : Traverses the tree rooted at 'node' using an in-order traversal,
   //           printing each element to os in turn. Each element is followed
   //           by a space (there will be an "extra" space at the end).
   //           If the tree is empty, nothing is printed.
-  // NOTE: This function must be tree recursive.
-  //       See https://en.wikipedia.org/wiki/Tree_traversal#In-order
+  // NOTE: See https://en.wikipedia.org/wiki/Tree_traversal#In-order
   //       for the definition of a in-order traversal.
-  static void traverse_inorder_impl(const Node *node, std::ostream &os) {
+  static void traverse_inorder_impl(Node *node, std::ostream &os) {
     if (node == nullptr){
       return;
     }
-    traverse_inorder_impl(node->left, os);
-    os<<node->datum<<" ";
-    traverse_inorder_impl(node->right, os);
+    Node *stop = next_ancestor_of_subtree_impl(node);
+    for (Node *current = min_element_impl(node); current != stop;
+         current = successor_impl(current)) {
+      os << current->datum << " ";
+    }
   }
 
   // EFFECTS : Traverses the tree rooted at 'node' using a pre-order traversal,
   //           printing each element to os in turn. Each element is followed
   //           by a space (there will be an "extra" space at the end).
   //           If the tree is empty, nothing is printed.
-  // NOTE: This function must be tree recursive.
-  //       See https://en.wikipedia.org/wiki/Tree_traversal#Pre-order
+  // NOTE: See https://en.wikipedia.org/wiki/Tree_traversal#Pre-order
   //       for the definition of a pre-order traversal.
-  static void traverse_preorder_impl(const Node *node, std::ostream &os) {
-    if (node == nullptr){
-      return;
+  static void traverse_preorder_impl(Node *node, std::ostream &os) {
+    Node *current = node;
+    while (current != nullptr) {
+      os << current->datum << " ";
+      if (current->left != nullptr) {
+        current = current->left;
+      }
+      else if (current->right != nullptr) {
+        current = current->right;
+      }
+      else {
+        // Climb until we leave a left subtree whose parent has a right
+        // subtree still to visit, without leaving the subtree at 'node'.
+        while (current != node &&
+               (current->parent->right == current ||
+                current->parent->right == nullptr)) {
+          current = current->parent;
+        }
+        current = current == node ? nullptr : current->parent->right;
+      }
     }
-    os<<node->datum<<" ";
-    traverse_preorder_impl(node->left, os);
-    traverse_preorder_impl(node->right, os);
   }
 
   // EFFECTS : Returns a pointer to the Node containing the smallest element
   //           in the tree rooted at 'node' that is greater than 'val'.
   //           Returns a null pointer if the tree is empty or if it does not
   //           contain any elements that are greater than 'val'.
-  //
-  // NOTE: This function must be linear recursive.
-  // NOTE: This function is used in the implementation of the ++ operator for
-  //       the iterator code that is provided for you.
-  // HINT: At each step, compare 'val' the the current node (using the
-  //       'less' parameter). Based on the result, you gain some information
-  //       about where the element you're looking for could be.
-  static Node * min_greater_than_impl(Node *node, const T &val, Compare less) {
-    if (node==nullptr){
-      return nullptr;
-    }
-    if (less(val,node->datum)){
-      Node *left_result = min_greater_than_impl(node->left, val,  less);
-      if (left_result != nullptr){
-        return left_result;
+  template <typename Key>
+  static Node * min_greater_than_impl(Node *node, const Key &val,
+                                      const Compare &less) {
+    Node *result = nullptr;
+    while (node != nullptr) {
+      if (less(val, node->datum)) {
+        // 'node' is a candidate; anything smaller is on the left
+        result = node;
+        node = node->left;
       }
-      else{
-        return node;
+      else {
+        node = node->right;
       }
     }
-    else{
-      return min_greater_than_impl(node->right, val,  less);
+    return result;
+  }
+
+  // EFFECTS : Returns a pointer to the Node containing the smallest element
+  //           in the tree rooted at 'node' that is not less than 'key', or
+  //           a null pointer if there is none.
+  template <typename Key>
+  static Node * lower_bound_impl(Node *node, const Key &key,
+                                 const Compare &less) {
+    Node *result = nullptr;
+    while (node != nullptr) {
+      if (less(node->datum, key)) {
+        node = node->right;
+      }
+      else {
+        // 'node' is a candidate; anything smaller is on the left
+        result = node;
+        node = node->left;
+      }
     }
+    return result;
   }
 
 
@@ -592,9 +1824,12 @@ private:
 //           BinarySearchTree Iterator, which in turn depends on some
 //           of the functions you must write.
 
-template <typename T, typename Compare>
+template <typename T, typename Compare, typename Balance,
+          template <typename> class NodeAllocator, typename Augmentation>
 std::ostream &operator<<(std::ostream &os,
-                         const BinarySearchTree<T, Compare> &tree) {
+                         const BinarySearchTree<T, Compare, Balance,
+                                                NodeAllocator,
+                                                Augmentation> &tree) {
 // DO NOT CHANGE THE IMPLEMENTATION OF THIS FUNCTION
   os << "[ ";
   for (T& elt : tree) {
@@ -603,4 +1838,9 @@ std::ostream &operator<<(std::ostream &os,
   return os << "]";
 }
 
+// Map backend (see Map.hpp): an AVL-balanced BinarySearchTree
+template <typename T, typename Compare,
+          template <typename> class NodeAllocator>
+using AVLTreeBackend = BinarySearchTree<T, Compare, AVLBalance, NodeAllocator>;
+
 #endif // DO NOT REMOVE!!
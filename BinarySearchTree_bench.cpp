@@ -0,0 +1,293 @@
+// BinarySearchTree_bench.cpp
+//
+// allocator: compares node allocation policies for BinarySearchTree: one
+//            new/delete per node (HeapNodeAllocator) versus slab
+//            allocation with bulk release (PoolNodeAllocator). Measures
+//            insert, find and teardown.
+// hint:      loads ascending keys into an AVL tree and a Map with plain
+//            insertion and with the hint end(), which lets each insertion
+//            start at the maximum instead of the root.
+// zipf:      replays the words of every post in a CSV corpus, in order,
+//            as lookups against an AVL tree (find) and a splay tree
+//            (access) holding the corpus vocabulary. Word frequencies
+//            are Zipf-distributed. Reports time and comparisons per
+//            lookup (the latter in the ns_per_op column).
+// core:      insert, find, iteration, copy and destruction (and
+//            operator[] for the maps) on an AVL tree, a Map, std::map and
+//            std::unordered_map with int keys. Keys arrive in random,
+//            sorted, reverse-sorted or Zipf-distributed order; the
+//            distribution is the suffix of the operation name. A Zipf
+//            stream of n keys repeats keys, so it leaves fewer than n
+//            elements. Iteration, copy and destruction are reported per
+//            element held, the rest per key of the stream.
+
+#include "BinarySearchTree.hpp"
+#include "Map.hpp"
+#include "Benchmark.hpp"
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+template <typename Tree, typename Key>
+void bench_allocator(const string &structure, const vector<Key> &keys) {
+  const size_t n = keys.size();
+  Stopwatch timer;
+  unique_ptr<Tree> tree(new Tree);
+  for (const Key &key : keys) {
+    tree->insert(key);
+  }
+  report("allocator", structure, "insert", n, timer.elapsed_ns(), n);
+
+  timer.restart();
+  size_t found = 0;
+  for (const Key &key : keys) {
+    found += tree->find(key) != tree->end();
+  }
+  do_not_optimize(found);
+  report("allocator", structure, "find", n, timer.elapsed_ns(), n);
+
+  timer.restart();
+  tree.reset();
+  report("allocator", structure, "teardown", n, timer.elapsed_ns(), n);
+}
+
+void bench_hint(size_t n) {
+  using Tree = BinarySearchTree<int, less<int>, AVLBalance, PoolNodeAllocator>;
+  {
+    Stopwatch timer;
+    Tree tree;
+    for (size_t i = 0; i < n; ++i) {
+      tree.insert(static_cast<int>(i));
+    }
+    report("hint", "avl_tree", "sorted_insert", n, timer.elapsed_ns(), n);
+  }
+  {
+    Stopwatch timer;
+    Tree tree;
+    for (size_t i = 0; i < n; ++i) {
+      tree.insert(tree.end(), static_cast<int>(i));
+    }
+    report("hint", "avl_tree", "sorted_insert_hint", n, timer.elapsed_ns(), n);
+  }
+  {
+    Stopwatch timer;
+    Map<int, int> map;
+    for (size_t i = 0; i < n; ++i) {
+      map.insert({static_cast<int>(i), 0});
+    }
+    report("hint", "map", "sorted_insert", n, timer.elapsed_ns(), n);
+  }
+  {
+    Stopwatch timer;
+    Map<int, int> map;
+    for (size_t i = 0; i < n; ++i) {
+      map.insert(map.end(), {static_cast<int>(i), 0});
+    }
+    report("hint", "map", "sorted_insert_hint", n, timer.elapsed_ns(), n);
+  }
+}
+
+// Counts the comparisons made by every tree that uses it
+size_t string_comparisons = 0;
+
+struct CountingStringLess {
+  bool operator()(const string &lhs, const string &rhs) const {
+    ++string_comparisons;
+    return lhs < rhs;
+  }
+};
+
+// EFFECTS: Builds 'Tree' from 'vocabulary' and times one lookup per word
+//          of 'trace', made through 'lookup'.
+template <typename Tree, typename Lookup>
+void bench_trace(const string &structure, const vector<string> &vocabulary,
+                 const vector<string> &trace, Lookup lookup) {
+  Tree tree;
+  for (const string &word : vocabulary) {
+    tree.insert(word);
+  }
+  string_comparisons = 0;
+  Stopwatch timer;
+  size_t found = 0;
+  for (const string &word : trace) {
+    found += lookup(tree, word) != tree.end();
+  }
+  double elapsed = timer.elapsed_ns();
+  do_not_optimize(found);
+  report("zipf", structure, "find", vocabulary.size(), elapsed, trace.size());
+  report("zipf", structure, "comparisons_per_find", vocabulary.size(),
+         string_comparisons, trace.size());
+}
+
+void bench_zipf(const string &filename) {
+  vector<string> trace = read_word_trace(filename);
+  vector<string> vocabulary = trace;
+  sort(vocabulary.begin(), vocabulary.end());
+  vocabulary.erase(unique(vocabulary.begin(), vocabulary.end()),
+                   vocabulary.end());
+  // insert in random order so the splay tree does not start as a chain
+  shuffle(vocabulary.begin(), vocabulary.end(), mt19937_64(280));
+
+  using Avl_tree = BinarySearchTree<string, CountingStringLess, AVLBalance>;
+  using Splay_tree = BinarySearchTree<string, CountingStringLess, SplayBalance>;
+  bench_trace<Avl_tree>("avl_tree", vocabulary, trace,
+                        [](const Avl_tree &tree, const string &word) {
+                          return tree.find(word);
+                        });
+  bench_trace<Splay_tree>("splay_tree", vocabulary, trace,
+                          [](Splay_tree &tree, const string &word) {
+                            return tree.access(word);
+                          });
+}
+
+// EFFECTS: Returns the value an element of a tree or a map contributes to
+//          the checksum of an iteration.
+int value_of(int elt) {
+  return elt;
+}
+
+int value_of(const pair<const int, int> &entry) {
+  return entry.second;
+}
+
+// The tree's try_emplace and the maps' insert both leave an existing
+// key alone, which a Zipf stream needs.
+template <typename Tree>
+void insert_key(Tree &tree, int key) {
+  tree.try_emplace(key, key);
+}
+
+template <typename Key, typename Value, typename... Rest>
+void insert_key(Map<Key, Value, Rest...> &map, int key) {
+  map.insert({key, key});
+}
+
+template <typename Key, typename Value, typename... Rest>
+void insert_key(std::map<Key, Value, Rest...> &map, int key) {
+  map.insert({key, key});
+}
+
+template <typename Key, typename Value, typename... Rest>
+void insert_key(unordered_map<Key, Value, Rest...> &map, int key) {
+  map.insert({key, key});
+}
+
+// EFFECTS: Times inserting 'keys' into an empty Container, finding each
+//          of them, iterating over the result, copying it and
+//          destroying both copies.
+template <typename Container>
+void bench_core(const string &structure, const string &distribution,
+                const vector<int> &keys) {
+  const size_t n = keys.size();
+  Stopwatch timer;
+  unique_ptr<Container> container(new Container);
+  for (int key : keys) {
+    insert_key(*container, key);
+  }
+  report("core", structure, "insert_" + distribution, n, timer.elapsed_ns(),
+         n);
+
+  timer.restart();
+  size_t found = 0;
+  for (int key : keys) {
+    found += container->find(key) != container->end();
+  }
+  do_not_optimize(found);
+  report("core", structure, "find_" + distribution, n, timer.elapsed_ns(), n);
+
+  const size_t size = container->size();
+  timer.restart();
+  long long sum = 0;
+  for (const auto &elt : *container) {
+    sum += value_of(elt);
+  }
+  do_not_optimize(sum);
+  report("core", structure, "iterate_" + distribution, n, timer.elapsed_ns(),
+         size);
+
+  timer.restart();
+  unique_ptr<Container> copy(new Container(*container));
+  report("core", structure, "copy_" + distribution, n, timer.elapsed_ns(),
+         size);
+
+  timer.restart();
+  container.reset();
+  copy.reset();
+  report("core", structure, "destroy_" + distribution, n, timer.elapsed_ns(),
+         2 * size);
+}
+
+// EFFECTS: Times ++map[key] for every key of 'keys', starting from an
+//          empty Map_type.
+template <typename Map_type>
+void bench_subscript(const string &structure, const string &distribution,
+                     const vector<int> &keys) {
+  Stopwatch timer;
+  Map_type map;
+  for (int key : keys) {
+    ++map[key];
+  }
+  report("core", structure, "subscript_" + distribution, keys.size(),
+         timer.elapsed_ns(), keys.size());
+}
+
+void bench_core_distribution(const string &distribution,
+                             const vector<int> &keys) {
+  using Avl_tree = BinarySearchTree<int, less<int>, AVLBalance,
+                                    PoolNodeAllocator>;
+  bench_core<Avl_tree>("avl_tree", distribution, keys);
+  bench_core<Map<int, int>>("map", distribution, keys);
+  bench_core<std::map<int, int>>("std_map", distribution, keys);
+  bench_core<unordered_map<int, int>>("std_unordered_map", distribution,
+                                      keys);
+  bench_subscript<Map<int, int>>("map", distribution, keys);
+  bench_subscript<std::map<int, int>>("std_map", distribution, keys);
+  bench_subscript<unordered_map<int, int>>("std_unordered_map",
+                                           distribution, keys);
+}
+
+void bench_core_all(size_t n) {
+  vector<int> keys = shuffled_ints(n);
+  bench_core_distribution("random", keys);
+  sort(keys.begin(), keys.end());
+  bench_core_distribution("sorted", keys);
+  reverse(keys.begin(), keys.end());
+  bench_core_distribution("reverse", keys);
+  bench_core_distribution("zipf", zipf_ints(n, n));
+}
+
+int main() {
+  print_report_header();
+
+  for (size_t n : {1000, 100000, 1000000}) {
+    bench_core_all(n);
+  }
+
+  for (size_t n : {10000, 1000000}) {
+    bench_hint(n);
+  }
+
+  bench_zipf("w14-f15_instructor_student.csv");
+  bench_zipf("w16_projects_exam.csv");
+
+  for (size_t n : {10000, 1000000}) {
+    vector<int> ints = shuffled_ints(n);
+    bench_allocator<BinarySearchTree<int, less<int>, AVLBalance,
+                                     HeapNodeAllocator>>("int/heap", ints);
+    bench_allocator<BinarySearchTree<int, less<int>, AVLBalance,
+                                     PoolNodeAllocator>>("int/pool", ints);
+
+    vector<string> words = shuffled_words(n);
+    bench_allocator<BinarySearchTree<string, less<string>, AVLBalance,
+                                     HeapNodeAllocator>>("string/heap", words);
+    bench_allocator<BinarySearchTree<string, less<string>, AVLBalance,
+                                     PoolNodeAllocator>>("string/pool", words);
+  }
+}
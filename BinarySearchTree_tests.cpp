@@ -1,6 +1,14 @@
 #include "BinarySearchTree.hpp"
 #include "unit_test_framework.hpp"
-#include <functional>  // For std::greater
+#include <algorithm>   // For std::sort, std::binary_search
+#include <functional>  // For std::greater, std::function
+#include <cmath>       // For std::log2
+#include <iterator>    // For std::back_inserter
+#include <pthread.h>   // For threads with a small stack
+#include <random>      // For std::mt19937
+#include <sstream>     // For std::ostringstream
+#include <stdexcept>   // For std::invalid_argument
+#include <vector>
 
 
 TEST(test_stub) {
@@ -354,7 +362,992 @@ TEST(test_magical_forest_operations) {
   std::cout << "Modified Enchanted Tree (max element altered): " << EnchantedTree.to_string() << std::endl;
 }
 
+TEST(avl_rotations_keep_order) {
+  BinarySearchTree<int, std::less<int>, AVLBalance> tree;
+  tree.insert(10);
+  tree.insert(20);
+  tree.insert(30);
+  ASSERT_EQUAL(tree.height(), 2);
+  tree.insert(25);
+  tree.insert(27);  // right-left case
+  tree.insert(5);
+  tree.insert(7);   // left-right case
+  ASSERT_EQUAL(tree.size(), 7);
+  ASSERT_EQUAL(tree.height(), 3);
+  ASSERT_TRUE(tree.check_sorting_invariant());
+
+  std::ostringstream oss_inorder;
+  tree.traverse_inorder(oss_inorder);
+  ASSERT_EQUAL(oss_inorder.str(), "5 7 10 20 25 27 30 ");
+}
+
+TEST(avl_sorted_inserts_stay_logarithmic) {
+  const int n = 1000000;
+  BinarySearchTree<int, std::less<int>, AVLBalance> tree;
+  for (int i = 0; i < n; ++i) {
+    tree.insert(i);
+  }
+  ASSERT_EQUAL(tree.size(), static_cast<size_t>(n));
+  ASSERT_TRUE(tree.check_sorting_invariant());
+
+  // An AVL tree with n nodes has height < 1.4405 * log2(n + 2) - 0.3277
+  double bound = 1.4405 * std::log2(n + 2.0) - 0.3277;
+  ASSERT_TRUE(static_cast<double>(tree.height()) < bound);
+  ASSERT_EQUAL(*tree.min_element(), 0);
+  ASSERT_EQUAL(*tree.max_element(), n - 1);
+  ASSERT_TRUE(tree.find(n / 2) != tree.end());
+}
+
+// Counts every comparison made through it, so tests can check how much
+// work an operation does.
+struct CountingLess {
+  static int comparisons;
+  bool operator()(int lhs, int rhs) const {
+    ++comparisons;
+    return lhs < rhs;
+  }
+};
+int CountingLess::comparisons = 0;
+
+TEST(iterator_walk_makes_no_comparisons) {
+  BinarySearchTree<int, CountingLess, AVLBalance> tree;
+  for (int i = 0; i < 1000; ++i) {
+    tree.insert((i * 7919) % 1000);
+  }
+
+  CountingLess::comparisons = 0;
+  int expected = 0;
+  for (int elt : tree) {
+    ASSERT_EQUAL(elt, expected);
+    ++expected;
+  }
+  ASSERT_EQUAL(expected, 1000);
+  ASSERT_EQUAL(CountingLess::comparisons, 0);
+}
+
+TEST(iterator_is_a_single_pointer) {
+  ASSERT_EQUAL(sizeof(BinarySearchTree<std::string>::Iterator), sizeof(void *));
+}
+
+TEST(iterator_walks_copied_tree) {
+  BinarySearchTree<int> tree;
+  tree.insert(4);
+  tree.insert(2);
+  tree.insert(6);
+  tree.insert(1);
+  tree.insert(3);
+  tree.insert(5);
+  tree.insert(7);
+  BinarySearchTree<int> copy(tree);
+
+  std::ostringstream oss;
+  oss << copy;
+  ASSERT_EQUAL(oss.str(), "[ 1 2 3 4 5 6 7 ]");
+
+  auto it = copy.find(3);
+  ++it;
+  ASSERT_EQUAL(*it, 4);
+  it = copy.max_element();
+  ++it;
+  ASSERT_TRUE(it == copy.end());
+}
+
+TEST(pool_allocator_tree) {
+  using Pool_tree = BinarySearchTree<std::string, std::less<std::string>,
+                                     AVLBalance, PoolNodeAllocator>;
+  Pool_tree tree;
+  for (int i = 0; i < 5000; ++i) {
+    // long enough to defeat the small string optimization
+    tree.insert("a fairly long key that lives on the heap " + std::to_string(i));
+  }
+  ASSERT_EQUAL(tree.size(), 5000);
+  ASSERT_TRUE(tree.check_sorting_invariant());
+
+  Pool_tree copy(tree);
+  ASSERT_EQUAL(copy.size(), 5000);
+  ASSERT_TRUE(copy.find("a fairly long key that lives on the heap 4999")
+              != copy.end());
+
+  copy = Pool_tree();
+  ASSERT_TRUE(copy.empty());
+  copy.insert("b");
+  copy.insert("a");
+  ASSERT_EQUAL(*copy.begin(), "a");
+
+  tree = copy;
+  ASSERT_EQUAL(tree.size(), 2);
+  ASSERT_EQUAL(*tree.max_element(), "b");
+}
+
+TEST(pool_allocator_reuses_freed_nodes) {
+  struct Node {
+    Node(int datum_in) : datum(datum_in) { }
+    int datum;
+  };
+  PoolNodeAllocator<Node> pool;
+  Node *first = pool.create(1);
+  Node *second = pool.create(2);
+  ASSERT_TRUE(first != second);
+  pool.destroy(first);
+  Node *third = pool.create(3);
+  ASSERT_TRUE(third == first);
+  ASSERT_EQUAL(third->datum, 3);
+  ASSERT_EQUAL(second->datum, 2);
+  pool.release_all();
+}
+
+TEST(size_and_height_are_maintained) {
+  BinarySearchTree<int> chain;
+  BinarySearchTree<int, std::less<int>, AVLBalance> balanced;
+  for (int i = 1; i <= 127; ++i) {
+    chain.insert(i);
+    balanced.insert(i);
+    ASSERT_EQUAL(chain.size(), static_cast<size_t>(i));
+    ASSERT_EQUAL(chain.height(), static_cast<size_t>(i));
+    ASSERT_EQUAL(balanced.size(), static_cast<size_t>(i));
+  }
+  ASSERT_EQUAL(balanced.height(), 7);
+
+  BinarySearchTree<int> chain_copy(chain);
+  ASSERT_EQUAL(chain_copy.size(), 127);
+  ASSERT_EQUAL(chain_copy.height(), 127);
+
+  chain_copy = BinarySearchTree<int>();
+  ASSERT_TRUE(chain_copy.empty());
+  ASSERT_EQUAL(chain_copy.size(), 0);
+  ASSERT_EQUAL(chain_copy.height(), 0);
+
+  chain = chain;
+  ASSERT_EQUAL(chain.size(), 127);
+}
+
+// Runs 'body' to completion on a new thread whose stack is only
+// 'stack_bytes' long, so that deep recursion crashes quickly.
+void run_with_small_stack(std::function<void()> body, size_t stack_bytes) {
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, stack_bytes);
+  pthread_t thread;
+  auto run = [](void *arg) -> void * {
+    (*static_cast<std::function<void()> *>(arg))();
+    return nullptr;
+  };
+  ASSERT_EQUAL(pthread_create(&thread, &attr, run, &body), 0);
+  pthread_join(thread, nullptr);
+  pthread_attr_destroy(&attr);
+}
+
+TEST(degenerate_chain_does_not_overflow_stack) {
+  // Each new minimum inserted at the hint begin() is splayed to the root
+  // with the old tree as its right child, so this builds a chain of n
+  // nodes in linear time. Anything that recursed once per level would
+  // need tens of megabytes of stack here.
+  using Chain = BinarySearchTree<int, std::less<int>, SplayBalance>;
+  const int n = 1000000;
+  bool done = false;
+  run_with_small_stack([&]() {
+    Chain chain;
+    for (int i = n - 1; i >= 0; --i) {
+      chain.insert(chain.begin(), i);
+    }
+    Chain copy(chain);
+    Chain assigned;
+    assigned = copy;
+
+    int expected = 0;
+    for (int elt : assigned) {
+      if (elt != expected) {
+        return;
+      }
+      ++expected;
+    }
+    std::ostringstream inorder;
+    std::ostringstream preorder;
+    copy.traverse_inorder(inorder);
+    copy.traverse_preorder(preorder);
+    done = expected == n && copy.height() == static_cast<size_t>(n)
+           && copy.check_sorting_invariant()
+           && inorder.str() == preorder.str()
+           && *copy.min_greater_than(n - 2) == n - 1;
+  }, 64 * 1024);
+  ASSERT_TRUE(done);
+}
+
+TEST(preorder_traversal_iterative) {
+  BinarySearchTree<int> tree;
+  for (int elt : {8, 4, 12, 2, 6, 10, 14, 1, 3, 7, 13}) {
+    tree.insert(elt);
+  }
+  std::ostringstream oss;
+  tree.traverse_preorder(oss);
+  ASSERT_EQUAL(oss.str(), "8 4 2 1 3 6 7 12 10 14 13 ");
+}
+
+TEST(sorting_invariant_checks_whole_subtrees) {
+  BinarySearchTree<int> tree;
+  tree.insert(10);
+  tree.insert(5);
+  tree.insert(7);
+  ASSERT_TRUE(tree.check_sorting_invariant());
+  // 12 is still greater than its parent 5, but it sits in the left
+  // subtree of 10
+  *tree.find(7) = 12;
+  ASSERT_FALSE(tree.check_sorting_invariant());
+}
+
+// Records how often it has been copied, to check what moves and
+// in-place construction save.
+struct CopyCounter {
+  static int copies;
+  int value;
+  CopyCounter(int value_in) : value(value_in) { }
+  CopyCounter(const CopyCounter &other) : value(other.value) { ++copies; }
+  CopyCounter(CopyCounter &&other) = default;
+  CopyCounter &operator=(const CopyCounter &) = default;
+  bool operator<(const CopyCounter &rhs) const { return value < rhs.value; }
+};
+int CopyCounter::copies = 0;
+
+TEST(move_construct_and_assign_steal_nodes) {
+  BinarySearchTree<int, std::less<int>, AVLBalance, PoolNodeAllocator> tree;
+  for (int i = 0; i < 100; ++i) {
+    tree.insert(i);
+  }
+  auto first = tree.begin();
+
+  auto moved(std::move(tree));
+  ASSERT_TRUE(tree.empty());
+  ASSERT_EQUAL(tree.size(), 0);
+  ASSERT_EQUAL(moved.size(), 100);
+  ASSERT_TRUE(moved.begin() == first);  // same nodes, nothing copied
+
+  BinarySearchTree<int, std::less<int>, AVLBalance, PoolNodeAllocator> other;
+  other.insert(500);
+  other = std::move(moved);
+  ASSERT_TRUE(moved.empty());
+  ASSERT_EQUAL(other.size(), 100);
+  ASSERT_TRUE(other.begin() == first);
+  ASSERT_TRUE(other.find(500) == other.end());
+
+  // the moved-from trees are still usable
+  tree.insert(7);
+  moved.insert(8);
+  ASSERT_EQUAL(*tree.begin(), 7);
+  ASSERT_EQUAL(*moved.begin(), 8);
+}
+
+TEST(emplace_and_rvalue_insert_do_not_copy) {
+  BinarySearchTree<CopyCounter> tree;
+  CopyCounter::copies = 0;
+  tree.insert(CopyCounter(2));
+  CopyCounter three(3);
+  tree.insert(std::move(three));
+  ASSERT_TRUE(tree.emplace(1).second);
+  ASSERT_EQUAL(CopyCounter::copies, 0);
+
+  auto duplicate = tree.emplace(2);
+  ASSERT_FALSE(duplicate.second);
+  ASSERT_EQUAL(duplicate.first->value, 2);
+  ASSERT_EQUAL(tree.size(), 3);
+
+  auto tried = tree.try_emplace(CopyCounter(4), 4);
+  ASSERT_TRUE(tried.second);
+  ASSERT_EQUAL(tried.first->value, 4);
+  ASSERT_FALSE(tree.try_emplace(CopyCounter(4), 4).second);
+  ASSERT_EQUAL(tree.size(), 4);
+  ASSERT_EQUAL(CopyCounter::copies, 0);
+  ASSERT_TRUE(tree.check_sorting_invariant());
+}
+
+TEST(from_sorted_builds_balanced_tree) {
+  std::vector<int> keys;
+  for (int i = 0; i < 1000000; ++i) {
+    keys.push_back(2 * i);
+  }
+  CountingLess::comparisons = 0;
+  auto tree = BinarySearchTree<int, CountingLess, AVLBalance>::from_sorted(
+    keys.begin(), keys.end(), false);
+  ASSERT_EQUAL(CountingLess::comparisons, 0);
+  ASSERT_EQUAL(tree.size(), keys.size());
+  ASSERT_EQUAL(tree.height(), 20);  // floor(log2(1000000)) + 1
+  ASSERT_TRUE(tree.check_sorting_invariant());
+  ASSERT_TRUE(tree.find(1234) != tree.end());
+  ASSERT_TRUE(tree.find(1235) == tree.end());
+
+  // the result is a valid AVL tree that later inserts keep balanced
+  tree.insert(-1);
+  tree.insert(1);
+  ASSERT_EQUAL(*tree.begin(), -1);
+  ASSERT_TRUE(tree.check_sorting_invariant());
+
+  int expected = -1;
+  for (int elt : tree) {
+    ASSERT_EQUAL(elt, expected);
+    expected = expected < 2 ? expected + 1 : expected + 2;
+  }
+}
+
+TEST(from_sorted_small_and_verified) {
+  std::vector<int> empty;
+  auto none = BinarySearchTree<int>::from_sorted(empty.begin(), empty.end());
+  ASSERT_TRUE(none.empty());
+
+  std::vector<int> keys = {1, 2, 3, 4, 5, 6, 7};
+  auto tree = BinarySearchTree<int>::from_sorted(keys.begin(), keys.end());
+  std::ostringstream preorder;
+  tree.traverse_preorder(preorder);
+  ASSERT_EQUAL(preorder.str(), "4 2 1 3 6 5 7 ");
+  ASSERT_EQUAL(tree.height(), 3);
+
+  std::vector<int> unsorted = {1, 3, 2};
+  std::vector<int> duplicates = {1, 2, 2, 3};
+  bool threw = false;
+  try {
+    BinarySearchTree<int>::from_sorted(unsorted.begin(), unsorted.end());
+  }
+  catch (const std::invalid_argument &) {
+    threw = true;
+  }
+  ASSERT_TRUE(threw);
+  threw = false;
+  try {
+    BinarySearchTree<int>::from_sorted(duplicates.begin(), duplicates.end());
+  }
+  catch (const std::invalid_argument &) {
+    threw = true;
+  }
+  ASSERT_TRUE(threw);
+}
+
+TEST(freeze_snapshot_matches_tree) {
+  for (int n : {0, 1, 2, 3, 7, 8, 100, 1023, 1024, 1025}) {
+    BinarySearchTree<int, std::less<int>, AVLBalance> tree;
+    for (int i = 0; i < n; ++i) {
+      tree.insert((i * 37) % n * 2);
+    }
+    FrozenSearchTree<int> frozen = tree.freeze();
+    ASSERT_EQUAL(frozen.size(), tree.size());
+    ASSERT_EQUAL(frozen.empty(), tree.empty());
+
+    std::vector<int> from_tree(tree.begin(), tree.end());
+    std::vector<int> from_frozen(frozen.begin(), frozen.end());
+    ASSERT_EQUAL(from_tree, from_frozen);
+
+    for (int i = -1; i <= 2 * n; ++i) {
+      auto it = frozen.find(i);
+      if (i >= 0 && i % 2 == 0 && i < 2 * n) {
+        ASSERT_TRUE(it != frozen.end());
+        ASSERT_EQUAL(*it, i);
+      }
+      else {
+        ASSERT_TRUE(it == frozen.end());
+      }
+    }
+  }
+}
+
+// An element type with no default constructor
+struct Explicit_int {
+  explicit Explicit_int(int value_in) : value(value_in) { }
+  int value;
+};
+
+struct Explicit_int_less {
+  bool operator()(const Explicit_int &lhs, const Explicit_int &rhs) const {
+    return lhs.value < rhs.value;
+  }
+};
+
+TEST(freeze_is_independent_of_tree) {
+  BinarySearchTree<std::string> tree;
+  tree.insert("b");
+  tree.insert("a");
+  auto frozen = tree.freeze();
+  tree.insert("c");
+  ASSERT_EQUAL(frozen.size(), 2);
+  ASSERT_TRUE(frozen.find("c") == frozen.end());
+  ASSERT_EQUAL(*frozen.begin(), "a");
+  ASSERT_EQUAL(*frozen.lower_bound("aa"), "b");
+  ASSERT_TRUE(frozen.lower_bound("z") == frozen.end());
+
+  // iterators refer to the elements, which a move does not relocate
+  auto first = frozen.begin();
+  auto moved = std::move(frozen);
+  ASSERT_TRUE(first == moved.begin());
+  ASSERT_EQUAL(*first, "a");
+
+  // the elements need not be default-constructible
+  BinarySearchTree<Explicit_int, Explicit_int_less> explicit_tree;
+  for (int i = 0; i < 20; ++i) {
+    explicit_tree.insert(Explicit_int((i * 7) % 20));
+  }
+  auto explicit_frozen = explicit_tree.freeze();
+  int expected = 0;
+  for (const Explicit_int &elt : explicit_frozen) {
+    ASSERT_EQUAL(elt.value, expected);
+    ++expected;
+  }
+  ASSERT_EQUAL(expected, 20);
+  ASSERT_EQUAL(explicit_frozen.find(Explicit_int(13))->value, 13);
+}
+
+
+TEST(lower_upper_bound_and_equal_range) {
+  BinarySearchTree<int, std::less<int>, AVLBalance> tree;
+  for (int i = 0; i < 100; ++i) {
+    tree.insert((i * 37) % 100 * 2);
+  }
+  for (int i = -1; i <= 200; ++i) {
+    auto lower = tree.lower_bound(i);
+    auto upper = tree.upper_bound(i);
+    int expected_lower = i < 0 ? 0 : i + i % 2;
+    int expected_upper = i < 0 ? 0 : i + 2 - i % 2;
+    if (expected_lower < 200) {
+      ASSERT_EQUAL(*lower, expected_lower);
+    }
+    else {
+      ASSERT_TRUE(lower == tree.end());
+    }
+    if (expected_upper < 200) {
+      ASSERT_EQUAL(*upper, expected_upper);
+    }
+    else {
+      ASSERT_TRUE(upper == tree.end());
+    }
+
+    auto equal = tree.equal_range(i);
+    ASSERT_TRUE(equal.first == lower);
+    ASSERT_TRUE(equal.second == (i >= 0 && i % 2 == 0 && i < 200
+                                 ? upper : lower));
+  }
+}
+
+TEST(range_visits_half_open_interval) {
+  BinarySearchTree<int, std::less<int>, AVLBalance> tree;
+  for (int i = 0; i < 50; ++i) {
+    tree.insert(i * 2);
+  }
+  std::vector<int> evens(tree.range(10, 20).begin(), tree.range(10, 20).end());
+  ASSERT_TRUE(evens == std::vector<int>({10, 12, 14, 16, 18}));
+  std::vector<int> odds;
+  for (int elt : tree.range(11, 21)) {
+    odds.push_back(elt);
+  }
+  ASSERT_TRUE(odds == std::vector<int>({12, 14, 16, 18, 20}));
+
+  ASSERT_TRUE(tree.range(10, 11).begin() != tree.range(10, 11).end());
+  ASSERT_TRUE(tree.range(11, 12).empty());
+  ASSERT_TRUE(tree.range(20, 10).empty());
+  ASSERT_TRUE(tree.range(200, 100).empty());
+  ASSERT_TRUE(tree.range(-10, 0).empty());
+  ASSERT_EQUAL(std::distance(tree.range(-10, 1000).begin(),
+                             tree.range(-10, 1000).end()), 50);
+  ASSERT_TRUE(BinarySearchTree<int>().range(0, 10).empty());
+}
+
+TEST(erase_keeps_order_and_balance) {
+  const int n = 2000;
+  BinarySearchTree<int, std::less<int>, AVLBalance, PoolNodeAllocator> tree;
+  for (int i = 0; i < n; ++i) {
+    tree.insert(i);
+  }
+  auto last = tree.max_element();
+  // erase the even keys in a scrambled order, two-child nodes included
+  for (int i = 0; i < n / 2; ++i) {
+    int key = (i * 7919) % (n / 2) * 2;
+    ASSERT_EQUAL(tree.erase(key), 1);
+    ASSERT_EQUAL(tree.erase(key), 0);
+  }
+  ASSERT_EQUAL(tree.size(), n / 2);
+  ASSERT_TRUE(tree.check_sorting_invariant());
+  ASSERT_TRUE(tree.height() <= 1.44 * std::log2(n / 2 + 2));
+  ASSERT_EQUAL(*last, n - 1);
+
+  int expected = 1;
+  for (int elt : tree) {
+    ASSERT_EQUAL(elt, expected);
+    expected += 2;
+  }
+}
+
+TEST(erase_iterator_returns_next) {
+  BinarySearchTree<int> tree;
+  for (int key : {50, 30, 70, 20, 40, 60, 80, 35, 45}) {
+    tree.insert(key);
+  }
+  auto kept = tree.find(45);
+  auto next = tree.erase(tree.find(30));
+  ASSERT_EQUAL(*next, 35);
+  ASSERT_EQUAL(*kept, 45);
+  next = tree.erase(tree.find(80));
+  ASSERT_TRUE(next == tree.end());
+  next = tree.erase(tree.find(50));
+  ASSERT_EQUAL(*next, 60);
+  ASSERT_TRUE(tree.check_sorting_invariant());
+  ASSERT_EQUAL(tree.size(), 6);
+
+  std::ostringstream oss;
+  tree.traverse_inorder(oss);
+  ASSERT_EQUAL(oss.str(), "20 35 40 45 60 70 ");
+  ASSERT_EQUAL(tree.height(), 4);
+
+  next = tree.erase(tree.find(35), tree.find(60));
+  ASSERT_EQUAL(*next, 60);
+  ASSERT_EQUAL(tree.size(), 3);
+  tree.erase(tree.begin(), tree.end());
+  ASSERT_TRUE(tree.empty());
+  ASSERT_EQUAL(tree.height(), 0);
+}
+
+TEST(clear_recycles_pool_nodes) {
+  BinarySearchTree<int, std::less<int>, AVLBalance, PoolNodeAllocator> tree;
+  for (int i = 0; i < 100; ++i) {
+    tree.insert(i);
+  }
+  std::vector<const int *> addresses;
+  for (const int &elt : tree) {
+    addresses.push_back(&elt);
+  }
+  tree.clear();
+  ASSERT_TRUE(tree.empty());
+  ASSERT_EQUAL(tree.size(), 0);
+  ASSERT_TRUE(tree.begin() == tree.end());
+
+  // every new node reuses the storage of a cleared one
+  std::sort(addresses.begin(), addresses.end());
+  for (int i = 0; i < 100; ++i) {
+    const int *address = &*tree.insert(i);
+    ASSERT_TRUE(std::binary_search(addresses.begin(), addresses.end(),
+                                   address));
+  }
+  ASSERT_EQUAL(tree.size(), 100);
+}
+
+// Checks select() and rank() against the elements in 'expected', which
+// must be the contents of 'tree' in ascending order.
+template <typename Tree>
+void check_order_statistics(const Tree &tree, const std::vector<int> &expected) {
+  ASSERT_EQUAL(tree.size(), expected.size());
+  for (size_t k = 0; k < expected.size(); ++k) {
+    ASSERT_EQUAL(*tree.select(k), expected[k]);
+    ASSERT_EQUAL(tree.rank(expected[k]), k);
+    // odd numbers fall between the even keys
+    ASSERT_EQUAL(tree.rank(expected[k] + 1), k + 1);
+  }
+  ASSERT_TRUE(tree.select(expected.size()) == tree.end());
+  ASSERT_EQUAL(tree.rank(-1), 0);
+}
+
+TEST(order_statistics_after_inserts_and_erases) {
+  BinarySearchTree<int, std::less<int>, AVLBalance, HeapNodeAllocator,
+                   OrderStatistics> avl;
+  BinarySearchTree<int, std::less<int>, Unbalanced, HeapNodeAllocator,
+                   OrderStatistics> plain;
+  std::vector<int> expected;
+  for (int i = 0; i < 500; ++i) {
+    int key = (i * 37) % 500 * 2;
+    avl.insert(key);
+    plain.insert(key);
+  }
+  for (int i = 0; i < 500; ++i) {
+    expected.push_back(2 * i);
+  }
+  check_order_statistics(avl, expected);
+  check_order_statistics(plain, expected);
+
+  for (int i = 0; i < 500; i += 3) {
+    avl.erase(2 * i);
+    plain.erase(2 * i);
+    expected.erase(std::find(expected.begin(), expected.end(), 2 * i));
+  }
+  check_order_statistics(avl, expected);
+  check_order_statistics(plain, expected);
+
+  // copies and balanced builds carry the sizes along
+  auto copy = avl;
+  check_order_statistics(copy, expected);
+  auto built = decltype(avl)::from_sorted(expected.begin(), expected.end());
+  check_order_statistics(built, expected);
+}
+
+// EFFECTS: Returns 'count' distinct keys drawn from [0, range), in
+//          random order.
+std::vector<int> random_keys(int count, int range, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::vector<bool> taken(range);
+  std::vector<int> keys;
+  while (static_cast<int>(keys.size()) < count) {
+    int key = static_cast<int>(rng() % range);
+    if (!taken[key]) {
+      taken[key] = true;
+      keys.push_back(key);
+    }
+  }
+  return keys;
+}
 
+TEST(set_operations_match_sorted_ranges) {
+  using Tree = BinarySearchTree<int, std::less<int>, AVLBalance,
+                                PoolNodeAllocator>;
+  std::vector<int> mine_keys = random_keys(30000, 60000, 1);
+  std::vector<int> theirs_keys = random_keys(20000, 60000, 2);
+  std::vector<int> mine_sorted = mine_keys;
+  std::vector<int> theirs_sorted = theirs_keys;
+  std::sort(mine_sorted.begin(), mine_sorted.end());
+  std::sort(theirs_sorted.begin(), theirs_sorted.end());
+
+  // one thread, and enough threads that the top levels are forked
+  for (unsigned threads : {1u, 4u}) {
+    for (int operation = 0; operation < 3; ++operation) {
+      Tree mine;
+      Tree theirs;
+      for (int key : mine_keys) {
+        mine.insert(key);
+      }
+      for (int key : theirs_keys) {
+        theirs.insert(key);
+      }
+
+      std::vector<int> expected;
+      auto noop = [](int &, int &&) { };
+      if (operation == 0) {
+        mine.union_with(std::move(theirs), noop, threads);
+        std::set_union(mine_sorted.begin(), mine_sorted.end(),
+                       theirs_sorted.begin(), theirs_sorted.end(),
+                       std::back_inserter(expected));
+      }
+      else if (operation == 1) {
+        mine.intersection(std::move(theirs), noop, threads);
+        std::set_intersection(mine_sorted.begin(), mine_sorted.end(),
+                              theirs_sorted.begin(), theirs_sorted.end(),
+                              std::back_inserter(expected));
+      }
+      else {
+        mine.difference(std::move(theirs), threads);
+        std::set_difference(mine_sorted.begin(), mine_sorted.end(),
+                            theirs_sorted.begin(), theirs_sorted.end(),
+                            std::back_inserter(expected));
+      }
+
+      ASSERT_TRUE(theirs.empty());
+      ASSERT_EQUAL(mine.size(), expected.size());
+      ASSERT_TRUE(mine.check_sorting_invariant());
+      ASSERT_TRUE(mine.height() <= 1.44 * std::log2(mine.size() + 2));
+      ASSERT_TRUE(std::equal(mine.begin(), mine.end(), expected.begin()));
+      ASSERT_EQUAL(*mine.max_element(), expected.back());
+
+      // both trees stay usable, and the adopted pool hands out its
+      // freed nodes again
+      theirs.insert(7);
+      ASSERT_EQUAL(theirs.size(), 1);
+      mine.erase(expected[0]);
+      mine.insert(-1);
+      ASSERT_EQUAL(*mine.begin(), -1);
+      ASSERT_EQUAL(mine.size(), expected.size());
+    }
+  }
+}
+
+TEST(union_with_combines_equivalent_elements) {
+  // elements are (key, count) pairs ordered by key
+  struct KeyLess {
+    bool operator()(const std::pair<int, int> &a,
+                    const std::pair<int, int> &b) const {
+      return a.first < b.first;
+    }
+  };
+  BinarySearchTree<std::pair<int, int>, KeyLess, AVLBalance> mine;
+  BinarySearchTree<std::pair<int, int>, KeyLess, AVLBalance> theirs;
+  for (int i = 0; i < 5000; ++i) {
+    mine.insert({2 * i, 1});
+    theirs.insert({3 * i, 10});
+  }
+  mine.union_with(std::move(theirs),
+                  [](std::pair<int, int> &kept, std::pair<int, int> &&other) {
+                    kept.second += other.second;
+                  }, 2);
+
+  ASSERT_TRUE(theirs.empty());
+  ASSERT_TRUE(mine.check_sorting_invariant());
+  int expected_size = 0;
+  for (int key = 0; key < 15000; ++key) {
+    bool is_mine = key % 2 == 0 && key < 10000;
+    bool is_theirs = key % 3 == 0;
+    auto it = mine.find({key, 0});
+    if (!is_mine && !is_theirs) {
+      ASSERT_TRUE(it == mine.end());
+      continue;
+    }
+    ++expected_size;
+    ASSERT_EQUAL(it->second, (is_mine ? 1 : 0) + (is_theirs ? 10 : 0));
+  }
+  ASSERT_EQUAL(mine.size(), expected_size);
+}
+
+TEST(set_operations_keep_order_statistics) {
+  using Tree = BinarySearchTree<int, std::less<int>, AVLBalance,
+                                PoolNodeAllocator, OrderStatistics>;
+  Tree evens;
+  Tree multiples_of_four;
+  Tree odds;
+  for (int i = 0; i < 3000; ++i) {
+    evens.insert(2 * ((i * 7) % 3000));
+    odds.insert(2 * i + 1);
+    if (i % 2 == 0) {
+      multiples_of_four.insert(2 * i);
+    }
+  }
+  auto noop = [](int &, int &&) { };
+  Tree copy = evens;
+  copy.union_with(std::move(odds), noop);
+  ASSERT_EQUAL(copy.size(), 6000);
+  for (int k = 0; k < 6000; ++k) {
+    ASSERT_EQUAL(*copy.select(k), k);
+    ASSERT_EQUAL(copy.rank(k), k);
+  }
+
+  std::vector<int> expected;
+  for (int i = 0; i < 3000; ++i) {
+    if (i % 2 == 1) {
+      expected.push_back(2 * i);
+    }
+  }
+  evens.difference(std::move(multiples_of_four));
+  check_order_statistics(evens, expected);
+
+  // intersecting with an empty tree empties this one
+  evens.intersection(Tree(), noop);
+  ASSERT_TRUE(evens.empty());
+  ASSERT_TRUE(evens.max_element() == evens.end());
+}
+
+TEST(memory_usage_reports_nodes_and_depths) {
+  BinarySearchTree<int, std::less<int>, AVLBalance> empty;
+  MemoryUsage usage = empty.memory_usage();
+  ASSERT_EQUAL(usage.node_count, 0);
+  ASSERT_EQUAL(usage.total_bytes(), 0);
+  ASSERT_EQUAL(usage.max_depth, 0);
+  ASSERT_TRUE(usage.depth_histogram.empty());
+
+  // a perfectly balanced tree of 7 nodes has 1, 2 and 4 nodes per level
+  std::vector<int> sorted = {1, 2, 3, 4, 5, 6, 7};
+  auto tree = decltype(empty)::from_sorted(sorted.begin(), sorted.end());
+  usage = tree.memory_usage();
+  ASSERT_EQUAL(usage.node_count, 7);
+  ASSERT_EQUAL(usage.node_bytes % 7, 0);
+  ASSERT_TRUE(usage.node_bytes >= 7 * sizeof(int));
+  ASSERT_EQUAL(usage.element_heap_bytes, 0);
+  ASSERT_EQUAL(usage.allocator_slack_bytes, 0);
+  ASSERT_EQUAL(usage.max_depth, tree.height());
+  ASSERT_TRUE(usage.depth_histogram == std::vector<size_t>({1, 2, 4}));
+  ASSERT_ALMOST_EQUAL(usage.mean_depth, 17.0 / 7, 1e-9);
+
+  // a chain has one node per level
+  BinarySearchTree<int> chain;
+  for (int i = 0; i < 100; ++i) {
+    chain.insert(i);
+  }
+  usage = chain.memory_usage();
+  ASSERT_EQUAL(usage.max_depth, 100);
+  ASSERT_TRUE(usage.depth_histogram == std::vector<size_t>(100, 1));
+  ASSERT_ALMOST_EQUAL(usage.mean_depth, 50.5, 1e-9);
+}
+
+TEST(memory_usage_counts_pool_slack_and_strings) {
+  BinarySearchTree<std::string, std::less<std::string>, AVLBalance,
+                   PoolNodeAllocator> tree;
+  tree.insert("short");
+  std::string long_string(100, 'x');
+  tree.insert(long_string);
+  MemoryUsage usage = tree.memory_usage();
+  ASSERT_EQUAL(usage.node_count, 2);
+  ASSERT_TRUE(usage.element_heap_bytes >= 101);
+  ASSERT_TRUE(usage.allocator_slack_bytes > 0);
+
+  // erasing hands a node back to the pool: the pool holds as much as
+  // before, now with more slack
+  size_t held = usage.node_bytes + usage.allocator_slack_bytes;
+  tree.erase(long_string);
+  usage = tree.memory_usage();
+  ASSERT_EQUAL(usage.node_count, 1);
+  ASSERT_EQUAL(usage.element_heap_bytes, 0);
+  ASSERT_EQUAL(usage.node_bytes + usage.allocator_slack_bytes, held);
+}
+
+TEST(count_range_uses_ranks) {
+  BinarySearchTree<int, std::less<int>, AVLBalance, PoolNodeAllocator,
+                   OrderStatistics> tree;
+  for (int i = 0; i < 1000; ++i) {
+    tree.insert(i);
+  }
+  ASSERT_EQUAL(tree.count_range(100, 200), 100);
+  ASSERT_EQUAL(tree.count_range(-50, 50), 50);
+  ASSERT_EQUAL(tree.count_range(990, 5000), 10);
+  ASSERT_EQUAL(tree.count_range(200, 100), 0);
+  ASSERT_EQUAL(tree.count_range(5, 5), 0);
+  // 90th percentile cut-off
+  ASSERT_EQUAL(*tree.select(tree.size() * 9 / 10), 900);
+}
+
+TEST(splay_access_moves_element_to_root) {
+  BinarySearchTree<int, std::less<int>, SplayBalance> tree;
+  for (int i = 1; i <= 100; ++i) {
+    tree.insert(i);
+  }
+  // each insert splays the new maximum to the root, leaving a chain
+  ASSERT_EQUAL(tree.height(), 100);
+  auto it = tree.find(50);
+
+  auto found = tree.access(1);
+  ASSERT_EQUAL(*found, 1);
+  ASSERT_TRUE(found == tree.begin());
+  ASSERT_TRUE(tree.check_sorting_invariant());
+  ASSERT_EQUAL(tree.size(), 100);
+  // splaying the deepest node roughly halves the depth of its path
+  ASSERT_TRUE(tree.height() < 60);
+  std::ostringstream preorder;
+  tree.traverse_preorder(preorder);
+  ASSERT_EQUAL(preorder.str().substr(0, 2), "1 ");
+  // iterators survive restructuring
+  ASSERT_EQUAL(*it, 50);
+  ASSERT_EQUAL(*++it, 51);
+
+  // a miss splays the last element compared and finds nothing
+  ASSERT_TRUE(tree.access(1000) == tree.end());
+  std::ostringstream after_miss;
+  tree.traverse_preorder(after_miss);
+  ASSERT_EQUAL(after_miss.str().substr(0, 4), "100 ");
+}
+
+TEST(splay_hot_keys_need_few_comparisons) {
+  BinarySearchTree<int, CountingLess, SplayBalance> tree;
+  BinarySearchTree<int, CountingLess, AVLBalance> balanced;
+  for (int i = 0; i < 1000; ++i) {
+    tree.insert((i * 7919) % 1000);
+    balanced.insert((i * 7919) % 1000);
+  }
+  tree.access(777);
+  CountingLess::comparisons = 0;
+  ASSERT_EQUAL(*tree.access(777), 777);
+  ASSERT_EQUAL(CountingLess::comparisons, 2);
+
+  // balancing policies that do not adjust on access leave the tree alone
+  std::ostringstream before;
+  balanced.traverse_preorder(before);
+  ASSERT_EQUAL(*balanced.access(777), 777);
+  std::ostringstream after;
+  balanced.traverse_preorder(after);
+  ASSERT_EQUAL(before.str(), after.str());
+}
+
+TEST(splay_keeps_order_statistics) {
+  BinarySearchTree<int, std::less<int>, SplayBalance, HeapNodeAllocator,
+                   OrderStatistics> tree;
+  std::vector<int> expected;
+  for (int i = 0; i < 300; ++i) {
+    tree.insert((i * 37) % 300 * 2);
+    expected.push_back(2 * i);
+  }
+  check_order_statistics(tree, expected);
+  for (int i = 0; i < 300; i += 7) {
+    tree.access(i * 2);
+    tree.access(i * 2 + 1);
+  }
+  check_order_statistics(tree, expected);
+  for (int i = 0; i < 300; i += 4) {
+    tree.erase(2 * i);
+    expected.erase(std::find(expected.begin(), expected.end(), 2 * i));
+  }
+  check_order_statistics(tree, expected);
+}
+
+TEST(hinted_insert_places_elements) {
+  BinarySearchTree<int, std::less<int>, AVLBalance> tree;
+  auto end_hint = tree.insert(tree.end(), 50);
+  ASSERT_EQUAL(*end_hint, 50);
+  // right before the hint, right after it, and a wrong hint
+  ASSERT_EQUAL(*tree.insert(tree.find(50), 40), 40);
+  ASSERT_EQUAL(*tree.insert(tree.find(50), 60), 60);
+  ASSERT_EQUAL(*tree.insert(tree.find(40), 55), 55);
+  ASSERT_EQUAL(*tree.insert(tree.begin(), 45), 45);
+  ASSERT_EQUAL(*tree.emplace_hint(tree.end(), 70), 70);
+  ASSERT_EQUAL(*tree.emplace_hint(tree.find(70), 65), 65);
+  ASSERT_EQUAL(tree.size(), 7);
+
+  // an equivalent element is returned instead of inserting a duplicate
+  auto existing = tree.find(55);
+  ASSERT_TRUE(tree.insert(tree.find(60), 55) == existing);
+  ASSERT_TRUE(tree.insert(tree.end(), 55) == existing);
+  ASSERT_TRUE(tree.emplace_hint(existing, 55) == existing);
+  ASSERT_EQUAL(tree.size(), 7);
+
+  std::ostringstream inorder;
+  tree.traverse_inorder(inorder);
+  ASSERT_EQUAL(inorder.str(), "40 45 50 55 60 65 70 ");
+  ASSERT_TRUE(tree.check_sorting_invariant());
+}
+
+TEST(hinted_sorted_load_makes_constant_comparisons) {
+  const int n = 100000;
+  BinarySearchTree<int, CountingLess, AVLBalance> at_end;
+  BinarySearchTree<int, CountingLess, AVLBalance> after_previous;
+  CountingLess::comparisons = 0;
+  for (int i = 0; i < n; ++i) {
+    at_end.insert(at_end.end(), i);
+  }
+  // only the comparison with the current maximum
+  ASSERT_EQUAL(CountingLess::comparisons, n - 1);
+
+  CountingLess::comparisons = 0;
+  auto hint = after_previous.end();
+  for (int i = 0; i < n; ++i) {
+    hint = after_previous.insert(hint, i);
+  }
+  ASSERT_TRUE(CountingLess::comparisons <= 2 * n);
+  ASSERT_EQUAL(after_previous.size(), n);
+  ASSERT_TRUE(at_end.height() <= 1.45 * std::log2(n + 2));
+  ASSERT_TRUE(at_end.check_sorting_invariant());
+
+  // descending data hinted at the previous (smallest) element
+  BinarySearchTree<int, std::less<int>, AVLBalance> descending;
+  auto low = descending.end();
+  for (int i = n; i > 0; --i) {
+    low = descending.insert(low, i);
+  }
+  ASSERT_EQUAL(*descending.begin(), 1);
+  ASSERT_EQUAL(*descending.max_element(), n);
+  ASSERT_TRUE(descending.check_sorting_invariant());
+}
+
+TEST(max_element_is_tracked) {
+  BinarySearchTree<int, std::less<int>, AVLBalance> tree;
+  ASSERT_TRUE(tree.max_element() == tree.end());
+  for (int elt : {5, 3, 8, 1, 9, 7}) {
+    tree.insert(elt);
+  }
+  ASSERT_EQUAL(*tree.max_element(), 9);
+  tree.erase(9);
+  ASSERT_EQUAL(*tree.max_element(), 8);
+  tree.erase(8);
+  ASSERT_EQUAL(*tree.max_element(), 7);
+
+  auto copy = tree;
+  ASSERT_EQUAL(*copy.max_element(), 7);
+  auto moved = std::move(copy);
+  ASSERT_EQUAL(*moved.max_element(), 7);
+  ASSERT_TRUE(copy.max_element() == copy.end());
+
+  std::vector<int> sorted = {1, 2, 3};
+  auto built = decltype(tree)::from_sorted(sorted.begin(), sorted.end());
+  ASSERT_EQUAL(*built.max_element(), 3);
+  built.erase(built.begin(), built.end());
+  ASSERT_TRUE(built.max_element() == built.end());
+  built.insert(built.end(), 4);
+  ASSERT_EQUAL(*built.max_element(), 4);
+
+  tree.clear();
+  ASSERT_TRUE(tree.max_element() == tree.end());
+}
 
 TEST_MAIN()
 
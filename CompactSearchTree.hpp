@@ -0,0 +1,853 @@
+#ifndef COMPACT_SEARCH_TREE_HPP
+#define COMPACT_SEARCH_TREE_HPP
+/* CompactSearchTree.hpp
+ *
+ * An AVL-balanced binary search tree with the same interface as
+ * BinarySearchTree whose nodes all live in one std::vector and refer to
+ * each other by 32-bit index instead of by pointer. Map can use it as
+ * its backend:
+ *
+ *   Map<std::string, int, std::less<std::string>, PoolNodeAllocator,
+ *       CompactTreeBackend> counts;
+ *
+ * Compared with a BinarySearchTree node, each node saves half the space
+ * of its three links and the per-allocation overhead of the heap, nodes
+ * created together sit next to each other in memory, and the whole tree
+ * can be copied or relocated as a single array. Erasing moves the last
+ * node of the array into the hole, so the array never has gaps.
+ *
+ * INVARIANTS: Like BinarySearchTree, a CompactSearchTree holds no
+ * duplicates and obeys the sorting invariant, and, like one using
+ * AVLBalance, the heights of the two subtrees of every node differ by at
+ * most one. A CompactSearchTree holds fewer than 2^32 - 1 elements.
+ *
+ * Iterators are indices, so they stay valid when the array grows, but
+ * erasing may invalidate any iterator other than the one it returns, and
+ * moving a tree, which moves its array into another tree, invalidates
+ * every iterator into it.
+ * No operation recurses.
+ */
+
+#include <algorithm>  //max
+#include <cassert>    //assert
+#include <cstddef>    //size_t
+#include <cstdint>    //uint32_t
+#include <functional> //less
+#include <iostream>   //ostream
+#include <iterator>   //forward_iterator_tag, distance, next
+#include <memory>     //allocator
+#include <stdexcept>  //length_error
+#include <utility>    //pair, move, forward
+#include <vector>
+#include "FrozenSearchTree.hpp"
+#include "IteratorRange.hpp"
+
+template <typename T,
+          typename Compare=std::less<T>, // default if argument isn't provided
+          template <typename> class Allocator=std::allocator
+         >
+class CompactSearchTree {
+
+  // NOTE: T must be move constructible and move assignable, since nodes
+  //       move when the array grows or an element is erased.
+
+private:
+
+  using Index = uint32_t;
+
+  // The index that stands for "no node"
+  static constexpr Index none = UINT32_MAX;
+
+  // Marks the constructor arguments of a Node's datum
+  struct Emplace_tag { };
+
+  struct Node;
+
+  // The array of nodes, whose storage comes from Allocator
+  using Node_array = std::vector<Node, Allocator<Node>>;
+
+  // A Node stores an element, the indices of its children and its parent
+  // (none if absent) and the cached height of the subtree rooted at it.
+  struct Node {
+    template <typename... Args>
+    explicit Node(Emplace_tag, Args&&... args)
+      : datum(std::forward<Args>(args)...), left(none), right(none),
+        parent(none), height(1) { }
+
+    T datum;
+    Index left;
+    Index right;
+    Index parent;
+    Index height;
+  };
+
+public:
+
+  CompactSearchTree()
+    : root(none) { }
+
+  // Copying a tree copies its array of nodes; no links need updating
+  CompactSearchTree(const CompactSearchTree &other) = default;
+  CompactSearchTree &operator=(const CompactSearchTree &rhs) = default;
+
+  // A moved-from tree is left empty. Iterators into either tree are
+  // invalidated, as they refer to the tree and not to its array.
+  CompactSearchTree(CompactSearchTree &&other) noexcept
+    : nodes(std::move(other.nodes)), root(other.root) {
+    other.nodes.clear();
+    other.root = none;
+  }
+
+  CompactSearchTree &operator=(CompactSearchTree &&rhs) noexcept {
+    if (this != &rhs) {
+      nodes = std::move(rhs.nodes);
+      root = rhs.root;
+      rhs.nodes.clear();
+      rhs.root = none;
+    }
+    return *this;
+  }
+
+  // EFFECTS: Returns whether this tree is empty.
+  bool empty() const {
+    return root == none;
+  }
+
+  // EFFECTS: Returns the height of the tree.
+  // NOTE:    Heights are cached in the nodes, so this runs in constant time.
+  size_t height() const {
+    return height_of(root);
+  }
+
+  // EFFECTS: Returns the number of elements in this tree.
+  size_t size() const {
+    return nodes.size();
+  }
+
+  // MODIFIES: this tree
+  // EFFECTS : Reserves room for n elements, so that inserting up to n
+  //           elements does not move the nodes.
+  void reserve(size_t n) {
+    nodes.reserve(n);
+  }
+
+  // EFFECTS: Traverses the tree using an in-order traversal,
+  //          printing each element to os in turn. Each element is followed
+  //          by a space (there will be an "extra" space at the end).
+  //          If the tree is empty, nothing is printed.
+  void traverse_inorder(std::ostream &os) const {
+    for (const T &elt : *this) {
+      os << elt << " ";
+    }
+  }
+
+  // EFFECTS: Traverses the tree using a pre-order traversal,
+  //          printing each element to os in turn. Each element is followed
+  //          by a space (there will be an "extra" space at the end).
+  //          If the tree is empty, nothing is printed.
+  void traverse_preorder(std::ostream &os) const {
+    Index current = root;
+    while (current != none) {
+      const Node &node = nodes[current];
+      os << node.datum << " ";
+      if (node.left != none) {
+        current = node.left;
+      }
+      else if (node.right != none) {
+        current = node.right;
+      }
+      else {
+        // Climb until we leave a left subtree whose parent has a right
+        // subtree still to visit.
+        while (current != root &&
+               (nodes[nodes[current].parent].right == current ||
+                nodes[nodes[current].parent].right == none)) {
+          current = nodes[current].parent;
+        }
+        current = current == root ? none : nodes[nodes[current].parent].right;
+      }
+    }
+  }
+
+  // EFFECTS: Returns whether or not the sorting invariant holds on
+  //          the root of this tree.
+  // NOTE:    A binary tree obeys the sorting invariant exactly when an
+  //          in-order walk visits its elements in strictly ascending
+  //          order.
+  bool check_sorting_invariant() const {
+    return is_strictly_ascending(begin(), end(), less);
+  }
+
+  class Iterator {
+    // OVERVIEW: Iterator interface for CompactSearchTree.
+    //           Iterates over the elements in ascending order.
+    //
+    // An Iterator is the array of nodes and an index into it. Advancing
+    // it follows child and parent links, so it performs no comparisons.
+
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = T *;
+    using reference = T &;
+
+    Iterator()
+      : nodes(nullptr), index(none) { }
+
+    // EFFECTS:  Returns the current element by reference.
+    // WARNING:  Any modification must result in a value that compares
+    //           equal to the existing one, or the sorting invariant will
+    //           no longer hold.
+    T &operator*() const {
+      return (*nodes)[index].datum;
+    }
+
+    // EFFECTS:  Returns the current element by pointer.
+    // WARNING:  Same as for operator*.
+    T *operator->() const {
+      return &(*nodes)[index].datum;
+    }
+
+    // Prefix ++
+    Iterator &operator++() {
+      index = successor_impl(*nodes, index);
+      return *this;
+    }
+
+    // Postfix ++ (implemented in terms of prefix ++)
+    Iterator operator++(int) {
+      Iterator result(*this);
+      ++(*this);
+      return result;
+    }
+
+    bool operator==(const Iterator &rhs) const {
+      return index == rhs.index;
+    }
+
+    bool operator!=(const Iterator &rhs) const {
+      return index != rhs.index;
+    }
+
+  private:
+    friend class CompactSearchTree;
+
+    Node_array *nodes;
+    Index index;
+
+    // Iterators let the elements of a const tree be modified, like those
+    // of BinarySearchTree, whose const members hand out Node pointers.
+    Iterator(const CompactSearchTree *tree, Index index_in)
+      : nodes(const_cast<Node_array *>(&tree->nodes)),
+        index(index_in) { }
+
+  }; // CompactSearchTree::Iterator
+  ////////////////////////////////////////
+
+
+  // EFFECTS : Returns an iterator to the first element in this tree.
+  Iterator begin() const {
+    return Iterator(this, min_element_impl(root));
+  }
+
+  // EFFECTS : Returns an iterator to "past-the-end".
+  Iterator end() const {
+    return Iterator(this, none);
+  }
+
+  // EFFECTS : Returns an iterator to the minimum element, or an end
+  //           iterator if the tree is empty.
+  Iterator min_element() const {
+    return begin();
+  }
+
+  // EFFECTS : Returns an iterator to the maximum element, or an end
+  //           iterator if the tree is empty.
+  Iterator max_element() const {
+    Index node = root;
+    while (node != none && nodes[node].right != none) {
+      node = nodes[node].right;
+    }
+    return Iterator(this, node);
+  }
+
+  // EFFECTS : Returns an iterator to the minimum element that is greater
+  //           than value, or an end iterator if there is none.
+  Iterator min_greater_than(const T &value) const {
+    return upper_bound(value);
+  }
+
+  // EFFECTS: Returns an Iterator to the first element that is not less
+  //          than key, or an end Iterator if there is none.
+  template <typename Key>
+  Iterator lower_bound(const Key &key) const {
+    Index result = none;
+    Index node = root;
+    while (node != none) {
+      if (less(nodes[node].datum, key)) {
+        node = nodes[node].right;
+      }
+      else {
+        result = node;
+        node = nodes[node].left;
+      }
+    }
+    return Iterator(this, result);
+  }
+
+  // EFFECTS: Returns an Iterator to the first element that is greater
+  //          than key, or an end Iterator if there is none.
+  template <typename Key>
+  Iterator upper_bound(const Key &key) const {
+    Index result = none;
+    Index node = root;
+    while (node != none) {
+      if (less(key, nodes[node].datum)) {
+        result = node;
+        node = nodes[node].left;
+      }
+      else {
+        node = nodes[node].right;
+      }
+    }
+    return Iterator(this, result);
+  }
+
+  // EFFECTS: Returns the range of elements equivalent to key, as the pair
+  //          (lower_bound(key), upper_bound(key)). Since elements are
+  //          unique, it holds at most one element.
+  template <typename Key>
+  std::pair<Iterator, Iterator> equal_range(const Key &key) const {
+    return unique_equal_range(lower_bound(key), end(), key, less);
+  }
+
+  // EFFECTS: Returns a view of the elements that are not less than lo and
+  //          less than hi, in ascending order.
+  template <typename Key>
+  IteratorRange<Iterator> range(const Key &lo, const Key &hi) const {
+    return bounded_range(lower_bound(lo), lower_bound(hi), end(), less);
+  }
+
+  // EFFECTS: Searches this tree for an element equivalent to query.
+  //          Returns an iterator to the existing element if found,
+  //          and an end iterator otherwise.
+  Iterator find(const T &query) const {
+    return Iterator(this, find_impl(query));
+  }
+
+  // EFFECTS: Same as above, but query may be of any type that Compare
+  //          can compare against T in either order.
+  template <typename Key>
+  Iterator find(const Key &query) const {
+    return Iterator(this, find_impl(query));
+  }
+
+  // EFFECTS: Same as find(). A CompactSearchTree never adjusts its shape
+  //          on access; this exists so that code written for
+  //          BinarySearchTree's self-adjusting policies works unchanged.
+  template <typename Key>
+  Iterator access(const Key &query) const {
+    return find(query);
+  }
+
+  // REQUIRES: The given item is not already contained in this tree
+  // MODIFIES: this tree
+  // EFFECTS : Inserts a copy of item, maintaining the sorting invariant.
+  Iterator insert(const T &item) {
+    assert(find(item) == end());
+    return try_emplace(item, item).first;
+  }
+
+  // REQUIRES: The given item is not already contained in this tree
+  // MODIFIES: this tree
+  // EFFECTS : Same as above, but moves 'item' into the new node.
+  Iterator insert(T &&item) {
+    assert(find(item) == end());
+    Index parent = none;
+    bool go_left = false;
+    find_slot_impl(item, parent, go_left);
+    Index leaf = create_node(std::move(item));
+    link_leaf_impl(parent, go_left, leaf);
+    return Iterator(this, leaf);
+  }
+
+  // MODIFIES: this tree
+  // EFFECTS : Constructs an element in place from 'args' inside a new
+  //           node. If an equivalent element is already contained, the
+  //           new element is destroyed and an iterator to the existing
+  //           one is returned along with false. Otherwise the new element
+  //           is linked into the tree and returned along with true.
+  template <typename... Args>
+  std::pair<Iterator, bool> emplace(Args&&... args) {
+    Index node = create_node(std::forward<Args>(args)...);
+    Index parent = none;
+    bool go_left = false;
+    Index existing = find_slot_impl(nodes[node].datum, parent, go_left);
+    if (existing != none) {
+      nodes.pop_back();
+      return std::make_pair(Iterator(this, existing), false);
+    }
+    link_leaf_impl(parent, go_left, node);
+    return std::make_pair(Iterator(this, node), true);
+  }
+
+  // MODIFIES: this tree
+  // EFFECTS : Inserts item unless an equivalent element is already
+  //           contained, and returns an iterator to the new or existing
+  //           element.
+  // NOTE:     Provided so that Map can offer hinted insertion over any
+  //           backend. The hint is not used.
+  Iterator insert(Iterator, const T &item) {
+    return try_emplace(item, item).first;
+  }
+
+  // MODIFIES: this tree
+  // EFFECTS : Same as above, but moves item into the tree if it is
+  //           inserted.
+  Iterator insert(Iterator, T &&item) {
+    return try_emplace(item, std::move(item)).first;
+  }
+
+  // MODIFIES: this tree
+  // EFFECTS : Same as emplace(args...), but returns only the iterator.
+  //           The hint is not used.
+  template <typename... Args>
+  Iterator emplace_hint(Iterator, Args&&... args) {
+    return emplace(std::forward<Args>(args)...).first;
+  }
+
+  // MODIFIES: this tree
+  // EFFECTS : Searches this tree for an element equivalent to 'key'. If
+  //           one is found, returns an iterator to it along with false
+  //           and leaves 'args' untouched. Otherwise constructs a new
+  //           element in place from 'args' at the position found by that
+  //           same search and returns an iterator to it along with true.
+  // REQUIRES: The element constructed from 'args' is equivalent to 'key'.
+  template <typename Key, typename... Args>
+  std::pair<Iterator, bool> try_emplace(const Key &key, Args&&... args) {
+    Index parent = none;
+    bool go_left = false;
+    Index existing = find_slot_impl(key, parent, go_left);
+    if (existing != none) {
+      return std::make_pair(Iterator(this, existing), false);
+    }
+    Index node = create_node(std::forward<Args>(args)...);
+    link_leaf_impl(parent, go_left, node);
+    return std::make_pair(Iterator(this, node), true);
+  }
+
+  // REQUIRES: [first, last) is a forward range whose elements are in
+  //           strictly ascending order according to Compare
+  // EFFECTS : Returns a perfectly balanced tree holding the elements of
+  //           [first, last), built in linear time without comparing
+  //           elements. The nodes are stored in ascending order. If
+  //           'verify' is true, first checks the requirement in one
+  //           extra pass and throws std::invalid_argument if the range is
+  //           not strictly ascending (this includes duplicates).
+  template <typename ForwardIt>
+  static CompactSearchTree from_sorted(ForwardIt first, ForwardIt last,
+                                       bool verify = true) {
+    CompactSearchTree result;
+    if (verify) {
+      require_strictly_ascending(first, last, result.less);
+    }
+    size_t n = static_cast<size_t>(std::distance(first, last));
+    if (n >= none) {
+      throw std::length_error("CompactSearchTree: too many elements");
+    }
+    result.nodes.reserve(n);
+    for (; first != last; ++first) {
+      result.nodes.emplace_back(Emplace_tag(), *first);
+    }
+    result.link_balanced_impl();
+    return result;
+  }
+
+  // EFFECTS: Returns an immutable snapshot of this tree with its
+  //          elements laid out contiguously for fast searching (see
+  //          FrozenSearchTree.hpp).
+  FrozenSearchTree<T, Compare> freeze() const {
+    return FrozenSearchTree<T, Compare>(begin(), end(), size());
+  }
+
+  // REQUIRES: pos points to an element of this tree
+  // MODIFIES: this tree
+  // EFFECTS : Removes the element at pos and returns an Iterator to the
+  //           element that followed it. The last node of the array is
+  //           moved into the removed node's place, which invalidates
+  //           iterators to it.
+  Iterator erase(Iterator pos) {
+    Index node = pos.index;
+    Index next = successor_impl(nodes, node);
+    erase_impl(node);
+    Index moved = static_cast<Index>(nodes.size() - 1);
+    fill_hole_impl(node);
+    return Iterator(this, next == moved ? node : next);
+  }
+
+  // MODIFIES: this tree
+  // EFFECTS : Removes the elements in [first, last). Returns an Iterator
+  //           to the element that followed them.
+  Iterator erase(Iterator first, Iterator last) {
+    // erasing may move the node 'last' refers to, so count first
+    size_t count = 0;
+    for (Iterator it = first; it != last; ++it) {
+      ++count;
+    }
+    for (; count > 0; --count) {
+      first = erase(first);
+    }
+    return first;
+  }
+
+  // MODIFIES: this tree
+  // EFFECTS : Removes the element equivalent to key, if there is one,
+  //           and returns the number of elements removed (0 or 1).
+  template <typename Key>
+  size_t erase(const Key &key) {
+    Index node = find_impl(key);
+    if (node == none) {
+      return 0;
+    }
+    erase(Iterator(this, node));
+    return 1;
+  }
+
+  // MODIFIES: this tree
+  // EFFECTS : Removes every element. The array keeps its capacity.
+  void clear() {
+    nodes.clear();
+    root = none;
+  }
+
+private:
+
+  // DATA REPRESENTATION
+  // Every node of the tree, in no particular order
+  Node_array nodes;
+
+  // The index of the root node, or none if the tree is empty
+  Index root;
+
+  // An instance of the Compare type. Use this to compare elements.
+  Compare less;
+
+  // EFFECTS : Appends a new childless node constructed from 'args' and
+  //           returns its index.
+  template <typename... Args>
+  Index create_node(Args&&... args) {
+    if (nodes.size() >= none - 1) {
+      throw std::length_error("CompactSearchTree: too many elements");
+    }
+    nodes.emplace_back(Emplace_tag(), std::forward<Args>(args)...);
+    return static_cast<Index>(nodes.size() - 1);
+  }
+
+  Index height_of(Index node) const {
+    return node == none ? 0 : nodes[node].height;
+  }
+
+  void update_height(Index node) {
+    nodes[node].height = 1 + std::max(height_of(nodes[node].left),
+                                      height_of(nodes[node].right));
+  }
+
+  int balance_factor(Index node) const {
+    return static_cast<int>(height_of(nodes[node].left)) -
+           static_cast<int>(height_of(nodes[node].right));
+  }
+
+  // EFFECTS : Returns the index of the smallest element in the subtree
+  //           rooted at 'node', or none if it is empty.
+  Index min_element_impl(Index node) const {
+    while (node != none && nodes[node].left != none) {
+      node = nodes[node].left;
+    }
+    return node;
+  }
+
+  // EFFECTS : Returns the index of the element that follows 'node' in
+  //           order, or none if it is the last one.
+  static Index successor_impl(const Node_array &nodes, Index node) {
+    if (nodes[node].right != none) {
+      node = nodes[node].right;
+      while (nodes[node].left != none) {
+        node = nodes[node].left;
+      }
+      return node;
+    }
+    Index parent = nodes[node].parent;
+    while (parent != none && nodes[parent].right == node) {
+      node = parent;
+      parent = nodes[node].parent;
+    }
+    return parent;
+  }
+
+  // EFFECTS : Returns the index of the element equivalent to 'key', or
+  //           none if there is none.
+  template <typename Key>
+  Index find_impl(const Key &key) const {
+    Index node = root;
+    while (node != none) {
+      if (less(key, nodes[node].datum)) {
+        node = nodes[node].left;
+      }
+      else if (less(nodes[node].datum, key)) {
+        node = nodes[node].right;
+      }
+      else {
+        return node;
+      }
+    }
+    return none;
+  }
+
+  // EFFECTS : Searches the tree for an element equivalent to 'key'.
+  //           Returns its index if there is one. Otherwise returns none
+  //           and sets 'parent' and 'go_left' to where a new leaf for
+  //           'key' belongs.
+  template <typename Key>
+  Index find_slot_impl(const Key &key, Index &parent, bool &go_left) const {
+    parent = none;
+    Index node = root;
+    while (node != none) {
+      if (less(key, nodes[node].datum)) {
+        go_left = true;
+      }
+      else if (less(nodes[node].datum, key)) {
+        go_left = false;
+      }
+      else {
+        return node;
+      }
+      parent = node;
+      node = go_left ? nodes[node].left : nodes[node].right;
+    }
+    return none;
+  }
+
+  // REQUIRES: 'leaf' is a new childless node that belongs as the left
+  //           (if 'go_left') or right child of 'parent', which has no such
+  //           child; a parent of none means the tree is empty
+  // MODIFIES: this tree
+  // EFFECTS : Links 'leaf' into the tree and rebalances the path above it.
+  void link_leaf_impl(Index parent, bool go_left, Index leaf) {
+    nodes[leaf].parent = parent;
+    if (parent == none) {
+      root = leaf;
+    }
+    else {
+      (go_left ? nodes[parent].left : nodes[parent].right) = leaf;
+      rebalance_path_impl(parent);
+    }
+  }
+
+  // EFFECTS : Makes 'child' the child of 'parent' that 'old_child' was,
+  //           or the root if 'parent' is none.
+  void replace_child_impl(Index parent, Index old_child, Index child) {
+    if (parent == none) {
+      root = child;
+    }
+    else if (nodes[parent].left == old_child) {
+      nodes[parent].left = child;
+    }
+    else {
+      nodes[parent].right = child;
+    }
+  }
+
+  // REQUIRES: The subtrees below 'node' have correct cached heights
+  // MODIFIES: this tree
+  // EFFECTS : Restores the AVL invariant at 'node' and each of its
+  //           ancestors, stopping once a subtree comes back with the
+  //           height it had before.
+  void rebalance_path_impl(Index node) {
+    while (node != none) {
+      Index parent = nodes[node].parent;
+      Index old_height = nodes[node].height;
+      Index subtree = rebalance_impl(node);
+      replace_child_impl(parent, node, subtree);
+      if (nodes[subtree].height == old_height) {
+        return;
+      }
+      node = parent;
+    }
+  }
+
+  // EFFECTS : Same as AVLBalance::rebalance, on indices.
+  Index rebalance_impl(Index node) {
+    update_height(node);
+    int balance = balance_factor(node);
+    if (balance > 1) {
+      if (balance_factor(nodes[node].left) < 0) {
+        nodes[node].left = rotate_left_impl(nodes[node].left);
+      }
+      return rotate_right_impl(node);
+    }
+    if (balance < -1) {
+      if (balance_factor(nodes[node].right) > 0) {
+        nodes[node].right = rotate_right_impl(nodes[node].right);
+      }
+      return rotate_left_impl(node);
+    }
+    return node;
+  }
+
+  // EFFECTS : Same as BalanceBase::rotate_left, on indices.
+  Index rotate_left_impl(Index node) {
+    Index pivot = nodes[node].right;
+    nodes[node].right = nodes[pivot].left;
+    if (nodes[node].right != none) {
+      nodes[nodes[node].right].parent = node;
+    }
+    nodes[pivot].left = node;
+    nodes[pivot].parent = nodes[node].parent;
+    nodes[node].parent = pivot;
+    update_height(node);
+    update_height(pivot);
+    return pivot;
+  }
+
+  // EFFECTS : Same as BalanceBase::rotate_right, on indices.
+  Index rotate_right_impl(Index node) {
+    Index pivot = nodes[node].left;
+    nodes[node].left = nodes[pivot].right;
+    if (nodes[node].left != none) {
+      nodes[nodes[node].left].parent = node;
+    }
+    nodes[pivot].right = node;
+    nodes[pivot].parent = nodes[node].parent;
+    nodes[node].parent = pivot;
+    update_height(node);
+    update_height(pivot);
+    return pivot;
+  }
+
+  // MODIFIES: this tree
+  // EFFECTS : Unlinks 'node' from the tree, leaving it in the array, and
+  //           rebalances the path above the deepest node whose subtree
+  //           changed. A node with two children is replaced by its
+  //           successor, which is moved up into its place.
+  void erase_impl(Index node) {
+    Index rebalance_from;
+    Index replacement;
+    Node &erased = nodes[node];
+    if (erased.left != none && erased.right != none) {
+      replacement = min_element_impl(erased.right);
+      if (nodes[replacement].parent == node) {
+        rebalance_from = replacement;
+      }
+      else {
+        // detach the successor, which has no left child, and give it
+        // the right subtree of 'node'
+        rebalance_from = nodes[replacement].parent;
+        nodes[rebalance_from].left = nodes[replacement].right;
+        if (nodes[replacement].right != none) {
+          nodes[nodes[replacement].right].parent = rebalance_from;
+        }
+        nodes[replacement].right = erased.right;
+        nodes[erased.right].parent = replacement;
+      }
+      nodes[replacement].left = erased.left;
+      nodes[erased.left].parent = replacement;
+      nodes[replacement].height = erased.height;
+    }
+    else {
+      replacement = erased.left != none ? erased.left : erased.right;
+      rebalance_from = erased.parent;
+    }
+
+    if (replacement != none) {
+      nodes[replacement].parent = erased.parent;
+    }
+    replace_child_impl(erased.parent, node, replacement);
+    rebalance_path_impl(rebalance_from);
+  }
+
+  // REQUIRES: 'hole' is unlinked from the tree
+  // MODIFIES: this tree
+  // EFFECTS : Moves the last node of the array into 'hole', relinks it,
+  //           and shrinks the array by one.
+  void fill_hole_impl(Index hole) {
+    Index last = static_cast<Index>(nodes.size() - 1);
+    if (hole != last) {
+      nodes[hole] = std::move(nodes[last]);
+      Node &moved = nodes[hole];
+      replace_child_impl(moved.parent, last, hole);
+      if (moved.left != none) {
+        nodes[moved.left].parent = hole;
+      }
+      if (moved.right != none) {
+        nodes[moved.right].parent = hole;
+      }
+    }
+    nodes.pop_back();
+  }
+
+  // REQUIRES: The nodes are in ascending order and unlinked
+  // MODIFIES: this tree
+  // EFFECTS : Links the nodes into a perfectly balanced tree: the middle
+  //           node of every index range is the root of its subtree.
+  void link_balanced_impl() {
+    struct Span {
+      Index lo;
+      Index hi;
+      Index parent;
+      bool is_left;
+    };
+    root = none;
+    std::vector<Span> pending;
+    if (!nodes.empty()) {
+      pending.push_back(Span{0, static_cast<Index>(nodes.size()), none,
+                             false});
+    }
+    while (!pending.empty()) {
+      Span span = pending.back();
+      pending.pop_back();
+      Index mid = span.lo + (span.hi - span.lo) / 2;
+      Node &node = nodes[mid];
+      node.parent = span.parent;
+      // a span of m nodes is floor(log2(m)) + 1 levels deep
+      node.height = 0;
+      for (Index m = span.hi - span.lo; m > 0; m >>= 1) {
+        ++node.height;
+      }
+      if (span.parent == none) {
+        root = mid;
+      }
+      else {
+        (span.is_left ? nodes[span.parent].left
+                      : nodes[span.parent].right) = mid;
+      }
+      if (span.lo < mid) {
+        pending.push_back(Span{span.lo, mid, mid, true});
+      }
+      if (mid + 1 < span.hi) {
+        pending.push_back(Span{mid + 1, span.hi, mid, false});
+      }
+    }
+  }
+
+};
+
+// EFFECTS : Prints the elements of 'tree' in ascending order, in the same
+//           format as a BinarySearchTree.
+template <typename T, typename Compare, template <typename> class Allocator>
+std::ostream &operator<<(std::ostream &os,
+                         const CompactSearchTree<T, Compare, Allocator> &tree) {
+  os << "[ ";
+  for (T &elt : tree) {
+    os << elt << " ";
+  }
+  return os << "]";
+}
+
+// Map backend (see Map.hpp): a CompactSearchTree. Its nodes live in the
+// tree's own array, so the node allocator is not used.
+template <typename T, typename Compare,
+          template <typename> class NodeAllocator>
+using CompactTreeBackend = CompactSearchTree<T, Compare>;
+
+#endif // COMPACT_SEARCH_TREE_HPP
@@ -0,0 +1,247 @@
+#include "CompactSearchTree.hpp"
+#include "BinarySearchTree.hpp"
+#include "unit_test_framework.hpp"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+TEST(empty_tree) {
+  CompactSearchTree<int> tree;
+  ASSERT_TRUE(tree.empty());
+  ASSERT_EQUAL(tree.size(), 0);
+  ASSERT_EQUAL(tree.height(), 0);
+  ASSERT_TRUE(tree.begin() == tree.end());
+  ASSERT_TRUE(tree.find(3) == tree.end());
+  ASSERT_TRUE(tree.min_element() == tree.end());
+  ASSERT_TRUE(tree.max_element() == tree.end());
+  ASSERT_TRUE(tree.min_greater_than(3) == tree.end());
+  ASSERT_TRUE(tree.check_sorting_invariant());
+  ASSERT_EQUAL(tree.erase(3), 0);
+}
+
+TEST(insert_find_and_iterate) {
+  for (int n : {1, 2, 3, 10, 1000}) {
+    CompactSearchTree<int> tree;
+    for (int i = 0; i < n; ++i) {
+      int key = (i * 37) % n * 2;
+      ASSERT_EQUAL(*tree.insert(key), key);
+    }
+    ASSERT_EQUAL(tree.size(), n);
+    ASSERT_TRUE(tree.check_sorting_invariant());
+
+    int expected = 0;
+    for (int elt : tree) {
+      ASSERT_EQUAL(elt, expected);
+      expected += 2;
+    }
+    ASSERT_EQUAL(expected, 2 * n);
+    for (int i = 0; i < n; ++i) {
+      ASSERT_EQUAL(*tree.find(2 * i), 2 * i);
+      ASSERT_TRUE(tree.find(2 * i + 1) == tree.end());
+    }
+    ASSERT_EQUAL(*tree.min_element(), 0);
+    ASSERT_EQUAL(*tree.max_element(), 2 * n - 2);
+    ASSERT_TRUE(tree.min_greater_than(2 * n - 2) == tree.end());
+    if (n > 1) {
+      ASSERT_EQUAL(*tree.min_greater_than(0), 2);
+    }
+  }
+}
+
+TEST(matches_binary_search_tree_output) {
+  CompactSearchTree<int> compact;
+  BinarySearchTree<int, std::less<int>, AVLBalance> avl;
+  for (int i = 0; i < 50; ++i) {
+    compact.insert((i * 17) % 50);
+    avl.insert((i * 17) % 50);
+  }
+  // the same rotations build the same shape
+  std::ostringstream compact_pre, avl_pre, compact_out, avl_out;
+  compact.traverse_preorder(compact_pre);
+  avl.traverse_preorder(avl_pre);
+  ASSERT_EQUAL(compact_pre.str(), avl_pre.str());
+  ASSERT_EQUAL(compact.height(), avl.height());
+  compact_out << compact;
+  avl_out << avl;
+  ASSERT_EQUAL(compact_out.str(), avl_out.str());
+}
+
+TEST(sorted_inserts_stay_logarithmic) {
+  CompactSearchTree<int> tree;
+  const int n = 100000;
+  for (int i = 0; i < n; ++i) {
+    tree.insert(i);
+  }
+  ASSERT_TRUE(tree.height() <= 1.45 * std::log2(n + 2));
+  ASSERT_TRUE(tree.check_sorting_invariant());
+}
+
+TEST(iterators_survive_growth) {
+  CompactSearchTree<std::string> tree;
+  auto first = tree.insert("m");
+  for (int i = 0; i < 1000; ++i) {
+    tree.insert("k" + std::to_string(i));
+  }
+  ASSERT_EQUAL(*first, "m");
+  ASSERT_TRUE(first == tree.find("m"));
+  ASSERT_TRUE(++first == tree.end());
+}
+
+TEST(try_emplace_and_emplace) {
+  CompactSearchTree<std::pair<int, std::string>> tree;
+  auto result = tree.emplace(1, "one");
+  ASSERT_TRUE(result.second);
+  ASSERT_EQUAL(result.first->second, "one");
+  result = tree.emplace(1, "one");
+  ASSERT_FALSE(result.second);
+  ASSERT_TRUE(result.first == tree.begin());
+  ASSERT_EQUAL(tree.size(), 1);
+
+  result = tree.try_emplace(std::make_pair(2, std::string()), 2, "two");
+  ASSERT_TRUE(result.second);
+  ASSERT_EQUAL(result.first->second, "two");
+  ASSERT_EQUAL(tree.size(), 2);
+}
+
+TEST(copy_and_move) {
+  CompactSearchTree<int> tree;
+  for (int i = 0; i < 100; ++i) {
+    tree.insert(i);
+  }
+  CompactSearchTree<int> copy(tree);
+  tree.erase(50);
+  ASSERT_EQUAL(copy.size(), 100);
+  ASSERT_TRUE(copy.find(50) != copy.end());
+  ASSERT_TRUE(copy.check_sorting_invariant());
+
+  CompactSearchTree<int> moved(std::move(copy));
+  ASSERT_EQUAL(moved.size(), 100);
+  ASSERT_TRUE(copy.empty());
+  copy = moved;
+  moved = std::move(tree);
+  ASSERT_EQUAL(moved.size(), 99);
+  ASSERT_EQUAL(copy.size(), 100);
+}
+
+TEST(from_sorted_and_freeze) {
+  std::vector<int> sorted;
+  for (int i = 0; i < 1000; ++i) {
+    sorted.push_back(3 * i);
+  }
+  auto tree = CompactSearchTree<int>::from_sorted(sorted.begin(), sorted.end());
+  ASSERT_EQUAL(tree.size(), 1000);
+  ASSERT_EQUAL(tree.height(), 10);
+  ASSERT_TRUE(tree.check_sorting_invariant());
+  ASSERT_TRUE(std::equal(tree.begin(), tree.end(), sorted.begin()));
+  // a built tree keeps balancing as it changes
+  for (int i = 0; i < 1000; ++i) {
+    tree.insert(3 * i + 1);
+  }
+  ASSERT_TRUE(tree.height() <= 1.45 * std::log2(2000 + 2));
+
+  auto frozen = tree.freeze();
+  ASSERT_EQUAL(frozen.size(), 2000);
+  ASSERT_EQUAL(*frozen.find(301), 301);
+
+  std::vector<int> unsorted = {1, 3, 2};
+  bool threw = false;
+  try {
+    CompactSearchTree<int>::from_sorted(unsorted.begin(), unsorted.end());
+  }
+  catch (const std::invalid_argument &) {
+    threw = true;
+  }
+  ASSERT_TRUE(threw);
+  auto empty = CompactSearchTree<int>::from_sorted(unsorted.begin(),
+                                                   unsorted.begin());
+  ASSERT_TRUE(empty.empty());
+}
+
+TEST(bounds_and_ranges) {
+  CompactSearchTree<int> tree;
+  for (int i = 0; i < 100; ++i) {
+    tree.insert(i * 10);
+  }
+  ASSERT_EQUAL(*tree.lower_bound(50), 50);
+  ASSERT_EQUAL(*tree.lower_bound(51), 60);
+  ASSERT_EQUAL(*tree.upper_bound(50), 60);
+  ASSERT_TRUE(tree.lower_bound(991) == tree.end());
+  auto equal = tree.equal_range(70);
+  ASSERT_EQUAL(*equal.first, 70);
+  ASSERT_EQUAL(*equal.second, 80);
+  equal = tree.equal_range(75);
+  ASSERT_TRUE(equal.first == equal.second);
+
+  std::vector<int> seen;
+  for (int elt : tree.range(195, 240)) {
+    seen.push_back(elt);
+  }
+  ASSERT_TRUE(seen == std::vector<int>({200, 210, 220, 230}));
+  ASSERT_TRUE(tree.range(240, 195).empty());
+}
+
+TEST(erase_keeps_invariants) {
+  CompactSearchTree<int> tree;
+  std::vector<int> expected;
+  const int n = 2000;
+  for (int i = 0; i < n; ++i) {
+    tree.insert((i * 7919) % n);
+    expected.push_back(i);
+  }
+  for (int i = 0; i < n; ++i) {
+    int key = (i * 7) % n;
+    if (key % 3 != 0) {
+      continue;
+    }
+    ASSERT_EQUAL(tree.erase(key), 1);
+    expected.erase(std::find(expected.begin(), expected.end(), key));
+    ASSERT_EQUAL(tree.size(), expected.size());
+  }
+  ASSERT_TRUE(tree.check_sorting_invariant());
+  ASSERT_TRUE(std::equal(tree.begin(), tree.end(), expected.begin()));
+  ASSERT_TRUE(tree.height() <= 1.45 * std::log2(expected.size() + 2));
+  ASSERT_EQUAL(tree.erase(3), 0);
+}
+
+TEST(erase_returns_next_even_when_it_moves) {
+  CompactSearchTree<int> tree;
+  for (int i = 0; i < 10; ++i) {
+    tree.insert(i);
+  }
+  // 9 is the last node in the array, so erasing 8 moves it into the hole
+  auto next = tree.erase(tree.find(8));
+  ASSERT_EQUAL(*next, 9);
+  ASSERT_TRUE(++next == tree.end());
+
+  auto it = tree.begin();
+  while (it != tree.end()) {
+    it = *it % 2 == 0 ? tree.erase(it) : std::next(it);
+  }
+  std::ostringstream out;
+  out << tree;
+  ASSERT_EQUAL(out.str(), "[ 1 3 5 7 9 ]");
+}
+
+TEST(erase_range_and_clear) {
+  CompactSearchTree<int> tree;
+  for (int i = 0; i < 500; ++i) {
+    tree.insert(i);
+  }
+  auto after = tree.erase(tree.find(100), tree.find(400));
+  ASSERT_EQUAL(*after, 400);
+  ASSERT_EQUAL(tree.size(), 200);
+  ASSERT_TRUE(tree.check_sorting_invariant());
+  ASSERT_TRUE(tree.find(250) == tree.end());
+  ASSERT_EQUAL(*tree.find(99), 99);
+
+  tree.clear();
+  ASSERT_TRUE(tree.empty());
+  ASSERT_EQUAL(tree.height(), 0);
+  tree.insert(5);
+  ASSERT_EQUAL(*tree.begin(), 5);
+}
+
+TEST_MAIN()
@@ -0,0 +1,580 @@
+#ifndef CONCURRENT_MAP_HPP
+#define CONCURRENT_MAP_HPP
+/* ConcurrentMap.hpp
+ *
+ * A map of unique keys that many threads can read while one thread at a
+ * time updates it. Readers never take a lock; writers take a mutex.
+ *
+ *   ConcurrentMap<std::string, double> weights;
+ *   // any number of scoring threads:
+ *   std::optional<double> w = weights.get("word");
+ *   {
+ *     auto view = weights.snapshot();   // a consistent version
+ *     for (const auto &entry : view) { ... }
+ *   }
+ *   // an updater thread:
+ *   weights.insert_or_assign("new word", 0.5);
+ *
+ * The tree is AVL-balanced and persistent: a writer never changes a node
+ * that readers may see. It copies the nodes on the path to its change
+ * (path copying, as in PersistentTree.hpp) and then publishes the new
+ * root with a single atomic store. A reader loads the root once and sees
+ * that version of the map, unaffected by later writes, for as long as it
+ * holds it.
+ *
+ * Replaced nodes are freed by epoch-based reclamation. A reader announces
+ * the global epoch in a slot of a fixed table before loading the root,
+ * and clears it when done. Each write retires the nodes it replaced,
+ * tagged with the epoch it ends, and frees the retired nodes whose tag is
+ * older than every announced epoch: no reader can still reach those.
+ *
+ * At most max_readers snapshots can be held at the same time; further
+ * readers wait until one is released. A Snapshot should be short-lived,
+ * since nodes retired while it is held cannot be freed before it ends.
+ */
+
+#include <algorithm>  //min
+#include <atomic>     //atomic
+#include <cassert>    //assert
+#include <cstddef>    //size_t
+#include <cstdint>    //uint64_t
+#include <functional> //less
+#include <iterator>   //forward_iterator_tag
+#include <mutex>      //mutex, lock_guard
+#include <optional>   //optional
+#include <thread>     //this_thread::yield
+#include <utility>    //pair, move
+#include <vector>
+#include "CopyOnWriteAVL.hpp"
+
+template <typename Key_type, typename Value_type,
+          typename Key_compare=std::less<Key_type>
+         >
+class ConcurrentMap {
+
+private:
+  using Pair_type = std::pair<Key_type, Value_type>;
+
+  // Nodes are immutable once published. 'created_by' is the number of
+  // the write that created the node; only that write may change it.
+  struct Node {
+    Node(const Pair_type &entry_in, uint64_t write)
+      : entry(entry_in), left(nullptr), right(nullptr), height(1),
+        created_by(write) { }
+
+    Pair_type entry;
+    Node *left;
+    Node *right;
+    int height;
+    uint64_t created_by;
+  };
+
+  // One reader's announcement: the epoch it pinned, or 0 if unused.
+  // Each slot has a cache line of its own so readers do not contend.
+  struct alignas(64) Reader_slot {
+    std::atomic<uint64_t> epoch{0};
+  };
+
+public:
+
+  // Number of snapshots that can be held at the same time
+  static const int max_readers = 128;
+
+  class Snapshot;
+
+  class Iterator {
+    // OVERVIEW: Iterates over the key-value pairs of a Snapshot in
+    //           ascending key order, keeping the stack of ancestors whose
+    //           left subtree it is in. Valid as long as the Snapshot it
+    //           came from.
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Pair_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Pair_type *;
+    using reference = const Pair_type &;
+
+    Iterator() { }
+
+    const Pair_type &operator*() const {
+      return path.back()->entry;
+    }
+
+    const Pair_type *operator->() const {
+      return &path.back()->entry;
+    }
+
+    // Prefix ++
+    Iterator &operator++() {
+      const Node *node = path.back();
+      path.pop_back();
+      push_left_spine(node->right);
+      return *this;
+    }
+
+    // Postfix ++
+    Iterator operator++(int) {
+      Iterator result(*this);
+      ++(*this);
+      return result;
+    }
+
+    bool operator==(const Iterator &rhs) const {
+      return current() == rhs.current();
+    }
+
+    bool operator!=(const Iterator &rhs) const {
+      return !(*this == rhs);
+    }
+
+  private:
+    friend class ConcurrentMap;
+
+    std::vector<const Node *> path;
+
+    const Node *current() const {
+      return path.empty() ? nullptr : path.back();
+    }
+
+    void push_left_spine(const Node *node) {
+      for (; node != nullptr; node = node->left) {
+        path.push_back(node);
+      }
+    }
+  }; // ConcurrentMap::Iterator
+
+  class Snapshot {
+    // OVERVIEW: A consistent, read-only version of the map, pinned for as
+    //           long as the Snapshot lives. Reading it never locks.
+  public:
+    Snapshot(Snapshot &&other) noexcept
+      : map(other.map), slot(other.slot), root(other.root) {
+      other.slot = nullptr;
+    }
+
+    Snapshot(const Snapshot &) = delete;
+    Snapshot &operator=(const Snapshot &) = delete;
+    Snapshot &operator=(Snapshot &&) = delete;
+
+    // EFFECTS: Unpins the version, allowing its replaced nodes to be
+    //          freed.
+    ~Snapshot() {
+      if (slot != nullptr) {
+        slot->epoch.store(0, std::memory_order_release);
+      }
+    }
+
+    bool empty() const {
+      return root == nullptr;
+    }
+
+    // EFFECTS: Returns an Iterator to the pair with a key equivalent to
+    //          k, or an end Iterator if there is none.
+    Iterator find(const Key_type &k) const {
+      Iterator result;
+      const Node *node = root;
+      while (node != nullptr) {
+        if (map->less(node->entry.first, k)) {
+          node = node->right;
+        }
+        else {
+          result.path.push_back(node);
+          if (!map->less(k, node->entry.first)) {
+            return result;
+          }
+          node = node->left;
+        }
+      }
+      return end();
+    }
+
+    // EFFECTS: Returns a pointer to the value mapped to k, or null if k
+    //          is not in this version. Never allocates.
+    const Value_type *get(const Key_type &k) const {
+      const Node *node = map->find_node(root, k);
+      return node == nullptr ? nullptr : &node->entry.second;
+    }
+
+    Iterator begin() const {
+      Iterator result;
+      result.push_left_spine(root);
+      return result;
+    }
+
+    Iterator end() const {
+      return Iterator();
+    }
+
+  private:
+    friend class ConcurrentMap;
+
+    const ConcurrentMap *map;
+    Reader_slot *slot;
+    const Node *root;
+
+    Snapshot(const ConcurrentMap *map_in,
+             Reader_slot *slot_in,
+             const Node *root_in)
+      : map(map_in), slot(slot_in), root(root_in) { }
+  }; // ConcurrentMap::Snapshot
+
+  ConcurrentMap()
+    : root(nullptr), global_epoch(1), write_count(0), elt_count(0) { }
+
+  ConcurrentMap(const ConcurrentMap &) = delete;
+  ConcurrentMap &operator=(const ConcurrentMap &) = delete;
+
+  // REQUIRES: no Snapshot of this map is still held, and no other thread
+  //           is using it
+  ~ConcurrentMap() {
+    destroy_tree(root.load(std::memory_order_relaxed));
+    for (const Retired &retired : retired_nodes) {
+      delete retired.node;
+    }
+  }
+
+  // EFFECTS: Pins and returns the current version of the map. Waits
+  //          only if max_readers snapshots are already held.
+  Snapshot snapshot() const {
+    Reader_slot *slot = claim_slot();
+    return Snapshot(this, slot, root.load(std::memory_order_seq_cst));
+  }
+
+  // EFFECTS: Returns a copy of the value mapped to k in the current
+  //          version, or nothing if k is not in the map.
+  std::optional<Value_type> get(const Key_type &k) const {
+    Snapshot view = snapshot();
+    const Value_type *value = view.get(k);
+    if (value == nullptr) {
+      return std::nullopt;
+    }
+    return *value;
+  }
+
+  // EFFECTS: Returns whether k is in the current version of the map.
+  bool contains(const Key_type &k) const {
+    return snapshot().get(k) != nullptr;
+  }
+
+  // EFFECTS: Returns the number of elements in the most recently
+  //          published version.
+  size_t size() const {
+    return elt_count.load(std::memory_order_acquire);
+  }
+
+  bool empty() const {
+    return size() == 0;
+  }
+
+  // MODIFIES: this
+  // EFFECTS : Inserts (k, v) if k is not in the map. Returns whether it
+  //           was inserted. Waits for other writers, never for readers.
+  bool insert(const Key_type &k, const Value_type &v) {
+    return write(k, v, false);
+  }
+
+  // MODIFIES: this
+  // EFFECTS : Maps k to v, inserting k if needed. Returns whether k was
+  //           inserted.
+  bool insert_or_assign(const Key_type &k, const Value_type &v) {
+    return write(k, v, true);
+  }
+
+  // MODIFIES: this
+  // EFFECTS : Removes k from the map if it is there. Returns the number
+  //           of elements removed (0 or 1).
+  size_t erase(const Key_type &k) {
+    std::lock_guard<std::mutex> lock(writer_mutex);
+    Node *old_root = root.load(std::memory_order_relaxed);
+    if (find_node(old_root, k) == nullptr) {
+      return 0;
+    }
+    ++write_count;
+    Node *new_root = old_root;
+    try {
+      Node *path[CopyOnWriteAVL::max_depth];
+      int depth = copy_path(new_root, k, path);
+
+      Node *target = path[depth - 1];
+      Node *removed;
+      if (target->left != nullptr && target->right != nullptr) {
+        // move the successor's pair up and remove the successor instead
+        Node **slot = &target->right;
+        while (own(*slot)->left != nullptr) {
+          assert(depth < CopyOnWriteAVL::max_depth);
+          path[depth++] = *slot;
+          slot = &(*slot)->left;
+        }
+        removed = *slot;
+        target->entry = std::move(removed->entry);
+        *slot = removed->right;
+      }
+      else {
+        removed = target;
+        --depth;
+        child_slot(new_root, path, depth) =
+          target->left != nullptr ? target->left : target->right;
+      }
+      // 'removed' was created by this write, so no reader has seen it
+      delete removed;
+      rebalance_path(new_root, path, depth);
+    }
+    catch (...) {
+      abandon_write(new_root);
+      throw;
+    }
+    publish(new_root, elt_count.load(std::memory_order_relaxed) - 1);
+    return 1;
+  }
+
+private:
+
+  struct Retired {
+    Node *node;
+    uint64_t epoch;
+  };
+
+  // DATA REPRESENTATION
+  std::atomic<Node *> root;
+  mutable std::atomic<uint64_t> global_epoch;
+  mutable Reader_slot reader_slots[max_readers];
+  Key_compare less;
+
+  // Only accessed by the writer holding writer_mutex
+  std::mutex writer_mutex;
+  uint64_t write_count;
+  std::vector<Retired> retired_nodes;
+  std::atomic<size_t> elt_count;
+
+  // EFFECTS : Claims a free reader slot and announces the current epoch
+  //           in it.
+  Reader_slot *claim_slot() const {
+    static thread_local unsigned hint = 0;
+    while (true) {
+      for (int i = 0; i < max_readers; ++i) {
+        Reader_slot &slot = reader_slots[(hint + i) % max_readers];
+        uint64_t expected = 0;
+        uint64_t epoch = global_epoch.load(std::memory_order_seq_cst);
+        if (slot.epoch.load(std::memory_order_relaxed) == 0 &&
+            slot.epoch.compare_exchange_strong(expected, epoch,
+                                               std::memory_order_seq_cst)) {
+          hint = (hint + i) % max_readers;
+          return &slot;
+        }
+      }
+      std::this_thread::yield();
+    }
+  }
+
+  // EFFECTS : Returns the node holding k in the tree rooted at node, or
+  //           null if there is none.
+  const Node *find_node(const Node *node, const Key_type &k) const {
+    while (node != nullptr) {
+      if (less(k, node->entry.first)) {
+        node = node->left;
+      }
+      else if (less(node->entry.first, k)) {
+        node = node->right;
+      }
+      else {
+        return node;
+      }
+    }
+    return nullptr;
+  }
+
+  // REQUIRES: writer_mutex is held
+  // EFFECTS : Inserts or assigns as described for insert_or_assign, or
+  //           only inserts if 'assign' is false.
+  bool write(const Key_type &k, const Value_type &v, bool assign) {
+    std::lock_guard<std::mutex> lock(writer_mutex);
+    Node *old_root = root.load(std::memory_order_relaxed);
+    bool present = find_node(old_root, k) != nullptr;
+    if (present && !assign) {
+      return false;
+    }
+    ++write_count;
+    Node *new_root = old_root;
+    size_t new_size = elt_count.load(std::memory_order_relaxed);
+    try {
+      Node *path[CopyOnWriteAVL::max_depth];
+      int depth = copy_path(new_root, k, path);
+
+      if (present) {
+        path[depth - 1]->entry.second = v;
+      }
+      else {
+        Node *leaf = new Node(Pair_type(k, v), write_count);
+        if (depth == 0) {
+          new_root = leaf;
+        }
+        else {
+          Node *parent = path[depth - 1];
+          (less(k, parent->entry.first) ? parent->left : parent->right) = leaf;
+        }
+        ++new_size;
+        rebalance_path(new_root, path, depth);
+      }
+    }
+    catch (...) {
+      abandon_write(new_root);
+      throw;
+    }
+    publish(new_root, new_size);
+    return !present;
+  }
+
+  // REQUIRES: writer_mutex is held
+  // MODIFIES: new_root, path
+  // EFFECTS : Replaces every node on the search path for k, from the root
+  //           down to the node holding k or to the last node before a
+  //           null child, by a copy owned by this write. Stores the
+  //           copies in path and returns their number.
+  int copy_path(Node *&new_root, const Key_type &k, Node **path) {
+    int depth = 0;
+    Node **slot = &new_root;
+    while (*slot != nullptr) {
+      assert(depth < CopyOnWriteAVL::max_depth);
+      Node *node = own(*slot);
+      path[depth++] = node;
+      if (less(k, node->entry.first)) {
+        slot = &node->left;
+      }
+      else if (less(node->entry.first, k)) {
+        slot = &node->right;
+      }
+      else {
+        break;
+      }
+    }
+    return depth;
+  }
+
+  // REQUIRES: writer_mutex is held; slot is the root pointer being built
+  //           or a child pointer of a node owned by this write
+  // MODIFIES: slot
+  // EFFECTS : If the node in slot was created by an earlier write, and so
+  //           may be visible to readers, replaces it by a copy created by
+  //           this write and retires it. Returns the node now in slot.
+  Node *own(Node *&slot) {
+    Node *node = slot;
+    if (node->created_by == write_count) {
+      return node;
+    }
+    retired_nodes.push_back(Retired{node, 0});
+    Node *copy = new Node(node->entry, write_count);
+    copy->left = node->left;
+    copy->right = node->right;
+    copy->height = node->height;
+    slot = copy;
+    return copy;
+  }
+
+  // EFFECTS : Returns the pointer that links path[i] into the tree being
+  //           built: new_root or a child pointer of path[i - 1].
+  static Node *&child_slot(Node *&new_root, Node **path, int i) {
+    if (i == 0) {
+      return new_root;
+    }
+    Node *parent = path[i - 1];
+    return parent->left == path[i] ? parent->left : parent->right;
+  }
+
+  // REQUIRES: path[0..depth) is a root-to-node path of nodes owned by
+  //           this write, and all subtrees below it are balanced
+  // EFFECTS : Restores the AVL invariant from path[depth - 1] up to the
+  //           root of the tree being built.
+  void rebalance_path(Node *&new_root, Node **path, int depth) {
+    for (int i = depth - 1; i >= 0; --i) {
+      Node *&slot = child_slot(new_root, path, i);
+      int old_height = slot->height;
+      slot = CopyOnWriteAVL::rebalance(slot, [this](Node *&child) {
+        return own(child);
+      });
+      if (slot->height == old_height) {
+        return;
+      }
+    }
+  }
+
+  // REQUIRES: writer_mutex is held
+  // EFFECTS : Makes new_root the current version, then ends the epoch:
+  //           the nodes retired by this write are tagged with it, and
+  //           every retired node that no reader can still reach is
+  //           freed.
+  void publish(Node *new_root, size_t new_size) {
+    root.store(new_root, std::memory_order_seq_cst);
+    elt_count.store(new_size, std::memory_order_release);
+    uint64_t ended = global_epoch.fetch_add(1, std::memory_order_seq_cst);
+    for (auto it = retired_nodes.rbegin();
+         it != retired_nodes.rend() && it->epoch == 0; ++it) {
+      it->epoch = ended;
+    }
+
+    // A reader that announced epoch e may hold nodes retired in any
+    // epoch >= e, so free only those retired before every announcement.
+    uint64_t oldest = UINT64_MAX;
+    for (const Reader_slot &slot : reader_slots) {
+      uint64_t epoch = slot.epoch.load(std::memory_order_seq_cst);
+      if (epoch != 0) {
+        oldest = std::min(oldest, epoch);
+      }
+    }
+    size_t kept = 0;
+    for (const Retired &retired : retired_nodes) {
+      if (retired.epoch < oldest) {
+        delete retired.node;
+      }
+      else {
+        retired_nodes[kept++] = retired;
+      }
+    }
+    retired_nodes.resize(kept);
+  }
+
+  // REQUIRES: writer_mutex is held and the current write has not been
+  //           published
+  // EFFECTS : Undoes the current write: frees the nodes it created, all
+  //           of which are reachable from new_root through nodes it
+  //           created, and un-retires the nodes they replaced.
+  void abandon_write(Node *new_root) {
+    std::vector<Node *> pending;
+    if (new_root != nullptr && new_root->created_by == write_count) {
+      pending.push_back(new_root);
+    }
+    while (!pending.empty()) {
+      Node *next = pending.back();
+      pending.pop_back();
+      for (Node *child : {next->left, next->right}) {
+        if (child != nullptr && child->created_by == write_count) {
+          pending.push_back(child);
+        }
+      }
+      delete next;
+    }
+    while (!retired_nodes.empty() && retired_nodes.back().epoch == 0) {
+      retired_nodes.pop_back();
+    }
+  }
+
+  // EFFECTS : Frees every node of the tree rooted at node.
+  static void destroy_tree(Node *node) {
+    std::vector<Node *> pending;
+    if (node != nullptr) {
+      pending.push_back(node);
+    }
+    while (!pending.empty()) {
+      Node *next = pending.back();
+      pending.pop_back();
+      if (next->left != nullptr) {
+        pending.push_back(next->left);
+      }
+      if (next->right != nullptr) {
+        pending.push_back(next->right);
+      }
+      delete next;
+    }
+  }
+};
+
+#endif // CONCURRENT_MAP_HPP
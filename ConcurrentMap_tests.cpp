@@ -0,0 +1,215 @@
+#include "ConcurrentMap.hpp"
+#include "unit_test_framework.hpp"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A value that counts how many instances are alive
+struct Counted {
+  static std::atomic<int> alive;
+  int value;
+
+  Counted(int value_in) : value(value_in) {
+    ++alive;
+  }
+
+  Counted(const Counted &other) : value(other.value) {
+    ++alive;
+  }
+
+  Counted &operator=(const Counted &) = default;
+
+  ~Counted() {
+    --alive;
+  }
+};
+
+std::atomic<int> Counted::alive(0);
+
+TEST(empty_map) {
+  ConcurrentMap<int, int> map;
+  ASSERT_TRUE(map.empty());
+  ASSERT_EQUAL(map.size(), 0);
+  ASSERT_FALSE(map.contains(1));
+  ASSERT_FALSE(map.get(1).has_value());
+  ASSERT_EQUAL(map.erase(1), 0);
+  auto view = map.snapshot();
+  ASSERT_TRUE(view.empty());
+  ASSERT_TRUE(view.begin() == view.end());
+  ASSERT_TRUE(view.find(1) == view.end());
+}
+
+TEST(insert_get_and_erase) {
+  ConcurrentMap<std::string, int> map;
+  ASSERT_TRUE(map.insert("b", 2));
+  ASSERT_TRUE(map.insert("a", 1));
+  ASSERT_TRUE(map.insert("c", 3));
+  ASSERT_FALSE(map.insert("a", 10));
+  ASSERT_EQUAL(map.size(), 3);
+  ASSERT_EQUAL(*map.get("a"), 1);
+
+  ASSERT_FALSE(map.insert_or_assign("a", 10));
+  ASSERT_TRUE(map.insert_or_assign("d", 4));
+  ASSERT_EQUAL(*map.get("a"), 10);
+  ASSERT_EQUAL(map.size(), 4);
+
+  ASSERT_EQUAL(map.erase("b"), 1);
+  ASSERT_EQUAL(map.erase("b"), 0);
+  ASSERT_FALSE(map.contains("b"));
+  ASSERT_EQUAL(map.size(), 3);
+
+  auto view = map.snapshot();
+  std::string keys;
+  for (const auto &entry : view) {
+    keys += entry.first;
+  }
+  ASSERT_EQUAL(keys, "acd");
+  ASSERT_EQUAL(view.find("c")->second, 3);
+  ASSERT_EQUAL((++view.find("a"))->first, "c");
+}
+
+TEST(many_writes_keep_order) {
+  ConcurrentMap<int, int> map;
+  const int n = 5000;
+  for (int i = 0; i < n; ++i) {
+    map.insert((i * 7919) % n, i);
+  }
+  for (int i = 0; i < n; i += 3) {
+    ASSERT_EQUAL(map.erase(i), 1);
+  }
+  auto view = map.snapshot();
+  int expected = 0;
+  int count = 0;
+  for (const auto &entry : view) {
+    if (expected % 3 == 0) {
+      ++expected;
+    }
+    ASSERT_EQUAL(entry.first, expected);
+    ++expected;
+    ++count;
+  }
+  ASSERT_EQUAL(count, map.size());
+  ASSERT_EQUAL(count, n - (n + 2) / 3);
+}
+
+TEST(snapshot_is_unaffected_by_later_writes) {
+  ConcurrentMap<int, int> map;
+  for (int i = 0; i < 100; ++i) {
+    map.insert(i, i);
+  }
+  auto view = map.snapshot();
+  for (int i = 0; i < 100; ++i) {
+    map.erase(i);
+    map.insert(i + 1000, i);
+  }
+  map.insert_or_assign(1050, -1);
+
+  int count = 0;
+  for (const auto &entry : view) {
+    ASSERT_EQUAL(entry.first, count);
+    ASSERT_EQUAL(entry.second, count);
+    ++count;
+  }
+  ASSERT_EQUAL(count, 100);
+  ASSERT_TRUE(view.find(1050) == view.end());
+  ASSERT_EQUAL(*map.get(1050), -1);
+  ASSERT_FALSE(map.contains(50));
+}
+
+TEST(replaced_nodes_are_freed_after_readers_leave) {
+  Counted::alive = 0;
+  {
+    ConcurrentMap<int, Counted> map;
+    for (int i = 0; i < 1000; ++i) {
+      map.insert(i, Counted(i));
+    }
+    // With no reader pinned, each write frees what it replaced
+    ASSERT_EQUAL(Counted::alive, 1000);
+    {
+      auto view = map.snapshot();
+      for (int i = 0; i < 1000; i += 2) {
+        map.erase(i);
+      }
+      // The pinned version keeps the replaced nodes alive
+      ASSERT_TRUE(Counted::alive > 1000);
+      int sum = 0;
+      for (const auto &entry : view) {
+        sum += entry.second.value;
+      }
+      ASSERT_EQUAL(sum, 999 * 1000 / 2);
+    }
+    map.insert_or_assign(1, Counted(-1));
+    ASSERT_EQUAL(Counted::alive, 500);
+  }
+  ASSERT_EQUAL(Counted::alive, 0);
+}
+
+// Readers check that every version they see is consistent while a
+// writer inserts, overwrites and erases keys.
+TEST(readers_run_concurrently_with_a_writer) {
+  ConcurrentMap<int, int> map;
+  const int n = 4000;
+  for (int i = 0; i < n; i += 2) {
+    map.insert(i, i * 3);
+  }
+  std::atomic<bool> done(false);
+  std::atomic<int> errors(0);
+  std::vector<std::thread> readers;
+  for (int r = 0; r < 4; ++r) {
+    readers.emplace_back([&map, &done, &errors, r] {
+      int key = r;
+      do {
+        // Even keys are always present and map to key * 3 or -key
+        key = (key + 7) % n;
+        std::optional<int> value = map.get(key - key % 2);
+        if (!value || (*value != (key - key % 2) * 3 &&
+                       *value != -(key - key % 2))) {
+          ++errors;
+        }
+
+        // Odd keys come and go, but map to key * 3 when present
+        std::optional<int> odd = map.get(key | 1);
+        if (odd && *odd != (key | 1) * 3) {
+          ++errors;
+        }
+
+        if (key % 50 == 0) {
+          auto view = map.snapshot();
+          int previous = -1;
+          int evens = 0;
+          for (const auto &entry : view) {
+            if (entry.first <= previous) {
+              ++errors;
+            }
+            evens += entry.first % 2 == 0;
+            previous = entry.first;
+          }
+          if (evens != n / 2) {
+            ++errors;
+          }
+        }
+      } while (!done.load());
+    });
+  }
+
+  for (int round = 0; round < 20; ++round) {
+    for (int i = 1; i < n; i += 2) {
+      map.insert(i, i * 3);
+    }
+    for (int i = 0; i < n; i += 10) {
+      map.insert_or_assign(i, round % 2 == 0 ? -i : i * 3);
+    }
+    for (int i = 1; i < n; i += 2) {
+      map.erase(i);
+    }
+  }
+  done = true;
+  for (std::thread &reader : readers) {
+    reader.join();
+  }
+  ASSERT_EQUAL(errors.load(), 0);
+  ASSERT_EQUAL(map.size(), n / 2);
+}
+
+TEST_MAIN()
@@ -0,0 +1,100 @@
+#ifndef COPY_ON_WRITE_AVL_HPP
+#define COPY_ON_WRITE_AVL_HPP
+/* CopyOnWriteAVL.hpp
+ *
+ * AVL balancing shared by PersistentTree and ConcurrentMap. Their nodes
+ * have 'left', 'right' and 'height' members but no parent pointers, and
+ * a node may only be changed once it is private to the update in
+ * progress: PersistentTree copies nodes shared with other versions, and
+ * ConcurrentMap copies nodes that readers may still see. Each container
+ * passes that step to rebalance() as a function
+ *
+ *   Node *own(Node *&slot);
+ *
+ * which replaces the node in 'slot' by a private copy if it is not
+ * private already, and returns the node now in 'slot'.
+ */
+
+#include <algorithm> //max
+
+struct CopyOnWriteAVL {
+
+  // An AVL tree of 2^64 nodes is less than 93 levels deep, so a search
+  // path always fits in an array of this size.
+  static const int max_depth = 96;
+
+  // EFFECTS: Returns the cached height of the subtree rooted at 'node',
+  //          or 0 if 'node' is null.
+  template <typename Node>
+  static int height_of(const Node *node) {
+    return node == nullptr ? 0 : node->height;
+  }
+
+  // MODIFIES: node
+  // EFFECTS:  Recomputes the cached height of 'node' from its children.
+  template <typename Node>
+  static void update_height(Node *node) {
+    node->height = 1 + std::max(height_of(node->left),
+                                height_of(node->right));
+  }
+
+  // EFFECTS: Returns height(left) - height(right) for 'node'.
+  template <typename Node>
+  static int balance_factor(const Node *node) {
+    return height_of(node->left) - height_of(node->right);
+  }
+
+  // REQUIRES: node is private to the update in progress
+  // MODIFIES: node and the nodes a rotation changes
+  // EFFECTS:  Same as AVLBalance::rebalance, except that every node a
+  //           rotation changes is made private with own() first.
+  template <typename Node, typename Own>
+  static Node *rebalance(Node *node, Own own) {
+    update_height(node);
+    int balance = balance_factor(node);
+    if (balance > 1) {
+      Node *left = own(node->left);
+      if (balance_factor(left) < 0) {
+        own(left->right);
+        node->left = rotate_left(left);
+      }
+      return rotate_right(node);
+    }
+    if (balance < -1) {
+      Node *right = own(node->right);
+      if (balance_factor(right) > 0) {
+        own(right->left);
+        node->right = rotate_right(right);
+      }
+      return rotate_left(node);
+    }
+    return node;
+  }
+
+  // REQUIRES: node and node->right are private to the update in progress
+  // EFFECTS:  Rotates the subtree rooted at 'node' to the left and returns
+  //           its new root.
+  template <typename Node>
+  static Node *rotate_left(Node *node) {
+    Node *pivot = node->right;
+    node->right = pivot->left;
+    pivot->left = node;
+    update_height(node);
+    update_height(pivot);
+    return pivot;
+  }
+
+  // REQUIRES: node and node->left are private to the update in progress
+  // EFFECTS:  Mirror image of rotate_left.
+  template <typename Node>
+  static Node *rotate_right(Node *node) {
+    Node *pivot = node->left;
+    node->left = pivot->right;
+    pivot->right = node;
+    update_height(node);
+    update_height(pivot);
+    return pivot;
+  }
+};
+
+#endif // COPY_ON_WRITE_AVL_HPP
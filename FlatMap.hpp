@@ -0,0 +1,419 @@
+#ifndef FLAT_MAP_HPP
+#define FLAT_MAP_HPP
+/* FlatMap.hpp
+ *
+ * A map of unique keys with the interface of Map.hpp, for maps that are
+ * built once and then read many times, like label tables and
+ * vocabularies. The keys live in one sorted array and the mapped values
+ * in a second array in the same order, so a lookup binary searches a
+ * contiguous run of keys and never touches a value until it has found
+ * its key, and there is no per-element node or pointer overhead.
+ *
+ *   FlatMap<std::string, int> vocabulary;
+ *   for (...) {
+ *     vocabulary.stage(word, id);   // O(1), not yet visible
+ *   }
+ *   vocabulary.build();             // one sort, then one merge pass
+ *   auto it = vocabulary.find("word");
+ *
+ * Inserting or erasing a single element shifts every element after it,
+ * which costs O(n); bulk loads should go through stage() and build().
+ * Inserting and erasing invalidate iterators, like std::vector.
+ *
+ * Since keys and values are stored apart, iterators yield a
+ * std::pair<const Key_type &, Value_type &> by value rather than a
+ * reference to a stored pair. it->first and it->second work as they do
+ * for Map, and entries can be bound with "const auto &entry" or
+ * "auto entry" in a range-based for loop.
+ */
+
+#include "IteratorRange.hpp"
+#include <algorithm>  //lower_bound, upper_bound, stable_sort
+#include <cstddef>    //size_t, ptrdiff_t
+#include <functional> //less
+#include <iterator>   //input_iterator_tag
+#include <memory>     //allocator
+#include <utility>    //pair, move
+#include <vector>
+
+template <typename Key_type, typename Value_type,
+          typename Key_compare=std::less<Key_type>, // default argument
+          template <typename> class Allocator=std::allocator
+         >
+class FlatMap {
+
+private:
+  using Pair_type = std::pair<Key_type, Value_type>;
+  using Key_array = std::vector<Key_type, Allocator<Key_type>>;
+  using Value_array = std::vector<Value_type, Allocator<Value_type>>;
+
+public:
+
+  // What an Iterator yields: references to a key and its mapped value
+  using Reference = std::pair<const Key_type &, Value_type &>;
+
+  class Iterator {
+    // OVERVIEW: Iterates over the entries of a FlatMap in ascending key
+    //           order by stepping through both arrays together.
+    //
+    // Dereferencing yields a Reference, a pair of references built on the
+    // fly, rather than a value_type &. The forward and bidirectional
+    // iterator requirements forbid that, so the Iterator is declared an
+    // input iterator, even though it can be copied, compared and stepped
+    // backwards with -- as well.
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = Pair_type;
+    using difference_type = std::ptrdiff_t;
+    using reference = Reference;
+
+    // Makes it->first and it->second work on the Reference yielded by
+    // value.
+    class Arrow_proxy {
+    public:
+      const Reference *operator->() const {
+        return &entry;
+      }
+
+    private:
+      friend class Iterator;
+
+      explicit Arrow_proxy(const Reference &entry_in)
+        : entry(entry_in) { }
+
+      Reference entry;
+    };
+
+    using pointer = Arrow_proxy;
+
+    Iterator()
+      : key(nullptr), value(nullptr) { }
+
+    Reference operator*() const {
+      return Reference(*key, *value);
+    }
+
+    Arrow_proxy operator->() const {
+      return Arrow_proxy(**this);
+    }
+
+    // Prefix ++
+    Iterator &operator++() {
+      ++key;
+      ++value;
+      return *this;
+    }
+
+    // Postfix ++
+    Iterator operator++(int) {
+      Iterator result(*this);
+      ++(*this);
+      return result;
+    }
+
+    // Prefix --
+    Iterator &operator--() {
+      --key;
+      --value;
+      return *this;
+    }
+
+    // Postfix --
+    Iterator operator--(int) {
+      Iterator result(*this);
+      --(*this);
+      return result;
+    }
+
+    bool operator==(const Iterator &rhs) const {
+      return key == rhs.key;
+    }
+
+    bool operator!=(const Iterator &rhs) const {
+      return key != rhs.key;
+    }
+
+  private:
+    friend class FlatMap;
+
+    Iterator(const Key_type *key_in, Value_type *value_in)
+      : key(key_in), value(value_in) { }
+
+    const Key_type *key;
+    Value_type *value;
+  };
+
+  // The implicitly defined constructors, assignment operators and
+  // destructor copy or move the arrays, and the staging buffer with them.
+
+  // EFFECTS : Returns whether this map is empty. Staged entries are not
+  //           counted until build().
+  bool empty() const {
+    return keys.empty();
+  }
+
+  // EFFECTS : Returns the number of elements in this map, not counting
+  //           staged entries.
+  size_t size() const {
+    return keys.size();
+  }
+
+  // EFFECTS : Searches this map for an element with key k by binary
+  //           search over the key array. Returns an iterator to it, or
+  //           end() if there is none.
+  Iterator find(const Key_type &k) const {
+    size_t pos = lower_bound_index(k);
+    if (pos == keys.size() || Key_compare()(k, keys[pos])) {
+      return end();
+    }
+    return iterator_at(pos);
+  }
+
+  // EFFECTS : Returns the number of elements with key k (0 or 1).
+  size_t count(const Key_type &k) const {
+    return contains(k);
+  }
+
+  // EFFECTS : Returns whether this map contains an element with key k.
+  bool contains(const Key_type &k) const {
+    return find(k) != end();
+  }
+
+  // EFFECTS : Returns an iterator to the first element whose key is not
+  //           less than k, or end() if there is none.
+  Iterator lower_bound(const Key_type &k) const {
+    return iterator_at(lower_bound_index(k));
+  }
+
+  // EFFECTS : Returns an iterator to the first element whose key is
+  //           greater than k, or end() if there is none.
+  Iterator upper_bound(const Key_type &k) const {
+    return iterator_at(std::upper_bound(keys.begin(), keys.end(), k,
+                                        Key_compare()) - keys.begin());
+  }
+
+  // EFFECTS : Returns the pair (lower_bound(k), upper_bound(k)).
+  std::pair<Iterator, Iterator> equal_range(const Key_type &k) const {
+    Iterator first = lower_bound(k);
+    Iterator last = first;
+    if (last != end() && !Key_compare()(k, last->first)) {
+      ++last;
+    }
+    return std::make_pair(first, last);
+  }
+
+  // EFFECTS : Returns a view of the elements whose keys are not less than
+  //           lo and less than hi, in key order.
+  IteratorRange<Iterator> range(const Key_type &lo,
+                                const Key_type &hi) const {
+    Iterator first = lower_bound(lo);
+    if (!Key_compare()(lo, hi)) {
+      return IteratorRange<Iterator>(first, first);
+    }
+    return IteratorRange<Iterator>(first, lower_bound(hi));
+  }
+
+  // MODIFIES: this
+  // EFFECTS : Returns a reference to the mapped value for key k,
+  //           inserting an element with a value-initialized mapped value
+  //           first if k is not in the map.
+  Value_type &operator[](const Key_type &k) {
+    return (*try_emplace(k).first).second;
+  }
+
+  // MODIFIES: this
+  // EFFECTS : Inserts val if its key is not already in the map, shifting
+  //           the elements after it along. Returns an iterator to the
+  //           element with that key, along with whether val was inserted.
+  std::pair<Iterator, bool> insert(const Pair_type &val) {
+    return try_emplace(val.first, val.second);
+  }
+
+  // MODIFIES: this
+  // EFFECTS : Same as above, but moves val into the map if it is
+  //           inserted.
+  std::pair<Iterator, bool> insert(Pair_type &&val) {
+    return try_emplace(std::move(val.first), std::move(val.second));
+  }
+
+  // MODIFIES: this
+  // EFFECTS : If k is already in the map, returns an iterator to the
+  //           existing element along with false and does not touch args.
+  //           Otherwise inserts an element with key k and a mapped value
+  //           constructed from args, and returns an iterator to it along
+  //           with true.
+  template <typename... Args>
+  std::pair<Iterator, bool> try_emplace(const Key_type &k, Args&&... args) {
+    return emplace_unique(k, std::forward<Args>(args)...);
+  }
+
+  // MODIFIES: this
+  // EFFECTS : Same as above, but moves k into the map if it is inserted.
+  template <typename... Args>
+  std::pair<Iterator, bool> try_emplace(Key_type &&k, Args&&... args) {
+    return emplace_unique(std::move(k), std::forward<Args>(args)...);
+  }
+
+  // MODIFIES: this
+  // EFFECTS : Assigns std::forward<M>(obj) to the mapped value for key k
+  //           if k is in the map, and otherwise inserts it with that
+  //           mapped value. Returns an iterator to the element along with
+  //           whether it was inserted.
+  template <typename M>
+  std::pair<Iterator, bool> insert_or_assign(const Key_type &k, M &&obj) {
+    std::pair<Iterator, bool> result = try_emplace(k, std::forward<M>(obj));
+    if (!result.second) {
+      (*result.first).second = std::forward<M>(obj);
+    }
+    return result;
+  }
+
+  // MODIFIES: this
+  // EFFECTS : Appends an entry constructed from args, as if by
+  //           Pair_type(args...), to the staging buffer in O(1)
+  //           amortized time. Staged entries are not visible to lookups
+  //           or iteration until build().
+  template <typename... Args>
+  void stage(Args&&... args) {
+    staged.emplace_back(std::forward<Args>(args)...);
+  }
+
+  // EFFECTS : Returns the number of entries staged since the last
+  //           build().
+  size_t staged_size() const {
+    return staged.size();
+  }
+
+  // MODIFIES: this
+  // EFFECTS : Adds the staged entries to the map and empties the staging
+  //           buffer. The buffer is sorted once, then merged with the
+  //           existing elements in a single pass that also drops
+  //           duplicates: an existing element keeps its value, and of
+  //           several staged entries with the same key the first one
+  //           staged wins, as if each had been insert()ed in turn.
+  //           Costs O(m log m + n) for m staged and n existing entries.
+  void build() {
+    Key_compare less;
+    std::stable_sort(staged.begin(), staged.end(),
+                     [less](const Pair_type &lhs, const Pair_type &rhs) {
+                       return less(lhs.first, rhs.first);
+                     });
+    Key_array new_keys;
+    Value_array new_values;
+    new_keys.reserve(keys.size() + staged.size());
+    new_values.reserve(keys.size() + staged.size());
+    size_t i = 0;
+    for (Pair_type &entry : staged) {
+      for (; i < keys.size() && less(keys[i], entry.first); ++i) {
+        new_keys.push_back(std::move(keys[i]));
+        new_values.push_back(std::move(values[i]));
+      }
+      bool existing = i < keys.size() && !less(entry.first, keys[i]);
+      bool repeated = !new_keys.empty() && !less(new_keys.back(), entry.first);
+      if (!existing && !repeated) {
+        new_keys.push_back(std::move(entry.first));
+        new_values.push_back(std::move(entry.second));
+      }
+    }
+    for (; i < keys.size(); ++i) {
+      new_keys.push_back(std::move(keys[i]));
+      new_values.push_back(std::move(values[i]));
+    }
+    new_keys.shrink_to_fit();
+    new_values.shrink_to_fit();
+    keys.swap(new_keys);
+    values.swap(new_values);
+    staged.clear();
+    staged.shrink_to_fit();
+  }
+
+  // MODIFIES: this
+  // EFFECTS : Reserves room for n elements in the key and value arrays.
+  void reserve(size_t n) {
+    keys.reserve(n);
+    values.reserve(n);
+  }
+
+  // REQUIRES: pos points to an element of this map
+  // MODIFIES: this
+  // EFFECTS : Removes the element at pos, shifting the elements after it
+  //           back, and returns an iterator to the element that followed
+  //           it.
+  Iterator erase(Iterator pos) {
+    size_t index = pos.key - keys.data();
+    keys.erase(keys.begin() + index);
+    values.erase(values.begin() + index);
+    return iterator_at(index);
+  }
+
+  // MODIFIES: this
+  // EFFECTS : Removes the element with key k, if there is one, and
+  //           returns the number of elements removed (0 or 1).
+  size_t erase(const Key_type &k) {
+    Iterator it = find(k);
+    if (it == end()) {
+      return 0;
+    }
+    erase(it);
+    return 1;
+  }
+
+  // MODIFIES: this
+  // EFFECTS : Removes all elements and staged entries.
+  void clear() {
+    keys.clear();
+    values.clear();
+    staged.clear();
+  }
+
+  // EFFECTS : Returns an iterator to the element with the smallest key.
+  Iterator begin() const {
+    return iterator_at(0);
+  }
+
+  // EFFECTS : Returns an iterator to "past-the-end".
+  Iterator end() const {
+    return iterator_at(keys.size());
+  }
+
+private:
+  // The elements in ascending key order: keys[i] maps to values[i]
+  Key_array keys;
+  Value_array values;
+  // Entries waiting for build(), in the order they were staged
+  std::vector<Pair_type, Allocator<Pair_type>> staged;
+
+  size_t lower_bound_index(const Key_type &k) const {
+    return std::lower_bound(keys.begin(), keys.end(), k, Key_compare()) -
+           keys.begin();
+  }
+
+  // Like Map's, the Iterator of a const FlatMap can modify mapped values
+  Iterator iterator_at(size_t pos) const {
+    return Iterator(keys.data() + pos,
+                    const_cast<Value_type *>(values.data()) + pos);
+  }
+
+  // MODIFIES: this
+  // EFFECTS : Implements try_emplace() for k copied or moved.
+  template <typename K, typename... Args>
+  std::pair<Iterator, bool> emplace_unique(K &&k, Args&&... args) {
+    size_t pos = lower_bound_index(k);
+    if (pos < keys.size() && !Key_compare()(k, keys[pos])) {
+      return std::make_pair(iterator_at(pos), false);
+    }
+    // the value goes in first so that a throwing constructor leaves the
+    // key array untouched
+    values.emplace(values.begin() + pos, std::forward<Args>(args)...);
+    try {
+      keys.emplace(keys.begin() + pos, std::forward<K>(k));
+    }
+    catch (...) {
+      values.erase(values.begin() + pos);
+      throw;
+    }
+    return std::make_pair(iterator_at(pos), true);
+  }
+};
+
+#endif // FLAT_MAP_HPP
@@ -0,0 +1,238 @@
+#include "FlatMap.hpp"
+#include "unit_test_framework.hpp"
+#include <iterator>
+#include <map>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// EFFECTS: Returns whether map holds exactly the elements of expected,
+//          in the same order.
+bool same_elements(const FlatMap<int, int> &map,
+                   const std::map<int, int> &expected) {
+  if (map.size() != expected.size()) {
+    return false;
+  }
+  auto it = expected.begin();
+  for (const auto &entry : map) {
+    if (entry.first != it->first || entry.second != it->second) {
+      return false;
+    }
+    ++it;
+  }
+  return true;
+}
+
+TEST(empty_map) {
+  FlatMap<int, int> map;
+  ASSERT_TRUE(map.empty());
+  ASSERT_EQUAL(map.size(), 0);
+  ASSERT_TRUE(map.begin() == map.end());
+  ASSERT_TRUE(map.find(3) == map.end());
+  ASSERT_FALSE(map.contains(3));
+  ASSERT_EQUAL(map.erase(3), 0);
+  ASSERT_TRUE(map.range(1, 5).empty());
+  map.build();
+  ASSERT_TRUE(map.empty());
+}
+
+TEST(insert_and_operator_keep_keys_sorted) {
+  FlatMap<std::string, int> map;
+  ASSERT_TRUE(map.insert({"m", 1}).second);
+  ASSERT_TRUE(map.insert({"c", 2}).second);
+  ASSERT_FALSE(map.insert({"m", 3}).second);
+  map["x"] = 4;
+  ++map["c"];
+  auto result = map.try_emplace("a", 5);
+  ASSERT_TRUE(result.second);
+  ASSERT_EQUAL(result.first->first, "a");
+  ASSERT_FALSE(map.try_emplace("a", 6).second);
+  ASSERT_FALSE(map.insert_or_assign("x", 7).second);
+  ASSERT_TRUE(map.insert_or_assign("z", 8).second);
+
+  std::string keys;
+  int sum = 0;
+  for (const auto &entry : map) {
+    keys += entry.first;
+    sum += entry.second;
+  }
+  ASSERT_EQUAL(keys, "acmxz");
+  ASSERT_EQUAL(sum, 5 + 3 + 1 + 7 + 8);
+  ASSERT_EQUAL(map.find("m")->second, 1);
+  ASSERT_TRUE(map.find("b") == map.end());
+}
+
+TEST(iterators_modify_values_and_walk_both_ways) {
+  FlatMap<int, int> map;
+  for (int i = 0; i < 10; ++i) {
+    map[i] = i;
+  }
+  for (auto it = map.begin(); it != map.end(); ++it) {
+    it->second *= 10;
+  }
+  (*map.find(3)).second = -1;
+  auto it = map.end();
+  --it;
+  ASSERT_EQUAL(it->first, 9);
+  ASSERT_EQUAL(it->second, 90);
+  ASSERT_EQUAL((it--)->first, 9);
+  ASSERT_EQUAL(it->first, 8);
+  ASSERT_EQUAL(map[3], -1);
+  ASSERT_EQUAL(map[5], 50);
+
+  // a proxy reference only meets the input iterator requirements
+  using Traits = std::iterator_traits<FlatMap<int, int>::Iterator>;
+  ASSERT_TRUE((std::is_same<Traits::iterator_category,
+                            std::input_iterator_tag>::value));
+}
+
+TEST(build_sorts_and_drops_duplicates) {
+  FlatMap<std::string, int> map;
+  map.stage("pear", 1);
+  map.stage("apple", 2);
+  map.stage(std::make_pair(std::string("fig"), 3));
+  map.stage("apple", 4);
+  map.stage("kiwi", 5);
+  map.stage("pear", 6);
+  // staged entries are not visible yet
+  ASSERT_EQUAL(map.staged_size(), 6);
+  ASSERT_TRUE(map.empty());
+  ASSERT_FALSE(map.contains("fig"));
+
+  map.build();
+  ASSERT_EQUAL(map.staged_size(), 0);
+  ASSERT_EQUAL(map.size(), 4);
+  // the first staged entry for a key wins
+  ASSERT_EQUAL(map["apple"], 2);
+  ASSERT_EQUAL(map["pear"], 1);
+  std::string keys;
+  for (const auto &entry : map) {
+    keys += entry.first + " ";
+  }
+  ASSERT_EQUAL(keys, "apple fig kiwi pear ");
+}
+
+TEST(build_merges_with_existing_elements) {
+  FlatMap<int, int> map;
+  std::map<int, int> expected;
+  for (int i = 0; i < 100; i += 2) {
+    map[i] = i;
+    expected[i] = i;
+  }
+  // existing keys keep their values, new ones interleave
+  for (int i = 150; i >= 0; --i) {
+    map.stage(i, -i);
+    expected.insert({i, -i});
+  }
+  map.build();
+  ASSERT_TRUE(same_elements(map, expected));
+
+  // a second build adds to what is there
+  map.stage(1000, 1);
+  map.stage(-5, 2);
+  map.build();
+  expected[1000] = 1;
+  expected[-5] = 2;
+  ASSERT_TRUE(same_elements(map, expected));
+}
+
+TEST(bounds_and_ranges) {
+  FlatMap<int, int> map;
+  for (int i = 0; i < 100; ++i) {
+    map.stage(i * 10, i);
+  }
+  map.build();
+  ASSERT_EQUAL(map.lower_bound(50)->first, 50);
+  ASSERT_EQUAL(map.lower_bound(51)->first, 60);
+  ASSERT_EQUAL(map.upper_bound(50)->first, 60);
+  ASSERT_TRUE(map.lower_bound(991) == map.end());
+  auto equal = map.equal_range(70);
+  ASSERT_EQUAL(equal.first->first, 70);
+  ASSERT_EQUAL(equal.second->first, 80);
+  equal = map.equal_range(75);
+  ASSERT_TRUE(equal.first == equal.second);
+
+  std::vector<int> seen;
+  for (const auto &entry : map.range(195, 240)) {
+    seen.push_back(entry.first);
+  }
+  ASSERT_TRUE(seen == std::vector<int>({200, 210, 220, 230}));
+  ASSERT_TRUE(map.range(240, 195).empty());
+}
+
+TEST(erase_and_clear) {
+  FlatMap<int, int> map;
+  for (int i = 0; i < 10; ++i) {
+    map[i] = i;
+  }
+  auto next = map.erase(map.find(4));
+  ASSERT_EQUAL(next->first, 5);
+  ASSERT_EQUAL(map.erase(7), 1);
+  ASSERT_EQUAL(map.erase(7), 0);
+  ASSERT_EQUAL(map.size(), 8);
+  ASSERT_FALSE(map.contains(4));
+
+  map.stage(20, 20);
+  map.clear();
+  ASSERT_TRUE(map.empty());
+  ASSERT_EQUAL(map.staged_size(), 0);
+}
+
+TEST(random_operations_match_std_map) {
+  FlatMap<int, int> map;
+  std::map<int, int> expected;
+  // staged entries reach expected when map is built
+  std::vector<std::pair<int, int>> staged;
+  auto build = [&] {
+    map.build();
+    for (const auto &entry : staged) {
+      expected.insert(entry);
+    }
+    staged.clear();
+  };
+  std::mt19937 rng(280);
+  for (int step = 0; step < 20000; ++step) {
+    int key = static_cast<int>(rng() % 500);
+    switch (rng() % 4) {
+    case 0:
+      map[key] += step;
+      expected[key] += step;
+      break;
+    case 1:
+      ASSERT_EQUAL(map.erase(key), expected.erase(key));
+      break;
+    case 2:
+      map.stage(key, step);
+      staged.emplace_back(key, step);
+      if (step % 50 == 0) {
+        build();
+        ASSERT_TRUE(same_elements(map, expected));
+      }
+      break;
+    default:
+      ASSERT_EQUAL(map.count(key), expected.count(key));
+    }
+  }
+  build();
+  ASSERT_TRUE(same_elements(map, expected));
+}
+
+TEST(copy_and_move) {
+  FlatMap<std::string, int> map;
+  map["a"] = 1;
+  map.stage("b", 2);
+  FlatMap<std::string, int> copy(map);
+  map.build();
+  ASSERT_EQUAL(map.size(), 2);
+  ASSERT_EQUAL(copy.size(), 1);
+  ASSERT_EQUAL(copy.staged_size(), 1);
+
+  FlatMap<std::string, int> moved(std::move(map));
+  ASSERT_EQUAL(moved.size(), 2);
+  ASSERT_EQUAL(moved["b"], 2);
+  copy = moved;
+  ASSERT_EQUAL(copy.size(), 2);
+}
+
+TEST_MAIN()
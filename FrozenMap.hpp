@@ -0,0 +1,89 @@
+#ifndef FROZEN_MAP_HPP
+#define FROZEN_MAP_HPP
+/* FrozenMap.hpp
+ *
+ * An immutable, read-optimized snapshot of a Map, as returned by
+ * Map::freeze(). It offers the read-only part of the Map interface:
+ * find, iteration in key order, size and empty.
+ *
+ * The key-value pairs live in one contiguous array in Eytzinger order
+ * (see FrozenSearchTree.hpp), so a lookup does not chase a pointer to a
+ * separately allocated node at every level.
+ */
+
+#include "FrozenSearchTree.hpp"
+#include <functional> //less
+#include <utility>    //pair
+
+template <typename Key_type, typename Value_type,
+          typename Key_compare=std::less<Key_type> // default argument
+         >
+class FrozenMap {
+
+private:
+  using Pair_type = std::pair<Key_type, Value_type>;
+
+  // Orders pairs by key, and compares bare keys against pairs so that
+  // lookups do not need to build a pair.
+  class PairComp {
+  public:
+    bool operator() (const Pair_type &lhs, const Pair_type &rhs) const {
+      return Key_compare()(lhs.first, rhs.first);
+    }
+
+    bool operator() (const Key_type &lhs, const Pair_type &rhs) const {
+      return Key_compare()(lhs, rhs.first);
+    }
+
+    bool operator() (const Pair_type &lhs, const Key_type &rhs) const {
+      return Key_compare()(lhs.first, rhs);
+    }
+  };
+
+public:
+
+  // Iterators yield the pairs in ascending key order. They cannot be used
+  // to modify the snapshot.
+  using Iterator = typename FrozenSearchTree<Pair_type, PairComp>::Iterator;
+
+  // EFFECTS : Creates an empty snapshot.
+  FrozenMap() { }
+
+  // REQUIRES: [first, last) yields n key-value pairs in strictly
+  //           ascending key order
+  // EFFECTS : Creates a snapshot holding copies of those pairs.
+  template <typename InputIt>
+  FrozenMap(InputIt first, InputIt last, size_t n)
+    : elts(first, last, n) { }
+
+  // EFFECTS : Returns whether this snapshot is empty.
+  bool empty() const {
+    return elts.empty();
+  }
+
+  // EFFECTS : Returns the number of elements in this snapshot.
+  size_t size() const {
+    return elts.size();
+  }
+
+  // EFFECTS : Returns an Iterator to the pair with a key equivalent to k,
+  //           or an end Iterator if there is none.
+  Iterator find(const Key_type &k) const {
+    return elts.find(k);
+  }
+
+  // EFFECTS : Returns an iterator to the first key-value pair.
+  Iterator begin() const {
+    return elts.begin();
+  }
+
+  // EFFECTS : Returns an iterator to "past-the-end".
+  Iterator end() const {
+    return elts.end();
+  }
+
+private:
+  FrozenSearchTree<Pair_type, PairComp> elts;
+};
+
+#endif // FROZEN_MAP_HPP
@@ -0,0 +1,222 @@
+#ifndef FROZEN_SEARCH_TREE_HPP
+#define FROZEN_SEARCH_TREE_HPP
+/* FrozenSearchTree.hpp
+ *
+ * An immutable, read-optimized snapshot of a BinarySearchTree, as
+ * returned by BinarySearchTree::freeze().
+ *
+ * The elements are stored in one contiguous array in Eytzinger (BFS)
+ * order: the root is at index 1 and the children of the element at
+ * index k are at 2k and 2k + 1. A search therefore touches the array
+ * top-down, the first levels of the tree share a few cache lines, and
+ * the descendants four levels below an element are adjacent in memory
+ * and can be prefetched. The search loop has no data-dependent branch:
+ * each step computes the next index from the comparison result.
+ *
+ * Iteration visits the elements in ascending order by walking the
+ * implicit tree, in amortized O(1) per step.
+ */
+
+#include <cstddef>   //size_t
+#include <functional> //less
+#include <iterator>  //forward_iterator_tag
+#include <utility>   //move
+#include <vector>
+
+template <typename T, typename Compare=std::less<T>>
+class FrozenSearchTree {
+public:
+
+  // EFFECTS: Creates an empty snapshot.
+  FrozenSearchTree() { }
+
+  // REQUIRES: [first, last) yields n elements in strictly ascending
+  //           order according to Compare
+  // EFFECTS:  Creates a snapshot holding copies of those elements.
+  template <typename InputIt>
+  FrozenSearchTree(InputIt first, InputIt last, size_t n) {
+    std::vector<T> sorted;
+    sorted.reserve(n);
+    for (; first != last; ++first) {
+      sorted.push_back(*first);
+    }
+    n = sorted.size();
+
+    // Visiting the indices of the implicit tree in order gives the rank
+    // of the element at each Eytzinger position.
+    std::vector<size_t> rank(n + 1);
+    size_t next_rank = 0;
+    for (size_t k = first_index(n); k != 0; k = next_index(k, n)) {
+      rank[k] = next_rank++;
+    }
+    elts.reserve(n);
+    for (size_t k = 1; k <= n; ++k) {
+      elts.push_back(std::move(sorted[rank[k]]));
+    }
+  }
+
+  class Iterator {
+    // OVERVIEW: Iterates over the elements in ascending order. Elements
+    //           of a frozen tree cannot be modified. Iterators refer to
+    //           the array of elements, not to the snapshot, so they stay
+    //           valid when the snapshot is moved.
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const T *;
+    using reference = const T &;
+
+    Iterator()
+      : data(nullptr), count(0), index(0) { }
+
+    const T &operator*() const {
+      return data[index - 1];
+    }
+
+    const T *operator->() const {
+      return &data[index - 1];
+    }
+
+    Iterator &operator++() {
+      index = next_index(index, count);
+      return *this;
+    }
+
+    Iterator operator++(int) {
+      Iterator result(*this);
+      ++(*this);
+      return result;
+    }
+
+    bool operator==(const Iterator &rhs) const {
+      return index == rhs.index;
+    }
+
+    bool operator!=(const Iterator &rhs) const {
+      return index != rhs.index;
+    }
+
+  private:
+    friend class FrozenSearchTree;
+
+    const T *data;
+    size_t count;
+    size_t index; // Eytzinger index of the current element, 0 at the end
+
+    Iterator(const T *data_in, size_t count_in, size_t index_in)
+      : data(data_in), count(count_in), index(index_in) { }
+  };
+
+  // EFFECTS: Returns whether this snapshot is empty.
+  bool empty() const {
+    return elts.empty();
+  }
+
+  // EFFECTS: Returns the number of elements in this snapshot.
+  size_t size() const {
+    return elts.size();
+  }
+
+  Iterator begin() const {
+    return iterator_at(first_index(size()));
+  }
+
+  Iterator end() const {
+    return iterator_at(0);
+  }
+
+  // EFFECTS: Returns an iterator to the element equivalent to 'query', or
+  //          an end iterator if there is none. 'query' may be of any type
+  //          that Compare can compare against T.
+  template <typename Key>
+  Iterator find(const Key &query) const {
+    size_t k = lower_bound_index(query);
+    if (k != 0 && !less(query, elts[k - 1])) {
+      return iterator_at(k);
+    }
+    return end();
+  }
+
+  // EFFECTS: Returns an iterator to the smallest element not less than
+  //          'query', or an end iterator if there is none.
+  template <typename Key>
+  Iterator lower_bound(const Key &query) const {
+    return iterator_at(lower_bound_index(query));
+  }
+
+private:
+  // The element at Eytzinger index k is elts[k - 1]; indices start at 1
+  // so that the children of index k are 2k and 2k + 1.
+  std::vector<T> elts;
+  Compare less;
+
+  Iterator iterator_at(size_t k) const {
+    return Iterator(elts.data(), size(), k);
+  }
+
+  // EFFECTS: Returns the index of the first element in ascending order
+  //          in a tree of n elements, or 0 if there is none.
+  static size_t first_index(size_t n) {
+    size_t k = n == 0 ? 0 : 1;
+    while (k != 0 && 2 * k <= n) {
+      k = 2 * k;
+    }
+    return k;
+  }
+
+  // EFFECTS: Returns the index of the element after the one at index k
+  //          in ascending order in a tree of n elements, or 0 if there
+  //          is none.
+  static size_t next_index(size_t k, size_t n) {
+    if (2 * k + 1 <= n) {
+      // leftmost element of the right subtree
+      k = 2 * k + 1;
+      while (2 * k <= n) {
+        k = 2 * k;
+      }
+      return k;
+    }
+    // climb past every ancestor whose right subtree we are in, then one
+    // more level to the ancestor whose left subtree we are in
+    return k >> (trailing_ones(k) + 1);
+  }
+
+  // EFFECTS: Returns the index of the smallest element not less than
+  //          'query', or 0 if there is none.
+  template <typename Key>
+  size_t lower_bound_index(const Key &query) const {
+    const size_t n = size();
+    const T *data = elts.data();
+    size_t k = 1;
+    while (k <= n) {
+#if defined(__GNUC__)
+      // the 16 descendants four levels down are contiguous; near the
+      // leaves they do not exist, and even forming a pointer past the
+      // end of the array is undefined
+      if (16 * k <= n) {
+        __builtin_prefetch(data + 16 * k - 1);
+      }
+#endif
+      k = 2 * k + static_cast<size_t>(less(data[k - 1], query));
+    }
+    // k encodes the path taken; the last left turn marks the answer
+    return k >> (trailing_ones(k) + 1);
+  }
+
+  // EFFECTS: Returns the number of trailing 1 bits in k.
+  static int trailing_ones(size_t k) {
+#if defined(__GNUC__)
+    return ~k == 0 ? static_cast<int>(sizeof(k) * 8)
+                   : __builtin_ctzll(~static_cast<unsigned long long>(k));
+#else
+    int count = 0;
+    for (; k & 1; k >>= 1) {
+      ++count;
+    }
+    return count;
+#endif
+  }
+};
+
+#endif // FROZEN_SEARCH_TREE_HPP
@@ -0,0 +1,103 @@
+#ifndef ITERATOR_RANGE_HPP
+#define ITERATOR_RANGE_HPP
+/* IteratorRange.hpp
+ *
+ * A view of the elements between two iterators of a container, as
+ * returned by the range() member of BinarySearchTree, BTree,
+ * CompactSearchTree, Map and FlatMap. It can be used in a range-based for loop:
+ *
+ *   for (auto &entry : counts.range("proj", "prok")) { ... }
+ *
+ * The view refers to the container's elements and does not own them.
+ *
+ * The free functions below hold the range logic that the ordered
+ * containers share: checking that input is strictly ascending, and
+ * turning lower bounds into an equal_range() or a range().
+ */
+
+#include <iterator>  //next
+#include <stdexcept> //invalid_argument
+#include <utility>   //pair
+
+template <typename Iterator>
+class IteratorRange {
+public:
+  IteratorRange(Iterator first_in, Iterator last_in)
+    : first(first_in), last(last_in) { }
+
+  Iterator begin() const {
+    return first;
+  }
+
+  Iterator end() const {
+    return last;
+  }
+
+  // EFFECTS: Returns whether the view contains no elements.
+  bool empty() const {
+    return first == last;
+  }
+
+private:
+  Iterator first;
+  Iterator last;
+};
+
+// EFFECTS: Returns whether every element of [first, last) is less than
+//          the next one according to 'less'. Needs only forward
+//          iterators.
+template <typename ForwardIt, typename Compare>
+bool is_strictly_ascending(ForwardIt first, ForwardIt last,
+                           const Compare &less) {
+  if (first == last) {
+    return true;
+  }
+  for (ForwardIt next = std::next(first); next != last; ++first, ++next) {
+    if (!less(*first, *next)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// EFFECTS: Throws std::invalid_argument unless [first, last) is strictly
+//          ascending according to 'less', as from_sorted() requires.
+template <typename ForwardIt, typename Compare>
+void require_strictly_ascending(ForwardIt first, ForwardIt last,
+                                const Compare &less) {
+  if (!is_strictly_ascending(first, last, less)) {
+    throw std::invalid_argument("from_sorted: range is not strictly "
+                                "ascending");
+  }
+}
+
+// REQUIRES: first is the lower bound of key in a container of unique
+//           elements whose end iterator is 'end'
+// EFFECTS:  Returns the range of elements equivalent to key, which holds
+//           at most one element.
+template <typename Iterator, typename Key, typename Compare>
+std::pair<Iterator, Iterator> unique_equal_range(Iterator first,
+                                                 Iterator end,
+                                                 const Key &key,
+                                                 const Compare &less) {
+  if (first == end || less(key, *first)) {
+    return std::make_pair(first, first);
+  }
+  return std::make_pair(first, std::next(first));
+}
+
+// REQUIRES: first and last are the lower bounds of lo and hi in a
+//           container whose end iterator is 'end'
+// EFFECTS:  Returns a view of the elements that are not less than lo and
+//           less than hi, which is empty if hi < lo.
+template <typename Iterator, typename Compare>
+IteratorRange<Iterator> bounded_range(Iterator first, Iterator last,
+                                      Iterator end, const Compare &less) {
+  if (first == end || (last != end && less(*last, *first))) {
+    // nothing is at least lo, or hi < lo: the range is empty
+    last = first;
+  }
+  return IteratorRange<Iterator>(first, last);
+}
+
+#endif // ITERATOR_RANGE_HPP
@@ -16,11 +16,19 @@
  */
 
 #include "BinarySearchTree.hpp"
+#include "FrozenMap.hpp"
 #include <cassert>  //assert
-#include <utility>  //pair
+#include <utility>  //pair, move, piecewise_construct
+#include <tuple>    //forward_as_tuple
+#include <type_traits> //enable_if, is_same, decay
+#include <functional>  //plus
+#include <stdexcept>   //out_of_range
 
 template <typename Key_type, typename Value_type,
-          typename Key_compare=std::less<Key_type> // default argument
+          typename Key_compare=std::less<Key_type>, // default argument
+          template <typename> class Node_allocator=PoolNodeAllocator,
+          template <typename, typename, template <typename> class>
+            class Tree_template=AVLTreeBackend
          >
 class Map {
 
@@ -30,23 +38,46 @@ private:
   // See http://www.cplusplus.com/reference/utility/pair/
   using Pair_type = std::pair<Key_type, Value_type>;
 
-  // A custom comparator
+  // A custom comparator. PairComp(lhs, rhs) returns true if the key of
+  // lhs is less than the key of rhs. Everything is taken by reference, so
+  // comparing never copies a key or a value.
   class PairComp {
 public:
-    bool operator() (Pair_type lhs, Pair_type rhs) const {
-
-
+    bool operator() (const Pair_type &lhs, const Pair_type &rhs) const {
+      return Key_compare()(lhs.first, rhs.first);
+    }
 
-      Key_compare less;
+    // Compare a bare key against an element, so the tree can be searched
+    // for a key without building a pair around it. With a transparent
+    // Key_compare (one that defines is_transparent, like std::less<>),
+    // the key may be of any type Key_compare accepts, such as a
+    // std::string_view looked up in a Map keyed by std::string.
+    template <typename K>
+    bool operator() (const K &lhs, const Pair_type &rhs) const {
+      return Key_compare()(lhs, rhs.first);
+    }
 
-      return less(lhs.first, rhs.first);
-      
+    template <typename K>
+    bool operator() (const Pair_type &lhs, const K &rhs) const {
+      return Key_compare()(lhs.first, rhs);
     }
+  };
 
-    //PairComp(lhs, rhs) return true if lhs < rhs
+  // Enables an overload for lookup keys of type K other than Key_type
+  // only if C, which defaults to Key_compare, is transparent.
+  template <typename K, typename C>
+  using Enable_if_transparent =
+    typename std::enable_if<!std::is_same<typename std::decay<K>::type,
+                                          Key_type>::value,
+                            typename C::is_transparent>::type;
 
-    // less(lhs, rhs) //
-  };
+  // The underlying tree is AVL-balanced by default so that keys arriving
+  // in sorted order (e.g. from sorted CSV exports) still give O(log n)
+  // lookups. Tree_template selects another backend with the same
+  // interface, such as BTreeBackend from BTree.hpp. Its nodes come from
+  // Node_allocator (see NodeAllocator.hpp); the default pool keeps them
+  // in contiguous slabs.
+  using Tree_type = Tree_template<Pair_type, PairComp, Node_allocator>;
 
 public:
 
@@ -65,13 +96,11 @@ public:
   // Type alias for iterator type. It is sufficient to use the Iterator
   // from BinarySearchTree<Pair_type> since it will yield elements of Pair_type
   // in the appropriate order for the Map.
-  using Iterator = typename BinarySearchTree<Pair_type, PairComp>::Iterator;
+  using Iterator = typename Tree_type::Iterator;
 
-  // You should add in a default constructor, destructor, copy
-  // constructor, and overloaded assignment operator, if appropriate.
-  // If these operations will work correctly without defining them,
-  // you should omit them. A user of the class must be able to create,
-  // copy, assign, and destroy Maps.
+  // The implicitly defined constructors, assignment operators and
+  // destructor do the right thing: copying a Map copies its tree, and
+  // moving a Map takes over the tree's nodes in constant time.
 
 
   // EFFECTS : Returns whether this Map is empty.
@@ -88,20 +117,97 @@ public:
   // EFFECTS : Searches this Map for an element with a key equivalent
   //           to k and returns an Iterator to the associated value if found,
   //           otherwise returns an end Iterator.
-  //
-  // HINT: Since Map is implemented using a BinarySearchTree that stores
-  //       (key, value) pairs, you'll need to construct a dummy value
-  //       using "Value_type()".
+  // NOTE    : The tree is searched with the bare key (see PairComp), so
+  //           no (key, value) pair is built and nothing is allocated.
   Iterator find(const Key_type& k) const {
-    if (tree.empty()){
-      return tree.end();
-    }
-    Pair_type dummyPair(k, Value_type());
-    return tree.find(dummyPair);
+    return tree.find(k);
+  }
+
+  // EFFECTS : Same as above, for a key of any type that a transparent
+  //           Key_compare can compare against Key_type.
+  template <typename K, typename C = Key_compare,
+            typename = Enable_if_transparent<K, C>>
+  Iterator find(const K& k) const {
+    return tree.find(k);
+  }
 
+  // EFFECTS : Returns the number of elements with a key equivalent to k,
+  //           which is either 0 or 1.
+  size_t count(const Key_type& k) const {
+    return contains(k) ? 1 : 0;
   }
 
+  template <typename K, typename C = Key_compare,
+            typename = Enable_if_transparent<K, C>>
+  size_t count(const K& k) const {
+    return contains(k) ? 1 : 0;
+  }
+
+  // EFFECTS : Returns whether this Map has an element with a key
+  //           equivalent to k.
+  bool contains(const Key_type& k) const {
+    return find(k) != end();
+  }
 
+  template <typename K, typename C = Key_compare,
+            typename = Enable_if_transparent<K, C>>
+  bool contains(const K& k) const {
+    return find(k) != end();
+  }
+
+
+
+  // EFFECTS : Returns an Iterator to the first element whose key is not
+  //           less than k, or an end Iterator if there is none.
+  Iterator lower_bound(const Key_type& k) const {
+    return tree.lower_bound(k);
+  }
+
+  template <typename K, typename C = Key_compare,
+            typename = Enable_if_transparent<K, C>>
+  Iterator lower_bound(const K& k) const {
+    return tree.lower_bound(k);
+  }
+
+  // EFFECTS : Returns an Iterator to the first element whose key is
+  //           greater than k, or an end Iterator if there is none.
+  Iterator upper_bound(const Key_type& k) const {
+    return tree.upper_bound(k);
+  }
+
+  template <typename K, typename C = Key_compare,
+            typename = Enable_if_transparent<K, C>>
+  Iterator upper_bound(const K& k) const {
+    return tree.upper_bound(k);
+  }
+
+  // EFFECTS : Returns the pair (lower_bound(k), upper_bound(k)), which
+  //           spans the element with key k if there is one.
+  std::pair<Iterator, Iterator> equal_range(const Key_type& k) const {
+    return tree.equal_range(k);
+  }
+
+  template <typename K, typename C = Key_compare,
+            typename = Enable_if_transparent<K, C>>
+  std::pair<Iterator, Iterator> equal_range(const K& k) const {
+    return tree.equal_range(k);
+  }
+
+  // EFFECTS : Returns a view of the elements whose keys are not less than
+  //           lo and less than hi, in key order. Costs O(log n) to set up
+  //           plus O(1) amortized per element visited, so for example
+  //           range("proj", "prok") walks only the keys that start with
+  //           "proj".
+  IteratorRange<Iterator> range(const Key_type& lo,
+                                const Key_type& hi) const {
+    return tree.range(lo, hi);
+  }
+
+  template <typename K, typename C = Key_compare,
+            typename = Enable_if_transparent<K, C>>
+  IteratorRange<Iterator> range(const K& lo, const K& hi) const {
+    return tree.range(lo, hi);
+  }
 
   // MODIFIES: this
   // EFFECTS : Returns a reference to the mapped value for the given
@@ -120,8 +226,41 @@ public:
   //
   // HINT: http://www.cplusplus.com/reference/map/map/operator[]/
   Value_type& operator[](const Key_type& k){
-    Pair_type dummyPair(k, Value_type());
-    return insert(dummyPair).first->second;
+    return try_emplace(k).first->second;
+  }
+
+  // MODIFIES: this
+  // EFFECTS : Same as above, but moves k into the new element if one is
+  //           inserted.
+  Value_type& operator[](Key_type&& k){
+    return try_emplace(std::move(k)).first->second;
+  }
+
+  // MODIFIES: this
+  // EFFECTS : Same as above, for a key of any type that a transparent
+  //           Key_compare can compare against Key_type. A Key_type is
+  //           constructed from k only if a new element is inserted.
+  template <typename K, typename C = Key_compare,
+            typename = Enable_if_transparent<K, C>>
+  Value_type& operator[](const K& k){
+    return tree.try_emplace(k, std::piecewise_construct,
+                            std::forward_as_tuple(k),
+                            std::forward_as_tuple()).first->second;
+  }
+
+  // EFFECTS : Returns a reference to the mapped value of the element
+  //           with a key equivalent to k. Throws std::out_of_range if
+  //           there is none, like std::map::at.
+  Value_type& at(const Key_type& k){
+    Iterator it = find(k);
+    if (it == end()) {
+      throw std::out_of_range("Map::at: key not found");
+    }
+    return it->second;
+  }
+
+  const Value_type& at(const Key_type& k) const {
+    return const_cast<Map *>(this)->at(k);
   }
 
   // MODIFIES: this
@@ -133,15 +272,216 @@ public:
   //           an iterator to the newly inserted element, along with
   //           the value true.
   std::pair<Iterator, bool> insert(const Pair_type &val){
-    Pair_type dummyPair(val.first, Value_type()); 
-    auto existing_it = tree.find(dummyPair);
-    if (existing_it != tree.end()){
-      return std::make_pair(existing_it, false);
+    return tree.try_emplace(val.first, val);
+  }
+
+  // MODIFIES: this
+  // EFFECTS : Same as above, but moves val into the new element if one is
+  //           inserted. If the key is already in the Map, val is left
+  //           untouched.
+  std::pair<Iterator, bool> insert(Pair_type &&val){
+    return tree.try_emplace(val.first, std::move(val));
+  }
+
+  // MODIFIES: this
+  // EFFECTS : Constructs an element in place from args, as if by
+  //           Pair_type(args...), and inserts it if its key is not
+  //           already contained in the Map. Returns the same as insert().
+  template <typename... Args>
+  std::pair<Iterator, bool> emplace(Args&&... args){
+    return tree.emplace(std::forward<Args>(args)...);
+  }
+
+  // MODIFIES: this
+  // EFFECTS : Inserts val if its key is not already contained, as close
+  //           as possible to the position just before 'hint'. Returns an
+  //           iterator to the inserted element, or to the existing
+  //           element with the same key.
+  // NOTE:     When val belongs right next to 'hint', the AVL tree
+  //           backend finds its place without searching from the root,
+  //           so loading keys in ascending order with the hint end()
+  //           costs amortized O(1) per key (see
+  //           BinarySearchTree::insert).
+  Iterator insert(Iterator hint, const Pair_type &val){
+    return tree.insert(hint, val);
+  }
+
+  // MODIFIES: this
+  // EFFECTS : Same as above, but moves val into the new element if one is
+  //           inserted.
+  Iterator insert(Iterator hint, Pair_type &&val){
+    return tree.insert(hint, std::move(val));
+  }
+
+  // MODIFIES: this
+  // EFFECTS : Constructs an element in place from args and inserts it as
+  //           insert(hint, val) does.
+  template <typename... Args>
+  Iterator emplace_hint(Iterator hint, Args&&... args){
+    return tree.emplace_hint(hint, std::forward<Args>(args)...);
+  }
+
+  // MODIFIES: this
+  // EFFECTS : If k is already in the Map, returns an iterator to the
+  //           existing element along with false and does not touch args.
+  //           Otherwise inserts an element with key k and a mapped value
+  //           constructed in place from args, and returns an iterator to
+  //           it along with true.
+  template <typename... Args>
+  std::pair<Iterator, bool> try_emplace(const Key_type &k, Args&&... args){
+    return tree.try_emplace(k, std::piecewise_construct,
+                            std::forward_as_tuple(k),
+                            std::forward_as_tuple(std::forward<Args>(args)...));
+  }
+
+  // MODIFIES: this
+  // EFFECTS : Same as above, but moves k into the new element if one is
+  //           inserted.
+  template <typename... Args>
+  std::pair<Iterator, bool> try_emplace(Key_type &&k, Args&&... args){
+    return tree.try_emplace(k, std::piecewise_construct,
+                            std::forward_as_tuple(std::move(k)),
+                            std::forward_as_tuple(std::forward<Args>(args)...));
+  }
+
+  // MODIFIES: this
+  // EFFECTS : If k is already in the Map, assigns std::forward<M>(obj) to
+  //           its mapped value and returns an iterator to it along with
+  //           false. Otherwise inserts an element with key k and a mapped
+  //           value constructed from obj, and returns an iterator to it
+  //           along with true. Either way the tree is searched once.
+  template <typename M>
+  std::pair<Iterator, bool> insert_or_assign(const Key_type &k, M &&obj){
+    std::pair<Iterator, bool> result = try_emplace(k, std::forward<M>(obj));
+    if (!result.second) {
+      result.first->second = std::forward<M>(obj);
     }
-    else{
-      auto inserted_it = tree.insert(val);
-      return std::make_pair(inserted_it, true);
+    return result;
+  }
+
+  // MODIFIES: this
+  // EFFECTS : Same as above, but moves k into the new element if one is
+  //           inserted.
+  template <typename M>
+  std::pair<Iterator, bool> insert_or_assign(Key_type &&k, M &&obj){
+    std::pair<Iterator, bool> result = try_emplace(std::move(k),
+                                                   std::forward<M>(obj));
+    if (!result.second) {
+      result.first->second = std::forward<M>(obj);
     }
+    return result;
+  }
+
+  // REQUIRES: pos points to an element of this Map
+  // MODIFIES: this
+  // EFFECTS : Removes the element at pos and returns an iterator to the
+  //           element that followed it. The tree stays balanced, and the
+  //           freed node goes back to Node_allocator for reuse. With the
+  //           default AVL backend only iterators to the removed element
+  //           are invalidated; other backends may invalidate more (see
+  //           BTree::erase).
+  Iterator erase(Iterator pos){
+    return tree.erase(pos);
+  }
+
+  // MODIFIES: this
+  // EFFECTS : Removes the elements in [first, last) and returns an
+  //           iterator to the element that followed them.
+  Iterator erase(Iterator first, Iterator last){
+    return tree.erase(first, last);
+  }
+
+  // MODIFIES: this
+  // EFFECTS : Removes the element with key k, if there is one, and
+  //           returns the number of elements removed (0 or 1).
+  size_t erase(const Key_type& k){
+    return tree.erase(k);
+  }
+
+  template <typename K, typename C = Key_compare,
+            typename = Enable_if_transparent<K, C>>
+  size_t erase(const K& k){
+    return tree.erase(k);
+  }
+
+  // MODIFIES: this
+  // EFFECTS : Removes every element. The nodes are kept by the node pool,
+  //           so the Map can grow again without new allocations.
+  void clear(){
+    tree.clear();
+  }
+
+  // MODIFIES: this, other
+  // EFFECTS : Moves every pair of 'other' into this Map, leaving 'other'
+  //           empty. Where both Maps hold a key, its mapped value becomes
+  //           combine(std::move(mine), std::move(theirs)).
+  // NOTE:     Only the default AVL backend has the set operations. No pair
+  //           is copied and no node is allocated: the two trees are split
+  //           and joined in O(m log(n/m + 1)) time for sizes m <= n, and
+  //           independent subtrees are merged on up to 'threads' threads,
+  //           so 'combine' must not throw and must be safe to call from
+  //           several threads at once (see BinarySearchTree::union_with).
+  template <typename Combine>
+  void union_with(Map &&other, Combine combine,
+                  unsigned threads = Tree_type::available_threads()){
+    tree.union_with(std::move(other.tree), Combine_values<Combine>{combine},
+                    threads);
+  }
+
+  // MODIFIES: this, other
+  // EFFECTS : Same as union_with, adding the mapped values of keys found
+  //           in both Maps with +. Unlike std::map::merge, 'other' always
+  //           ends up empty.
+  void merge(Map &&other,
+             unsigned threads = Tree_type::available_threads()){
+    union_with(std::move(other), std::plus<>(), threads);
+  }
+
+  // MODIFIES: this, other
+  // EFFECTS : Keeps only the pairs of this Map whose keys are also in
+  //           'other', with their mapped values unchanged, and leaves
+  //           'other' empty. See union_with.
+  void intersection(Map &&other,
+                    unsigned threads = Tree_type::available_threads()){
+    tree.intersection(std::move(other.tree), Keep_value(), threads);
+  }
+
+  // MODIFIES: this, other
+  // EFFECTS : Removes the pairs of this Map whose keys are in 'other', and
+  //           leaves 'other' empty. See union_with.
+  void difference(Map &&other,
+                  unsigned threads = Tree_type::available_threads()){
+    tree.difference(std::move(other.tree), threads);
+  }
+
+  // REQUIRES: [first, last) is a forward range of key-value pairs whose
+  //           keys are in strictly ascending order according to
+  //           Key_compare
+  // EFFECTS : Returns a Map holding the pairs of [first, last), built as a
+  //           perfectly balanced tree in linear time. If 'verify' is
+  //           true, first checks the requirement and throws
+  //           std::invalid_argument if it does not hold.
+  template <typename ForwardIt>
+  static Map from_sorted(ForwardIt first, ForwardIt last, bool verify = true){
+    Map result;
+    result.tree = Tree_type::from_sorted(first, last, verify);
+    return result;
+  }
+
+  // EFFECTS : Returns an immutable snapshot of this Map with its pairs
+  //           laid out contiguously for fast lookups (see FrozenMap.hpp).
+  //           Later changes to this Map do not affect the snapshot.
+  FrozenMap<Key_type, Value_type, Key_compare> freeze() const{
+    return FrozenMap<Key_type, Value_type, Key_compare>(begin(), end(),
+                                                        size());
+  }
+
+  // EFFECTS : Returns the memory used by this Map and the shape of its
+  //           tree (see MemoryUsage.hpp). The heap memory of keys and
+  //           values, such as long std::string buffers, is estimated.
+  // NOTE:     Only the default AVL backend reports memory usage.
+  MemoryUsage memory_usage() const{
+    return tree.memory_usage();
   }
 
   // EFFECTS : Returns an iterator to the first key-value pair in this Map.
@@ -155,7 +495,23 @@ public:
   }
 
 private:
-  BinarySearchTree<Pair_type, PairComp> tree; 
+  // Adapts a function of two mapped values to the set operations of the
+  // tree, which update the pair kept from this Map in place.
+  template <typename Combine>
+  struct Combine_values {
+    Combine &combine;
+
+    void operator()(Pair_type &mine, Pair_type &&theirs) const {
+      mine.second = combine(std::move(mine.second), std::move(theirs.second));
+    }
+  };
+
+  // Leaves the mapped value of this Map as it is.
+  struct Keep_value {
+    void operator()(Pair_type &, Pair_type &&) const { }
+  };
+
+  Tree_type tree;
   
 };
 
@@ -0,0 +1,452 @@
+// Map_bench.cpp
+//
+// Benchmarks for Map and the containers that share its interface.
+//
+// frozen:  lookup throughput of the pointer-based Map versus the
+//          contiguous Eytzinger-ordered FrozenMap from Map::freeze().
+// backend: insert and lookup throughput of Map over the AVL tree, the
+//          B-tree and the compact index-based tree backends, and the node
+//          memory each uses per element (reported in the ns_per_op column
+//          as bytes_per_elt).
+// concurrent: read throughput of ConcurrentMap versus a Map behind a
+//          mutex, with 1 to N reader threads and an updater thread
+//          inserting a key every 100us. ns_per_op is wall time divided
+//          by the finds of all readers, so it falls as reads scale.
+// flat:    building (insert per key versus FlatMap's stage() and one
+//          build()), lookup throughput and memory per element
+//          (bytes_per_elt) of Map versus the sorted-array FlatMap, with
+//          int keys and with the vocabulary of a CSV corpus as keys.
+// mapped:  startup cost of a Map<string, int> with n keys: building it
+//          by inserting every key versus opening a file written by
+//          save_mapped() as a MappedMap, in total ns (not per key), and
+//          find throughput of both.
+// unordered: word counting (operator[] per word, then find per word) with
+//          Map, the open-addressing UnorderedMap (with and without
+//          reserve) and std::unordered_map, over the words of a CSV
+//          corpus and over a million distinct words.
+// setops:  merging, intersecting and subtracting two Maps of n keys each
+//          (half of them shared) with the split/join set operations on
+//          1 to 8 threads, versus inserting the other Map's pairs one by
+//          one, and merging a Map of n / 1000 keys into one of n keys.
+//          ns_per_op is divided over the pairs of both inputs.
+
+#include "Map.hpp"
+#include "BTree.hpp"
+#include "CompactSearchTree.hpp"
+#include "ConcurrentMap.hpp"
+#include "FlatMap.hpp"
+#include "MappedTree.hpp"
+#include "UnorderedMap.hpp"
+#include "Benchmark.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// EFFECTS: Times one find() per key in 'queries' against 'map'.
+template <typename Map_type, typename Key>
+void bench_lookups(const string &suite, const string &structure,
+                   const Map_type &map, const vector<Key> &queries) {
+  Stopwatch timer;
+  long long sum = 0;
+  for (const Key &key : queries) {
+    sum += map.find(key)->second;
+  }
+  do_not_optimize(sum);
+  report(suite, structure, "find", map.size(), timer.elapsed_ns(),
+         queries.size());
+}
+
+// Bytes of all nodes ever created through a CountingNodeAllocator
+size_t counted_node_bytes = 0;
+
+// Allocates nodes like HeapNodeAllocator and adds their sizes to
+// counted_node_bytes.
+template <typename Node>
+class CountingNodeAllocator : public HeapNodeAllocator<Node> {
+public:
+  template <typename... Args>
+  Node *create(Args&&... args) {
+    counted_node_bytes += sizeof(Node);
+    return HeapNodeAllocator<Node>::create(std::forward<Args>(args)...);
+  }
+};
+
+// A standard allocator that keeps counted_node_bytes equal to the bytes
+// it currently has allocated, for backends that store nodes in arrays.
+template <typename T>
+class CountingAllocator : public std::allocator<T> {
+public:
+  template <typename U>
+  struct rebind {
+    using other = CountingAllocator<U>;
+  };
+
+  CountingAllocator() = default;
+
+  template <typename U>
+  CountingAllocator(const CountingAllocator<U> &) { }
+
+  T *allocate(size_t n) {
+    counted_node_bytes += n * sizeof(T);
+    return std::allocator<T>::allocate(n);
+  }
+
+  void deallocate(T *p, size_t n) {
+    counted_node_bytes -= n * sizeof(T);
+    std::allocator<T>::deallocate(p, n);
+  }
+};
+
+template <typename T, typename Compare, template <typename> class>
+using CountedCompactBackend = CompactSearchTree<T, Compare, CountingAllocator>;
+
+// Counted_template is the backend to measure memory with; it defaults to
+// Tree_template, which then gets its nodes from CountingNodeAllocator.
+template <template <typename, typename, template <typename> class>
+          class Tree_template,
+          template <typename, typename, template <typename> class>
+          class Counted_template = Tree_template>
+void bench_backend(const string &structure, const vector<int> &keys,
+                   const vector<int> &queries) {
+  using Map_type = Map<int, int, less<int>, PoolNodeAllocator, Tree_template>;
+  Map_type map;
+  Stopwatch timer;
+  for (int key : keys) {
+    map[key] = key;
+  }
+  report("backend", structure, "insert", keys.size(), timer.elapsed_ns(),
+         keys.size());
+  bench_lookups("backend", structure, map, queries);
+
+  // Rebuild with counting allocators to measure node memory
+  Map<int, int, less<int>, CountingNodeAllocator, Counted_template> counted;
+  counted_node_bytes = 0;
+  for (int key : keys) {
+    counted[key] = key;
+  }
+  report("backend", structure, "bytes_per_elt", keys.size(),
+         counted_node_bytes, keys.size());
+}
+
+// A Map that serializes every access with a mutex, for comparison
+class LockedMap {
+public:
+  void insert(int key, int value) {
+    std::lock_guard<std::mutex> lock(mutex);
+    map[key] = value;
+  }
+
+  int get(int key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = map.find(key);
+    return it == map.end() ? 0 : it->second;
+  }
+
+private:
+  std::mutex mutex;
+  Map<int, int> map;
+};
+
+int value_of(const std::optional<int> &value) {
+  return value ? *value : 0;
+}
+
+int value_of(int value) {
+  return value;
+}
+
+// EFFECTS: Times 'threads' readers each doing one get() per key in
+//          'queries', while an updater inserts new keys into 'map'.
+template <typename Map_type>
+void bench_readers(const string &structure, Map_type &map, size_t n,
+                   const vector<int> &queries, int threads) {
+  std::atomic<bool> done(false);
+  std::thread updater([&map, &done, n] {
+    for (int key = static_cast<int>(n); !done.load(); ++key) {
+      map.insert(key, key);
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+  });
+
+  Stopwatch timer;
+  vector<std::thread> readers;
+  for (int t = 0; t < threads; ++t) {
+    readers.emplace_back([&map, &queries] {
+      long long sum = 0;
+      for (int key : queries) {
+        sum += value_of(map.get(key));
+      }
+      do_not_optimize(sum);
+    });
+  }
+  for (std::thread &reader : readers) {
+    reader.join();
+  }
+  double elapsed = timer.elapsed_ns();
+  done = true;
+  updater.join();
+  report("concurrent", structure, "find_" + to_string(threads) + "_threads",
+         n, elapsed, queries.size() * threads);
+}
+
+void bench_concurrent(size_t n) {
+  vector<int> queries = shuffled_ints(n, 281);
+  int max_threads = max(4, static_cast<int>(std::thread::hardware_concurrency()));
+  for (int threads = 1; threads <= max_threads; threads *= 2) {
+    ConcurrentMap<int, int> concurrent;
+    LockedMap locked;
+    for (int key : shuffled_ints(n)) {
+      concurrent.insert(key, key);
+      locked.insert(key, key);
+    }
+    bench_readers("concurrent_map", concurrent, n, queries, threads);
+    bench_readers("locked_map", locked, n, queries, threads);
+  }
+}
+
+void bench_frozen(size_t n) {
+  vector<pair<int, int>> sorted;
+  sorted.reserve(n);
+  for (size_t i = 0; i < n; ++i) {
+    sorted.emplace_back(static_cast<int>(i), static_cast<int>(i));
+  }
+  // The same random queries, all hits, for both containers
+  vector<int> queries = shuffled_ints(n);
+  queries.resize(min<size_t>(n, 1000000));
+
+  Map<int, int> map = Map<int, int>::from_sorted(sorted.begin(), sorted.end());
+  bench_lookups("frozen", "map", map, queries);
+
+  Stopwatch timer;
+  FrozenMap<int, int> frozen = map.freeze();
+  report("frozen", "frozen_map", "freeze", n, timer.elapsed_ns(), n);
+  bench_lookups("frozen", "frozen_map", frozen, queries);
+}
+
+// EFFECTS: Times building a Map and a FlatMap from 'keys' and then one
+//          find() per key in 'queries', and measures their memory.
+template <typename Key>
+void bench_flat(const string &structure_suffix, const vector<Key> &keys,
+                const vector<Key> &queries) {
+  Stopwatch timer;
+  Map<Key, int> map;
+  for (const Key &key : keys) {
+    map[key] = 1;
+  }
+  report("flat", "map" + structure_suffix, "build", keys.size(),
+         timer.elapsed_ns(), keys.size());
+  bench_lookups("flat", "map" + structure_suffix, map, queries);
+
+  timer.restart();
+  FlatMap<Key, int> flat;
+  for (const Key &key : keys) {
+    flat.stage(key, 1);
+  }
+  flat.build();
+  report("flat", "flat_map" + structure_suffix, "build", keys.size(),
+         timer.elapsed_ns(), keys.size());
+  bench_lookups("flat", "flat_map" + structure_suffix, flat, queries);
+
+  // Rebuild with counting allocators to measure memory
+  counted_node_bytes = 0;
+  {
+    Map<Key, int, less<Key>, CountingNodeAllocator> counted;
+    for (const Key &key : keys) {
+      counted[key] = 1;
+    }
+  }
+  report("flat", "map" + structure_suffix, "bytes_per_elt", keys.size(),
+         counted_node_bytes, keys.size());
+  counted_node_bytes = 0;
+  FlatMap<Key, int, less<Key>, CountingAllocator> counted;
+  for (const Key &key : keys) {
+    counted.stage(key, 1);
+  }
+  counted.build();
+  report("flat", "flat_map" + structure_suffix, "bytes_per_elt", keys.size(),
+         counted_node_bytes, keys.size());
+}
+
+void bench_mapped(size_t n) {
+  vector<string> keys = shuffled_words(n);
+  vector<string> queries = shuffled_words(n, 281);
+  const string path = "Map_bench_mapped.bin";
+
+  Stopwatch timer;
+  Map<string, int> map;
+  for (const string &key : keys) {
+    map[key] = 1;
+  }
+  report("mapped", "map", "startup_total", n, timer.elapsed_ns(), 1);
+  bench_lookups("mapped", "map", map, queries);
+
+  timer.restart();
+  save_mapped(map, path);
+  report("mapped", "map", "save_total", n, timer.elapsed_ns(), 1);
+
+  timer.restart();
+  MappedMap<string, int> mapped(path);
+  report("mapped", "mapped_map", "startup_total", n, timer.elapsed_ns(), 1);
+  timer.restart();
+  long long sum = 0;
+  for (const string &key : queries) {
+    sum += mapped.find(key)->second;
+  }
+  do_not_optimize(sum);
+  report("mapped", "mapped_map", "find", n, timer.elapsed_ns(),
+         queries.size());
+  std::remove(path.c_str());
+}
+
+// EFFECTS: Times ++counts[word] for every word of 'words', starting
+//          from the given empty map, and then one find() per word.
+template <typename Map_type>
+void bench_word_count(const string &structure, const vector<string> &words,
+                      Map_type counts = Map_type()) {
+  Stopwatch timer;
+  for (const string &word : words) {
+    ++counts[word];
+  }
+  report("unordered", structure, "count_words", counts.size(),
+         timer.elapsed_ns(), words.size());
+
+  timer.restart();
+  long long sum = 0;
+  for (const string &word : words) {
+    sum += counts.find(word)->second;
+  }
+  do_not_optimize(sum);
+  report("unordered", structure, "find", counts.size(), timer.elapsed_ns(),
+         words.size());
+}
+
+void bench_unordered(const vector<string> &words) {
+  vector<string> vocabulary = words;
+  sort(vocabulary.begin(), vocabulary.end());
+  size_t distinct = unique(vocabulary.begin(), vocabulary.end()) -
+                    vocabulary.begin();
+
+  bench_word_count<Map<string, int>>("map", words);
+  bench_word_count<UnorderedMap<string, int>>("unordered_map", words);
+  UnorderedMap<string, int> reserved;
+  reserved.reserve(distinct);
+  bench_word_count("unordered_map_reserved", words, std::move(reserved));
+  bench_word_count<unordered_map<string, int>>("std_unordered_map", words);
+}
+
+// EFFECTS: Returns a Map from each of 'keys' to 1.
+Map<int, int> map_of(const vector<int> &keys) {
+  Map<int, int> map;
+  for (int key : keys) {
+    map[key] = 1;
+  }
+  return map;
+}
+
+// EFFECTS: Times operation(mine, theirs) on fresh copies of the two Maps
+//          and reports it per pair of input.
+template <typename Operation>
+void bench_set_operation(const string &structure, const string &name,
+                         const Map<int, int> &mine,
+                         const Map<int, int> &theirs, Operation operation) {
+  Map<int, int> mine_copy = mine;
+  Map<int, int> theirs_copy = theirs;
+  size_t pairs = mine.size() + theirs.size();
+  Stopwatch timer;
+  operation(mine_copy, theirs_copy);
+  report("setops", structure, name, pairs, timer.elapsed_ns(), pairs);
+  do_not_optimize(mine_copy.size());
+}
+
+void bench_setops(size_t n) {
+  vector<int> mine_keys = shuffled_ints(n);
+  vector<int> theirs_keys = shuffled_ints(n, 281);
+  for (int &key : theirs_keys) {
+    key += static_cast<int>(n / 2);
+  }
+  Map<int, int> mine = map_of(mine_keys);
+  Map<int, int> theirs = map_of(theirs_keys);
+
+  bench_set_operation("map", "merge_insert_loop", mine, theirs,
+                      [](Map<int, int> &a, Map<int, int> &b) {
+                        for (const auto &entry : b) {
+                          a[entry.first] += entry.second;
+                        }
+                      });
+  for (unsigned threads : {1u, 2u, 4u, 8u}) {
+    string structure = "map_" + to_string(threads) + "_threads";
+    bench_set_operation(structure, "merge", mine, theirs,
+                        [=](Map<int, int> &a, Map<int, int> &b) {
+                          a.merge(std::move(b), threads);
+                        });
+    bench_set_operation(structure, "intersection", mine, theirs,
+                        [=](Map<int, int> &a, Map<int, int> &b) {
+                          a.intersection(std::move(b), threads);
+                        });
+    bench_set_operation(structure, "difference", mine, theirs,
+                        [=](Map<int, int> &a, Map<int, int> &b) {
+                          a.difference(std::move(b), threads);
+                        });
+  }
+
+  // a small batch of updates only touches a few paths of the large Map
+  vector<int> batch_keys(mine_keys.begin(), mine_keys.begin() + n / 1000);
+  Map<int, int> batch = map_of(batch_keys);
+  bench_set_operation("map", "merge_small_insert_loop", mine, batch,
+                      [](Map<int, int> &a, Map<int, int> &b) {
+                        for (const auto &entry : b) {
+                          a[entry.first] += entry.second;
+                        }
+                      });
+  bench_set_operation("map_1_threads", "merge_small", mine, batch,
+                      [](Map<int, int> &a, Map<int, int> &b) {
+                        a.merge(std::move(b), 1);
+                      });
+}
+
+int main() {
+  print_report_header();
+
+  for (size_t n : {10000, 1000000, 10000000}) {
+    bench_frozen(n);
+  }
+
+  for (size_t n : {10000, 1000000}) {
+    vector<int> keys = shuffled_ints(n);
+    vector<int> queries = shuffled_ints(n, 281);
+    bench_backend<AVLTreeBackend>("avl_tree", keys, queries);
+    bench_backend<BTreeBackend>("btree", keys, queries);
+    bench_backend<CompactTreeBackend, CountedCompactBackend>("compact_tree",
+                                                            keys, queries);
+  }
+
+  bench_concurrent(1000000);
+
+  for (size_t n : {10000, 1000000}) {
+    bench_flat("", shuffled_ints(n), shuffled_ints(n, 281));
+  }
+  vector<string> trace = read_word_trace("w14-f15_instructor_student.csv");
+  vector<string> vocabulary = trace;
+  sort(vocabulary.begin(), vocabulary.end());
+  vocabulary.erase(unique(vocabulary.begin(), vocabulary.end()),
+                   vocabulary.end());
+  shuffle(vocabulary.begin(), vocabulary.end(), mt19937_64(280));
+  bench_flat("_words", vocabulary, trace);
+
+  bench_mapped(1000000);
+
+  bench_unordered(trace);
+  bench_unordered(shuffled_words(1000000));
+
+  bench_setops(1000000);
+}
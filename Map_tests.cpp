@@ -1,4 +1,10 @@
 #include "Map.hpp"
+#include "BTree.hpp"
+#include "CompactSearchTree.hpp"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <stdexcept>
 #include "unit_test_framework.hpp"
 
 
@@ -7,4 +13,486 @@ TEST(test_stub) {
     ASSERT_TRUE(true);
 }
 
+Map<std::string, int> make_counts(int n) {
+    Map<std::string, int> counts;
+    for (int i = 0; i < n; ++i) {
+        counts["word" + std::to_string(i)] = i;
+    }
+    return counts;
+}
+
+TEST(move_steals_tree) {
+    Map<std::string, int> counts = make_counts(50);
+    ASSERT_EQUAL(counts.size(), 50);
+    auto first = counts.begin();
+
+    Map<std::string, int> moved(std::move(counts));
+    ASSERT_TRUE(counts.empty());
+    ASSERT_TRUE(moved.begin() == first);
+
+    counts = make_counts(3);
+    counts = std::move(moved);
+    ASSERT_EQUAL(counts.size(), 50);
+    ASSERT_TRUE(counts.begin() == first);
+    ASSERT_EQUAL(counts["word42"], 42);
+}
+
+TEST(emplace_try_emplace_and_rvalue_insert) {
+    Map<std::string, std::string> map;
+    std::string value(100, 'v');
+
+    auto result = map.try_emplace("key", std::move(value));
+    ASSERT_TRUE(result.second);
+    ASSERT_EQUAL(result.first->second, std::string(100, 'v'));
+
+    // try_emplace leaves its arguments alone when the key exists
+    std::string other(100, 'o');
+    ASSERT_FALSE(map.try_emplace("key", std::move(other)).second);
+    ASSERT_EQUAL(other, std::string(100, 'o'));
+
+    ASSERT_TRUE(map.emplace("a", "apple").second);
+    ASSERT_FALSE(map.emplace("a", "avocado").second);
+    ASSERT_EQUAL(map["a"], "apple");
+
+    std::pair<std::string, std::string> entry("b", "banana");
+    ASSERT_TRUE(map.insert(std::move(entry)).second);
+    ASSERT_EQUAL(map["b"], "banana");
+
+    std::string key(50, 'k');
+    map[std::move(key)] = "long";
+    ASSERT_EQUAL(map[std::string(50, 'k')], "long");
+    ASSERT_EQUAL(map.size(), 4);
+}
+
+TEST(from_sorted_restores_map) {
+    std::vector<std::pair<std::string, int>> dump;
+    for (int i = 0; i < 1000; ++i) {
+        dump.emplace_back("key" + std::to_string(1000 + i), i);
+    }
+    auto map = Map<std::string, int>::from_sorted(dump.begin(), dump.end());
+    ASSERT_EQUAL(map.size(), 1000);
+    ASSERT_EQUAL(map["key1500"], 500);
+    ASSERT_EQUAL(map.begin()->first, "key1000");
+
+    std::swap(dump[0], dump[1]);
+    bool threw = false;
+    try {
+        Map<std::string, int>::from_sorted(dump.begin(), dump.end());
+    }
+    catch (const std::invalid_argument &) {
+        threw = true;
+    }
+    ASSERT_TRUE(threw);
+}
+
+TEST(freeze_map) {
+    Map<std::string, int> counts = make_counts(500);
+    FrozenMap<std::string, int> frozen = counts.freeze();
+    counts["extra"] = 1;
+
+    ASSERT_EQUAL(frozen.size(), 500);
+    ASSERT_FALSE(frozen.empty());
+    ASSERT_EQUAL(frozen.find("word123")->second, 123);
+    ASSERT_TRUE(frozen.find("extra") == frozen.end());
+
+    auto map_it = counts.begin();
+    for (const auto &entry : frozen) {
+        if (map_it->first == "extra") {
+            ++map_it;
+        }
+        ASSERT_EQUAL(entry.first, map_it->first);
+        ASSERT_EQUAL(entry.second, map_it->second);
+        ++map_it;
+    }
+
+    FrozenMap<std::string, int> empty = Map<std::string, int>().freeze();
+    ASSERT_TRUE(empty.empty());
+    ASSERT_TRUE(empty.begin() == empty.end());
+    ASSERT_TRUE(empty.find("x") == empty.end());
+}
+
+TEST(at_checks_the_key) {
+    Map<std::string, int> counts = make_counts(10);
+    ASSERT_EQUAL(counts.at("word3"), 3);
+    counts.at("word3") = 30;
+    const Map<std::string, int> &view = counts;
+    ASSERT_EQUAL(view.at("word3"), 30);
+    bool threw = false;
+    try {
+        view.at("missing");
+    }
+    catch (const std::out_of_range &) {
+        threw = true;
+    }
+    ASSERT_TRUE(threw);
+    ASSERT_EQUAL(counts.size(), 10);
+}
+
+TEST(btree_backend) {
+    Map<std::string, int, std::less<std::string>, PoolNodeAllocator,
+        BTreeBackend> counts;
+    for (int i = 0; i < 1000; ++i) {
+        counts["word" + std::to_string(i)] += i;
+    }
+    counts["word7"] += 1;
+    ASSERT_EQUAL(counts.size(), 1000);
+    ASSERT_EQUAL(counts.find("word7")->second, 8);
+    ASSERT_TRUE(counts.find("missing") == counts.end());
+    ASSERT_FALSE(counts.insert({"word1", 5}).second);
+
+    Map<std::string, int> reference = make_counts(1000);
+    reference["word7"] += 1;
+    auto ref_it = reference.begin();
+    for (const auto &entry : counts) {
+        ASSERT_EQUAL(entry.first, ref_it->first);
+        ASSERT_EQUAL(entry.second, ref_it->second);
+        ++ref_it;
+    }
+    ASSERT_TRUE(ref_it == reference.end());
+}
+
+struct No_default {
+    explicit No_default(int value_in) : value(value_in) { }
+    int value;
+};
+
+TEST(btree_backend_without_default_values) {
+    Map<int, No_default, std::less<int>, PoolNodeAllocator,
+        BTreeBackend> map;
+    for (int i = 0; i < 200; ++i) {
+        ASSERT_TRUE(map.insert({i, No_default(i * i)}).second);
+    }
+    ASSERT_EQUAL(map.erase(10), 1);
+    ASSERT_EQUAL(map.size(), 199);
+    ASSERT_EQUAL(map.find(12)->second.value, 144);
+    ASSERT_TRUE(map.find(10) == map.end());
+}
+
+TEST(compact_backend) {
+    Map<std::string, int, std::less<std::string>, PoolNodeAllocator,
+        CompactTreeBackend> counts;
+    for (int i = 0; i < 1000; ++i) {
+        counts["word" + std::to_string(i)] += i;
+    }
+    counts["word7"] += 1;
+    ASSERT_EQUAL(counts.size(), 1000);
+    ASSERT_EQUAL(counts.find("word7")->second, 8);
+    ASSERT_TRUE(counts.find("missing") == counts.end());
+    ASSERT_FALSE(counts.insert({"word1", 5}).second);
+    ASSERT_EQUAL(counts.erase("word500"), 1);
+
+    Map<std::string, int> reference = make_counts(1000);
+    reference["word7"] += 1;
+    reference.erase("word500");
+    auto ref_it = reference.begin();
+    for (const auto &entry : counts) {
+        ASSERT_EQUAL(entry.first, ref_it->first);
+        ASSERT_EQUAL(entry.second, ref_it->second);
+        ++ref_it;
+    }
+    ASSERT_TRUE(ref_it == reference.end());
+}
+
+// A mapped value that counts how many times one is constructed
+struct Tracked_value {
+    static int constructions;
+    int value = 0;
+
+    Tracked_value() {
+        ++constructions;
+    }
+
+    Tracked_value(const Tracked_value &other) : value(other.value) {
+        ++constructions;
+    }
+
+    Tracked_value &operator=(const Tracked_value &) = default;
+};
+
+int Tracked_value::constructions = 0;
+
+TEST(lookups_do_not_build_pairs) {
+    Map<std::string, Tracked_value> map;
+    map["present"].value = 7;
+
+    Tracked_value::constructions = 0;
+    const std::string present("present");
+    const std::string absent("absent");
+    ASSERT_EQUAL(map.find(present)->second.value, 7);
+    ASSERT_TRUE(map.find(absent) == map.end());
+    ASSERT_EQUAL(map.count(present), 1);
+    ASSERT_EQUAL(map.count(absent), 0);
+    ASSERT_TRUE(map.contains(present));
+    ASSERT_FALSE(map.contains(absent));
+    ASSERT_EQUAL(map[present].value, 7);
+    ASSERT_EQUAL(Tracked_value::constructions, 0);
+}
+
+TEST(transparent_lookup_with_string_view) {
+    Map<std::string, Tracked_value, std::less<>> map;
+    map["alpha"].value = 1;
+    map[std::string_view("beta")].value = 2;
+    ASSERT_EQUAL(map.size(), 2);
+
+    Tracked_value::constructions = 0;
+    std::string_view alpha("alpha");
+    ASSERT_EQUAL(map.find(alpha)->second.value, 1);
+    ASSERT_EQUAL(map.find(std::string_view("beta"))->second.value, 2);
+    ASSERT_TRUE(map.find(std::string_view("gamma")) == map.end());
+    ASSERT_EQUAL(map.count(alpha), 1);
+    ASSERT_TRUE(map.contains(std::string_view("beta")));
+    ASSERT_FALSE(map.contains("gamma"));
+    ASSERT_EQUAL(map[alpha].value, 1);
+    ASSERT_EQUAL(Tracked_value::constructions, 0);
+
+    // a missing key is converted to std::string only when inserted
+    map[std::string_view("gamma")].value = 3;
+    ASSERT_EQUAL(Tracked_value::constructions, 1);
+    ASSERT_EQUAL(map.find(std::string("gamma"))->second.value, 3);
+}
+
+TEST(prefix_scan_with_range) {
+    Map<std::string, int> counts;
+    for (const char *word : {"program", "proj", "project", "projector",
+                             "projects", "prok", "zebra", "apple"}) {
+        counts[word] = 1;
+    }
+    std::vector<std::string> prefixed;
+    for (const auto &entry : counts.range("proj", "prok")) {
+        prefixed.push_back(entry.first);
+    }
+    ASSERT_TRUE(prefixed == std::vector<std::string>(
+                    {"proj", "project", "projector", "projects"}));
+
+    ASSERT_EQUAL(counts.lower_bound("proja")->first, "project");
+    ASSERT_EQUAL(counts.upper_bound("proj")->first, "project");
+    ASSERT_TRUE(counts.upper_bound("zebra") == counts.end());
+    auto equal = counts.equal_range("zebra");
+    ASSERT_EQUAL(equal.first->first, "zebra");
+    ASSERT_TRUE(equal.second == counts.end());
+    equal = counts.equal_range("b");
+    ASSERT_TRUE(equal.first == equal.second);
+    ASSERT_TRUE(counts.range("q", "r").empty());
+}
+
+TEST(bounds_with_btree_backend_and_transparent_keys) {
+    Map<std::string, int, std::less<>, PoolNodeAllocator, BTreeBackend> map;
+    for (int i = 0; i < 200; ++i) {
+        map["k" + std::to_string(1000 + i)] = i;
+    }
+    std::string_view lo("k1100");
+    std::string_view hi("k1110");
+    int expected = 100;
+    for (const auto &entry : map.range(lo, hi)) {
+        ASSERT_EQUAL(entry.second, expected++);
+    }
+    ASSERT_EQUAL(expected, 110);
+    ASSERT_EQUAL(map.lower_bound(std::string_view("k1198a"))->second, 199);
+    ASSERT_TRUE(map.upper_bound(std::string_view("k1199")) == map.end());
+}
+
+TEST(erase_and_clear) {
+    Map<std::string, int> counts = make_counts(100);
+    ASSERT_EQUAL(counts.erase("word5"), 1);
+    ASSERT_EQUAL(counts.erase("word5"), 0);
+    ASSERT_FALSE(counts.contains("word5"));
+
+    auto next = counts.erase(counts.find("word50"));
+    ASSERT_EQUAL(next->first, "word51");
+    next = counts.erase(counts.find("word60"), counts.find("word70"));
+    ASSERT_EQUAL(next->first, "word70");
+    // word60 through word69, and word7, which sorts between them
+    ASSERT_EQUAL(counts.size(), 87);
+    ASSERT_FALSE(counts.contains("word7"));
+    ASSERT_EQUAL(counts["word99"], 99);
+
+    counts.clear();
+    ASSERT_TRUE(counts.empty());
+    ASSERT_TRUE(counts.begin() == counts.end());
+    counts["again"] = 1;
+    ASSERT_EQUAL(counts.size(), 1);
+
+    Map<std::string, int, std::less<>, PoolNodeAllocator, BTreeBackend> btree;
+    for (int i = 0; i < 300; ++i) {
+        btree["word" + std::to_string(i)] = i;
+    }
+    ASSERT_EQUAL(btree.erase(std::string_view("word7")), 1);
+    auto btree_next = btree.erase(btree.find("word100"), btree.find("word200"));
+    ASSERT_EQUAL(btree_next->first, "word200");
+    ASSERT_EQUAL(btree.size(), 299 - 111);
+    btree.clear();
+    ASSERT_TRUE(btree.empty());
+}
+
+TEST(hinted_insert) {
+    Map<std::string, int> map;
+    Map<std::string, int, std::less<std::string>, PoolNodeAllocator,
+        BTreeBackend> btree_map;
+    for (int i = 0; i < 500; ++i) {
+        std::string key = "k" + std::to_string(1000 + i);
+        auto it = map.insert(map.end(), {key, i});
+        ASSERT_EQUAL(it->second, i);
+        btree_map.insert(btree_map.end(), {key, i});
+    }
+    ASSERT_EQUAL(map.size(), 500);
+    ASSERT_EQUAL(btree_map.size(), 500);
+
+    // an existing key keeps its value
+    auto it = map.insert(map.begin(), {"k1200", -1});
+    ASSERT_EQUAL(it->second, 200);
+    it = map.emplace_hint(map.find("k1201"), "k1200a", 7);
+    ASSERT_EQUAL(it->first, "k1200a");
+    ASSERT_EQUAL((++it)->first, "k1201");
+    auto btree_it = btree_map.emplace_hint(btree_map.end(), "k1200a", 7);
+    ASSERT_EQUAL(btree_it->second, 7);
+    ASSERT_EQUAL(map.size(), 501);
+    ASSERT_EQUAL(btree_map.size(), 501);
+}
+
+// Counts every key comparison made by the maps that use it
+struct Counting_less {
+    static int comparisons;
+
+    bool operator()(int lhs, int rhs) const {
+        ++comparisons;
+        return lhs < rhs;
+    }
+};
+
+int Counting_less::comparisons = 0;
+
+// Returns the number of comparisons made by fn()
+template <typename Fn>
+int comparisons_made(Fn fn) {
+    Counting_less::comparisons = 0;
+    fn();
+    return Counting_less::comparisons;
+}
+
+TEST(inserts_search_the_tree_once) {
+    Map<int, int, Counting_less> map;
+    for (int i = 0; i < 1000; ++i) {
+        map[(i * 7919) % 1000 * 2] = i;
+    }
+    for (int key : {0, 998, 1000, 1998}) {
+        // a hit costs exactly what find costs
+        int hit = comparisons_made([&] { map.find(key); });
+        ASSERT_EQUAL(comparisons_made([&] { map[key]; }), hit);
+        ASSERT_EQUAL(comparisons_made([&] { map.insert({key, 0}); }), hit);
+        ASSERT_EQUAL(comparisons_made([&] { map.try_emplace(key, 0); }), hit);
+        ASSERT_EQUAL(comparisons_made([&] { map.insert_or_assign(key, 5); }),
+                     hit);
+        ASSERT_EQUAL(map[key], 5);
+
+        // a miss costs what the failed find costs, then links the leaf
+        // without comparing again. Erasing the new key reshapes the tree,
+        // so the cost of the miss is measured again before each insert.
+        int missing = key + 1;
+        auto miss = [&] { return comparisons_made([&] { map.find(missing); }); };
+        int expected = miss();
+        ASSERT_EQUAL(comparisons_made([&] { map[missing]; }), expected);
+        map.erase(missing);
+        expected = miss();
+        ASSERT_EQUAL(comparisons_made([&] { map.insert({missing, 1}); }),
+                     expected);
+        map.erase(missing);
+        expected = miss();
+        ASSERT_EQUAL(comparisons_made([&] { map.try_emplace(missing, 1); }),
+                     expected);
+        map.erase(missing);
+        expected = miss();
+        ASSERT_EQUAL(comparisons_made([&] {
+            map.insert_or_assign(missing, 1);
+        }), expected);
+        ASSERT_EQUAL(map[missing], 1);
+        map.erase(missing);
+    }
+    ASSERT_EQUAL(map.size(), 1000);
+}
+
+TEST(insert_or_assign) {
+    Map<std::string, std::string> map;
+    auto result = map.insert_or_assign("a", "one");
+    ASSERT_TRUE(result.second);
+    ASSERT_EQUAL(result.first->second, "one");
+    std::string key("a");
+    std::string value("uno");
+    result = map.insert_or_assign(key, std::move(value));
+    ASSERT_FALSE(result.second);
+    ASSERT_EQUAL(map["a"], "uno");
+    ASSERT_EQUAL(map.size(), 1);
+
+    Map<std::string, int, std::less<std::string>, PoolNodeAllocator,
+        BTreeBackend> btree_map;
+    ASSERT_TRUE(btree_map.insert_or_assign("b", 1).second);
+    ASSERT_FALSE(btree_map.insert_or_assign("b", 2).second);
+    ASSERT_EQUAL(btree_map["b"], 2);
+}
+
+TEST(merge_adds_values_of_shared_keys) {
+    Map<std::string, int> counts = make_counts(3000);
+    Map<std::string, int> more;
+    for (int i = 2000; i < 5000; ++i) {
+        more["word" + std::to_string(i)] = 1;
+    }
+    counts.merge(std::move(more), 4);
+    ASSERT_TRUE(more.empty());
+    ASSERT_EQUAL(counts.size(), 5000);
+    for (int i = 0; i < 5000; ++i) {
+        int expected = (i < 3000 ? i : 0) + (i >= 2000 ? 1 : 0);
+        ASSERT_EQUAL(counts["word" + std::to_string(i)], expected);
+    }
+    ASSERT_EQUAL(counts.size(), 5000);
+
+    // the moved-from Map can be filled again
+    more["x"] = 1;
+    ASSERT_EQUAL(more.size(), 1);
+}
+
+TEST(union_intersection_and_difference) {
+    Map<int, std::string> letters;
+    Map<int, std::string> names;
+    for (int i = 0; i < 1000; ++i) {
+        letters[i] = std::string(1, static_cast<char>('a' + i % 26));
+        names[i + 500] = "n" + std::to_string(i + 500);
+    }
+
+    Map<int, std::string> joined = letters;
+    Map<int, std::string> joined_names = names;
+    joined.union_with(std::move(joined_names),
+                      [](std::string &&mine, std::string &&theirs) {
+                          return mine + theirs;
+                      });
+    ASSERT_EQUAL(joined.size(), 1500);
+    ASSERT_EQUAL(joined[0], "a");
+    ASSERT_EQUAL(joined[500], "gn500");
+    ASSERT_EQUAL(joined[1499], "n1499");
+
+    Map<int, std::string> common = letters;
+    Map<int, std::string> common_names = names;
+    common.intersection(std::move(common_names));
+    ASSERT_EQUAL(common.size(), 500);
+    ASSERT_EQUAL(common.begin()->first, 500);
+    ASSERT_EQUAL(common[999], letters[999]);
+
+    letters.difference(std::move(names), 1);
+    ASSERT_TRUE(names.empty());
+    ASSERT_EQUAL(letters.size(), 500);
+    ASSERT_TRUE(letters.find(500) == letters.end());
+    ASSERT_EQUAL(letters[499], "f");
+}
+
+TEST(memory_usage_estimates_keys_and_values) {
+    Map<std::string, std::vector<int>> map;
+    ASSERT_EQUAL(map.memory_usage().total_bytes(), 0);
+    map["a"] = std::vector<int>(10);
+    map[std::string(50, 'k')] = std::vector<int>();
+    MemoryUsage usage = map.memory_usage();
+    ASSERT_EQUAL(usage.node_count, 2);
+    ASSERT_TRUE(usage.element_heap_bytes >= 51 + 10 * sizeof(int));
+    ASSERT_EQUAL(usage.max_depth, 2);
+    ASSERT_TRUE(usage.total_bytes() >=
+                usage.node_bytes + usage.element_heap_bytes);
+}
+
 TEST_MAIN()
@@ -0,0 +1,592 @@
+#ifndef MAPPED_TREE_HPP
+#define MAPPED_TREE_HPP
+/* MappedTree.hpp
+ *
+ * Saves a BinarySearchTree or a Map to a binary file, and serves find()
+ * and in-order iteration straight from a read-only memory mapping of that
+ * file, without rebuilding any nodes:
+ *
+ *   Map<std::string, int> counts = ...;
+ *   save_mapped(counts, "counts.bin");
+ *   ...
+ *   MappedMap<std::string, int> loaded("counts.bin");  // O(1): one mmap
+ *   auto it = loaded.find("word");                      // O(log n)
+ *   if (it != loaded.end()) { int count = it->second; }
+ *
+ * Keys, values and tree elements must be trivially copyable, and are then
+ * stored as raw bytes, or std::string, stored as an offset and length
+ * into a string pool and read back as std::string_view. The file holds:
+ *
+ *   header   64 bytes: magic, version, field layout, number of records
+ *            and the offsets of the two sections below
+ *   records  one fixed-width record per element, in ascending order
+ *   pool     the characters of every string field, back to back
+ *
+ * Lookups binary search the records, comparing keys (the first member of
+ * a pair, the whole element otherwise) with std::less<>, so only the
+ * pages they touch are read from disk. The writer checks that the
+ * container is ordered the way std::less<> orders its keys, as it is with
+ * the default Compare.
+ *
+ * Numbers are stored in the byte order of the machine that wrote the
+ * file, so files do not move between machines of different byte orders.
+ * Mapping uses POSIX mmap().
+ */
+
+#include <cstddef>     //size_t
+#include <cstdint>     //uint32_t, uint64_t
+#include <cstring>     //memcpy, memcmp
+#include <fstream>     //ofstream
+#include <functional>  //less
+#include <iterator>    //bidirectional_iterator_tag
+#include <stdexcept>   //runtime_error, invalid_argument
+#include <string>
+#include <string_view>
+#include <type_traits> //decay, is_trivially_copyable, is_integral
+#include <utility>     //pair, swap
+#include <vector>
+#include <fcntl.h>     //open
+#include <sys/mman.h>  //mmap, munmap
+#include <sys/stat.h>  //fstat
+#include <unistd.h>    //close
+
+// The kind of a field, kept in the top byte of its tag so that fields of
+// equal size but different types, such as int and float, do not match.
+enum MappedKind : uint32_t {
+  mapped_other = 0,    // any other trivially copyable type
+  mapped_string = 1,
+  mapped_signed = 2,   // signed integral types
+  mapped_unsigned = 3, // unsigned integral types, including bool
+  mapped_floating = 4
+};
+
+// EFFECTS: Returns the kind of a trivially copyable field of type T.
+template <typename T>
+constexpr MappedKind mapped_kind() {
+  return std::is_floating_point<T>::value ? mapped_floating
+       : !std::is_integral<T>::value ? mapped_other
+       : std::is_signed<T>::value ? mapped_signed
+       : mapped_unsigned;
+}
+
+// Describes how a field of type T is stored in a record: trivially
+// copyable types as their raw bytes.
+template <typename T>
+struct MappedField {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "MappedField: fields must be trivially copyable or "
+                "std::string");
+
+  // What a field reads back as
+  using View = T;
+
+  // Bytes the field takes in a record
+  static constexpr size_t size = sizeof(T);
+
+  // Identifies the layout in the header: kind in the top byte, size below
+  static constexpr uint32_t tag = (uint32_t(mapped_kind<T>()) << 24) |
+                                  sizeof(T);
+
+  // EFFECTS: Stores value in the record at 'record'. 'pool_size' is the
+  //          size of the string pool so far.
+  static void write(char *record, const T &value, uint64_t &) {
+    std::memcpy(record, &value, sizeof(T));
+  }
+
+  // EFFECTS: Appends what value keeps in the string pool to 'out'.
+  static void write_pool(std::ostream &, const T &) { }
+
+  static View read(const char *record, const char *, uint64_t) {
+    T value;
+    std::memcpy(&value, record, sizeof(T));
+    return value;
+  }
+};
+
+// Strings are stored as a 64-bit offset into the pool and a 64-bit length.
+template <>
+struct MappedField<std::string> {
+  using View = std::string_view;
+
+  static constexpr size_t size = 2 * sizeof(uint64_t);
+
+  static constexpr uint32_t tag = (uint32_t(mapped_string) << 24) | size;
+
+  static void write(char *record, const std::string &value,
+                    uint64_t &pool_size) {
+    uint64_t span[2] = {pool_size, value.size()};
+    std::memcpy(record, span, sizeof(span));
+    pool_size += value.size();
+  }
+
+  static void write_pool(std::ostream &out, const std::string &value) {
+    out.write(value.data(), static_cast<std::streamsize>(value.size()));
+  }
+
+  // EFFECTS: Returns a view of the string in 'pool'. Throws
+  //          std::runtime_error if the record points outside the pool.
+  static View read(const char *record, const char *pool,
+                   uint64_t pool_size) {
+    uint64_t span[2];
+    std::memcpy(span, record, sizeof(span));
+    if (span[0] > pool_size || span[1] > pool_size - span[0]) {
+      throw std::runtime_error("MappedTree: string outside the pool");
+    }
+    return View(pool + span[0], static_cast<size_t>(span[1]));
+  }
+};
+
+// Lays out a tree element as a record of one field, which is also its key.
+template <typename T>
+struct ElementCodec {
+  using Field = MappedField<T>;
+  using View = typename Field::View;
+  using Key_view = View;
+
+  static constexpr size_t record_size = Field::size;
+  static constexpr uint32_t first_tag = Field::tag;
+  static constexpr uint32_t second_tag = 0;
+
+  static const T &key(const T &elt) {
+    return elt;
+  }
+
+  static void write(char *record, const T &elt, uint64_t &pool_size) {
+    Field::write(record, elt, pool_size);
+  }
+
+  static void write_pool(std::ostream &out, const T &elt) {
+    Field::write_pool(out, elt);
+  }
+
+  static View read(const char *record, const char *pool,
+                   uint64_t pool_size) {
+    return Field::read(record, pool, pool_size);
+  }
+
+  static Key_view read_key(const char *record, const char *pool,
+                           uint64_t pool_size) {
+    return Field::read(record, pool, pool_size);
+  }
+};
+
+// Lays out a key-value pair as a record of two fields, keyed by the first.
+template <typename Key, typename Value>
+struct PairCodec {
+  using Key_field = MappedField<Key>;
+  using Value_field = MappedField<Value>;
+  using View = std::pair<typename Key_field::View,
+                         typename Value_field::View>;
+  using Key_view = typename Key_field::View;
+
+  static constexpr size_t record_size = Key_field::size + Value_field::size;
+  static constexpr uint32_t first_tag = Key_field::tag;
+  static constexpr uint32_t second_tag = Value_field::tag;
+
+  static const Key &key(const std::pair<Key, Value> &elt) {
+    return elt.first;
+  }
+
+  static void write(char *record, const std::pair<Key, Value> &elt,
+                    uint64_t &pool_size) {
+    Key_field::write(record, elt.first, pool_size);
+    Value_field::write(record + Key_field::size, elt.second, pool_size);
+  }
+
+  static void write_pool(std::ostream &out,
+                         const std::pair<Key, Value> &elt) {
+    Key_field::write_pool(out, elt.first);
+    Value_field::write_pool(out, elt.second);
+  }
+
+  static View read(const char *record, const char *pool,
+                   uint64_t pool_size) {
+    return View(Key_field::read(record, pool, pool_size),
+                Value_field::read(record + Key_field::size, pool,
+                                  pool_size));
+  }
+
+  static Key_view read_key(const char *record, const char *pool,
+                           uint64_t pool_size) {
+    return Key_field::read(record, pool, pool_size);
+  }
+};
+
+// Picks the codec for a container's element type: PairCodec for the
+// pairs of a Map, ElementCodec otherwise.
+template <typename T>
+struct CodecFor {
+  using type = ElementCodec<T>;
+};
+
+template <typename Key, typename Value>
+struct CodecFor<std::pair<Key, Value>> {
+  using type = PairCodec<Key, Value>;
+};
+
+// The first 64 bytes of a file written by save_mapped()
+struct MappedHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t record_size;
+  uint32_t first_tag;
+  uint32_t second_tag;
+  uint64_t count;
+  uint64_t records_offset;
+  uint64_t pool_offset;
+  uint64_t pool_size;
+  uint64_t reserved;
+};
+
+static_assert(sizeof(MappedHeader) == 64, "MappedHeader must be 64 bytes");
+
+// Marks a complete file. It is written last, so a file whose writer
+// failed part way is never loaded.
+constexpr char mapped_magic[8] = {'p', '5', 't', 'r', 'e', 'e', '\0', '\0'};
+
+// Version 2 added the kind of each field to its tag.
+constexpr uint32_t mapped_version = 2;
+
+// REQUIRES: container is a BinarySearchTree, a Map or another container
+//           whose iterators yield its elements in ascending order
+// EFFECTS : Writes the elements of container to the file at 'path' in the
+//           format described above, replacing the file if it exists.
+//           Throws std::invalid_argument if the keys are not strictly
+//           ascending according to std::less<>, and std::runtime_error if
+//           the file cannot be written.
+template <typename Container>
+void save_mapped(const Container &container, const std::string &path) {
+  using Element = typename std::decay<decltype(*container.begin())>::type;
+  using Codec = typename CodecFor<Element>::type;
+
+  std::less<> less;
+  auto prev = container.begin();
+  for (auto it = container.begin(); it != container.end(); prev = it++) {
+    if (it != container.begin() &&
+        !less(Codec::key(*prev), Codec::key(*it))) {
+      throw std::invalid_argument("save_mapped: keys are not in "
+                                  "std::less<> order");
+    }
+  }
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    throw std::runtime_error("save_mapped: cannot open " + path);
+  }
+  MappedHeader header = MappedHeader();
+  header.version = mapped_version;
+  header.record_size = static_cast<uint32_t>(Codec::record_size);
+  header.first_tag = Codec::first_tag;
+  header.second_tag = Codec::second_tag;
+  header.count = container.size();
+  header.records_offset = sizeof(MappedHeader);
+  header.pool_offset = header.records_offset +
+                       header.count * header.record_size;
+  // a blank header until the rest is written
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+  std::vector<char> record(Codec::record_size);
+  for (const Element &elt : container) {
+    Codec::write(record.data(), elt, header.pool_size);
+    out.write(record.data(), static_cast<std::streamsize>(record.size()));
+  }
+  for (const Element &elt : container) {
+    Codec::write_pool(out, elt);
+  }
+
+  std::memcpy(header.magic, mapped_magic, sizeof(mapped_magic));
+  out.seekp(0);
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.close();
+  if (!out) {
+    throw std::runtime_error("save_mapped: cannot write " + path);
+  }
+}
+
+template <typename Codec>
+class MappedRecords {
+  // OVERVIEW: The elements of a file written by save_mapped(), read in
+  //           place from a read-only memory mapping of it. Move-only; the
+  //           mapping lasts until this object is destroyed, and views of
+  //           strings point into it.
+public:
+  // What an element reads back as: a std::pair of field views for a Map,
+  // a single field view for a BinarySearchTree
+  using View = typename Codec::View;
+
+  // What find() looks up: the view of a key
+  using Key_view = typename Codec::Key_view;
+
+  class Iterator {
+    // OVERVIEW: Iterates over the elements in ascending order, yielding
+    //           each one as a View by value.
+  public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = View;
+    using difference_type = std::ptrdiff_t;
+    using reference = View;
+
+    // Makes it->first and it->second work on the View yielded by value
+    class Arrow_proxy {
+    public:
+      const View *operator->() const {
+        return &view;
+      }
+
+    private:
+      friend class Iterator;
+
+      explicit Arrow_proxy(const View &view_in)
+        : view(view_in) { }
+
+      View view;
+    };
+
+    using pointer = Arrow_proxy;
+
+    Iterator()
+      : owner(nullptr), index(0) { }
+
+    View operator*() const {
+      return owner->read(index);
+    }
+
+    Arrow_proxy operator->() const {
+      return Arrow_proxy(**this);
+    }
+
+    // Prefix ++
+    Iterator &operator++() {
+      ++index;
+      return *this;
+    }
+
+    // Postfix ++
+    Iterator operator++(int) {
+      Iterator result(*this);
+      ++(*this);
+      return result;
+    }
+
+    // Prefix --
+    Iterator &operator--() {
+      --index;
+      return *this;
+    }
+
+    // Postfix --
+    Iterator operator--(int) {
+      Iterator result(*this);
+      --(*this);
+      return result;
+    }
+
+    bool operator==(const Iterator &rhs) const {
+      return owner == rhs.owner && index == rhs.index;
+    }
+
+    bool operator!=(const Iterator &rhs) const {
+      return !(*this == rhs);
+    }
+
+  private:
+    friend class MappedRecords;
+
+    Iterator(const MappedRecords *owner_in, size_t index_in)
+      : owner(owner_in), index(index_in) { }
+
+    const MappedRecords *owner;
+    size_t index;
+  };
+
+  // EFFECTS : Maps the file at 'path' and checks its header. Reads no
+  //           records, so it takes the same time for any file size.
+  //           Throws std::runtime_error if the file cannot be opened or
+  //           mapped, is not a complete file written by save_mapped(),
+  //           or was written for other key or value types.
+  explicit MappedRecords(const std::string &path)
+    : base(nullptr), length(0), records(nullptr), pool(nullptr),
+      pool_size(0), record_count(0) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("MappedTree: cannot open " + path);
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0 ||
+        static_cast<uint64_t>(info.st_size) < sizeof(MappedHeader)) {
+      ::close(fd);
+      throw std::runtime_error("MappedTree: " + path + " is too short");
+    }
+    length = static_cast<size_t>(info.st_size);
+    void *mapped = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+      throw std::runtime_error("MappedTree: cannot map " + path);
+    }
+    base = mapped;
+    try {
+      check_header(path);
+    }
+    catch (...) {
+      ::munmap(base, length);
+      throw;
+    }
+  }
+
+  MappedRecords(MappedRecords &&other) noexcept
+    : base(other.base), length(other.length), records(other.records),
+      pool(other.pool), pool_size(other.pool_size),
+      record_count(other.record_count) {
+    other.base = nullptr;
+    other.record_count = 0;
+  }
+
+  MappedRecords &operator=(MappedRecords &&rhs) noexcept {
+    std::swap(base, rhs.base);
+    std::swap(length, rhs.length);
+    std::swap(records, rhs.records);
+    std::swap(pool, rhs.pool);
+    std::swap(pool_size, rhs.pool_size);
+    std::swap(record_count, rhs.record_count);
+    return *this;
+  }
+
+  MappedRecords(const MappedRecords &) = delete;
+  MappedRecords &operator=(const MappedRecords &) = delete;
+
+  ~MappedRecords() {
+    if (base != nullptr) {
+      ::munmap(base, length);
+    }
+  }
+
+  // EFFECTS : Returns whether there are no elements.
+  bool empty() const {
+    return record_count == 0;
+  }
+
+  // EFFECTS : Returns the number of elements.
+  size_t size() const {
+    return record_count;
+  }
+
+  // EFFECTS : Returns an iterator to the element with key k, or end() if
+  //           there is none, by binary search over the records.
+  Iterator find(const Key_view &k) const {
+    std::less<> less;
+    size_t first = 0;
+    size_t n = record_count;
+    while (n > 0) {
+      size_t half = n / 2;
+      if (less(read_key(first + half), k)) {
+        first += half + 1;
+        n -= half + 1;
+      }
+      else {
+        n = half;
+      }
+    }
+    if (first == record_count || less(k, read_key(first))) {
+      return end();
+    }
+    return Iterator(this, first);
+  }
+
+  // EFFECTS : Returns the number of elements with key k (0 or 1).
+  size_t count(const Key_view &k) const {
+    return contains(k);
+  }
+
+  // EFFECTS : Returns whether there is an element with key k.
+  bool contains(const Key_view &k) const {
+    return find(k) != end();
+  }
+
+  // EFFECTS : Returns whether the keys are strictly ascending, reading
+  //           every record. A file written by save_mapped() always is.
+  bool check_sorting_invariant() const {
+    std::less<> less;
+    for (size_t i = 1; i < record_count; ++i) {
+      if (!less(read_key(i - 1), read_key(i))) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // EFFECTS : Returns an iterator to the first element.
+  Iterator begin() const {
+    return Iterator(this, 0);
+  }
+
+  // EFFECTS : Returns an iterator to "past-the-end".
+  Iterator end() const {
+    return Iterator(this, record_count);
+  }
+
+private:
+  void *base;
+  size_t length;
+  const char *records;
+  const char *pool;
+  uint64_t pool_size;
+  size_t record_count;
+
+  View read(size_t index) const {
+    return Codec::read(records + index * Codec::record_size, pool,
+                       pool_size);
+  }
+
+  Key_view read_key(size_t index) const {
+    return Codec::read_key(records + index * Codec::record_size, pool,
+                           pool_size);
+  }
+
+  // EFFECTS : Checks that the mapped header describes a complete file
+  //           with this Codec's layout whose sections fit in the file,
+  //           and locates the sections. Throws std::runtime_error if not.
+  void check_header(const std::string &path) {
+    MappedHeader header;
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, mapped_magic, sizeof(mapped_magic)) != 0 ||
+        header.version != mapped_version) {
+      throw std::runtime_error("MappedTree: " + path +
+                               " was not written by save_mapped()");
+    }
+    if (header.record_size != Codec::record_size ||
+        header.first_tag != Codec::first_tag ||
+        header.second_tag != Codec::second_tag) {
+      throw std::runtime_error("MappedTree: " + path +
+                               " holds other key or value types");
+    }
+    // compare before adding, so that no sum can wrap around
+    if (header.records_offset < sizeof(MappedHeader) ||
+        header.records_offset > length ||
+        header.count > (length - header.records_offset) /
+                       header.record_size) {
+      throw std::runtime_error("MappedTree: " + path + " is truncated");
+    }
+    uint64_t records_end = header.records_offset +
+                           header.count * header.record_size;
+    if (records_end > header.pool_offset ||
+        header.pool_offset > length ||
+        header.pool_size > length - header.pool_offset) {
+      throw std::runtime_error("MappedTree: " + path + " is truncated");
+    }
+    const char *bytes = static_cast<const char *>(base);
+    records = bytes + header.records_offset;
+    pool = bytes + header.pool_offset;
+    pool_size = header.pool_size;
+    record_count = static_cast<size_t>(header.count);
+  }
+};
+
+// A Map<Key, Value> loaded from a file written by save_mapped()
+template <typename Key, typename Value>
+using MappedMap = MappedRecords<PairCodec<Key, Value>>;
+
+// A BinarySearchTree<T> loaded from a file written by save_mapped()
+template <typename T>
+using MappedSearchTree = MappedRecords<typename CodecFor<T>::type>;
+
+#endif // MAPPED_TREE_HPP
@@ -0,0 +1,198 @@
+#include "MappedTree.hpp"
+#include "BinarySearchTree.hpp"
+#include "Map.hpp"
+#include "unit_test_framework.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// A file in the working directory that is removed when the test ends
+class Scratch_file {
+public:
+  explicit Scratch_file(const std::string &name)
+    : path("MappedTree_tests_" + name + ".bin") { }
+
+  ~Scratch_file() {
+    std::remove(path.c_str());
+  }
+
+  const std::string path;
+};
+
+// EFFECTS: Returns whether constructing a Loaded from 'path' throws
+//          std::runtime_error.
+template <typename Loaded>
+bool load_fails(const std::string &path) {
+  try {
+    Loaded loaded(path);
+  }
+  catch (const std::runtime_error &) {
+    return true;
+  }
+  return false;
+}
+
+TEST(string_map_round_trip) {
+  Scratch_file file("strings");
+  Map<std::string, int> counts;
+  for (int i = 0; i < 1000; ++i) {
+    counts["word" + std::to_string(i)] = i;
+  }
+  save_mapped(counts, file.path);
+
+  MappedMap<std::string, int> loaded(file.path);
+  ASSERT_EQUAL(loaded.size(), 1000);
+  ASSERT_FALSE(loaded.empty());
+  ASSERT_TRUE(loaded.check_sorting_invariant());
+  for (int i = 0; i < 1000; ++i) {
+    std::string key = "word" + std::to_string(i);
+    auto it = loaded.find(key);
+    ASSERT_TRUE(it != loaded.end());
+    ASSERT_EQUAL(it->first, key);
+    ASSERT_EQUAL(it->second, i);
+  }
+  ASSERT_TRUE(loaded.find("word") == loaded.end());
+  ASSERT_TRUE(loaded.find("word9999") == loaded.end());
+  ASSERT_TRUE(loaded.contains("word17"));
+  ASSERT_EQUAL(loaded.count("zebra"), 0);
+
+  // iteration yields the elements in the Map's order
+  auto original = counts.begin();
+  for (const auto &entry : loaded) {
+    ASSERT_EQUAL(entry.first, original->first);
+    ASSERT_EQUAL(entry.second, original->second);
+    ++original;
+  }
+  ASSERT_TRUE(original == counts.end());
+}
+
+TEST(string_values_and_tree_elements) {
+  Scratch_file map_file("values");
+  Map<int, std::string> names;
+  names[3] = "three";
+  names[1] = "";
+  names[2] = std::string("t\0o", 3);
+  save_mapped(names, map_file.path);
+  MappedMap<int, std::string> loaded_names(map_file.path);
+  ASSERT_EQUAL(loaded_names.find(3)->second, "three");
+  ASSERT_EQUAL(loaded_names.find(1)->second, "");
+  ASSERT_EQUAL(loaded_names.find(2)->second.size(), 3);
+  auto last = loaded_names.end();
+  --last;
+  ASSERT_EQUAL(last->first, 3);
+
+  Scratch_file tree_file("tree");
+  BinarySearchTree<double> tree;
+  for (int i = 0; i < 100; ++i) {
+    tree.insert((i * 37) % 100 / 4.0);
+  }
+  save_mapped(tree, tree_file.path);
+  MappedSearchTree<double> loaded_tree(tree_file.path);
+  ASSERT_EQUAL(loaded_tree.size(), 100);
+  ASSERT_EQUAL(*loaded_tree.find(2.25), 2.25);
+  ASSERT_TRUE(loaded_tree.find(2.3) == loaded_tree.end());
+  std::vector<double> seen(loaded_tree.begin(), loaded_tree.end());
+  ASSERT_TRUE(std::vector<double>(tree.begin(), tree.end()) == seen);
+
+  Scratch_file words_file("words");
+  BinarySearchTree<std::string> words;
+  words.insert("b");
+  words.insert("a");
+  save_mapped(words, words_file.path);
+  MappedSearchTree<std::string> loaded_words(words_file.path);
+  ASSERT_EQUAL(*loaded_words.begin(), "a");
+  ASSERT_TRUE(loaded_words.contains("b"));
+}
+
+TEST(empty_container) {
+  Scratch_file file("empty");
+  save_mapped(Map<std::string, int>(), file.path);
+  MappedMap<std::string, int> loaded(file.path);
+  ASSERT_TRUE(loaded.empty());
+  ASSERT_TRUE(loaded.begin() == loaded.end());
+  ASSERT_TRUE(loaded.find("a") == loaded.end());
+}
+
+TEST(move_keeps_the_mapping) {
+  Scratch_file file("move");
+  Map<int, int> squares;
+  for (int i = 0; i < 10; ++i) {
+    squares[i] = i * i;
+  }
+  save_mapped(squares, file.path);
+  MappedMap<int, int> loaded(file.path);
+  MappedMap<int, int> moved(std::move(loaded));
+  ASSERT_TRUE(loaded.empty());
+  ASSERT_EQUAL(moved.find(7)->second, 49);
+  MappedMap<int, int> other(file.path);
+  other = std::move(moved);
+  ASSERT_EQUAL(other.find(9)->second, 81);
+}
+
+TEST(writer_rejects_other_orders) {
+  Scratch_file file("order");
+  BinarySearchTree<int, std::greater<int>> descending;
+  descending.insert(1);
+  descending.insert(2);
+  bool threw = false;
+  try {
+    save_mapped(descending, file.path);
+  }
+  catch (const std::invalid_argument &) {
+    threw = true;
+  }
+  ASSERT_TRUE(threw);
+}
+
+TEST(loader_rejects_bad_files) {
+  ASSERT_TRUE((load_fails<MappedMap<int, int>>("MappedTree_tests_missing")));
+
+  Scratch_file file("bad");
+  Map<std::string, int> counts;
+  counts["a"] = 1;
+  counts["b"] = 2;
+  save_mapped(counts, file.path);
+  ASSERT_TRUE((load_fails<MappedMap<int, int>>(file.path)));
+  ASSERT_TRUE((load_fails<MappedMap<std::string, double>>(file.path)));
+  ASSERT_TRUE((load_fails<MappedSearchTree<std::string>>(file.path)));
+
+  // elements of the same size but another type
+  Scratch_file ints("ints");
+  BinarySearchTree<int> tree;
+  tree.insert(1);
+  tree.insert(2);
+  save_mapped(tree, ints.path);
+  ASSERT_FALSE((load_fails<MappedSearchTree<int>>(ints.path)));
+  ASSERT_TRUE((load_fails<MappedSearchTree<float>>(ints.path)));
+  ASSERT_TRUE((load_fails<MappedSearchTree<unsigned>>(ints.path)));
+
+  // cut off the end of the string pool
+  std::ifstream in(file.path, std::ios::binary);
+  std::string bytes((std::istreambuf_iterator<char>(in)),
+                    std::istreambuf_iterator<char>());
+  in.close();
+  std::ofstream(file.path, std::ios::binary).write(bytes.data(),
+                                                   bytes.size() - 1);
+  ASSERT_TRUE((load_fails<MappedMap<std::string, int>>(file.path)));
+
+  // a records offset so large that the end of the records wraps around
+  MappedHeader header;
+  std::memcpy(&header, bytes.data(), sizeof(header));
+  header.records_offset = ~uint64_t(0) - 7;
+  std::memcpy(&bytes[0], &header, sizeof(header));
+  std::ofstream(file.path, std::ios::binary).write(bytes.data(),
+                                                   bytes.size());
+  ASSERT_TRUE((load_fails<MappedMap<std::string, int>>(file.path)));
+
+  // not a file written by save_mapped()
+  std::ofstream(file.path, std::ios::binary) << std::string(100, 'x');
+  ASSERT_TRUE((load_fails<MappedMap<std::string, int>>(file.path)));
+  std::ofstream(file.path, std::ios::binary) << "short";
+  ASSERT_TRUE((load_fails<MappedMap<std::string, int>>(file.path)));
+}
+
+TEST_MAIN()
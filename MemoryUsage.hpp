@@ -0,0 +1,114 @@
+#ifndef MEMORY_USAGE_HPP
+#define MEMORY_USAGE_HPP
+/* MemoryUsage.hpp
+ *
+ * Memory and shape statistics of a tree, as returned by
+ * BinarySearchTree::memory_usage() and Map::memory_usage():
+ *
+ *   MemoryUsage usage = map.memory_usage();
+ *   std::cout << usage;
+ *
+ * Node bytes and allocator slack are exact. The heap memory owned by
+ * the elements themselves is an estimate made by owned_heap_bytes(),
+ * which knows std::string, std::vector and std::pair; other types count
+ * as owning nothing unless an overload of owned_heap_bytes() for them
+ * can be found by argument-dependent lookup. Allocation headers kept by
+ * the system allocator are not counted anywhere.
+ */
+
+#include <cstddef>    //size_t
+#include <functional> //less
+#include <ostream>
+#include <string>
+#include <utility>    //pair
+#include <vector>
+
+// EFFECTS: Returns the number of heap bytes owned by 'value' beyond
+//          sizeof(value). By default a value owns none.
+template <typename T>
+size_t owned_heap_bytes(const T &) {
+  return 0;
+}
+
+// Declared up front so that containers of pairs and pairs of containers
+// find each other's overloads.
+template <typename T, typename Alloc>
+size_t owned_heap_bytes(const std::vector<T, Alloc> &vec);
+
+template <typename First, typename Second>
+size_t owned_heap_bytes(const std::pair<First, Second> &pair);
+
+// EFFECTS: Returns the capacity of the heap buffer of 'str', or 0 if
+//          its characters fit in the small-string buffer inside the
+//          object itself.
+inline size_t owned_heap_bytes(const std::string &str) {
+  const char *object = reinterpret_cast<const char *>(&str);
+  std::less<const char *> less;
+  bool is_inline = !less(str.data(), object) &&
+                   less(str.data(), object + sizeof(str));
+  return is_inline ? 0 : str.capacity() + 1;
+}
+
+template <typename T, typename Alloc>
+size_t owned_heap_bytes(const std::vector<T, Alloc> &vec) {
+  size_t bytes = vec.capacity() * sizeof(T);
+  for (const T &elt : vec) {
+    bytes += owned_heap_bytes(elt);
+  }
+  return bytes;
+}
+
+template <typename First, typename Second>
+size_t owned_heap_bytes(const std::pair<First, Second> &pair) {
+  return owned_heap_bytes(pair.first) + owned_heap_bytes(pair.second);
+}
+
+struct MemoryUsage {
+  // The number of elements, one per node.
+  size_t node_count = 0;
+
+  // sizeof(node) * node_count: the elements themselves plus the links,
+  // cached height and augmentation data stored next to each of them.
+  size_t node_bytes = 0;
+
+  // Estimated heap bytes owned by the elements, such as the buffers of
+  // long strings (see owned_heap_bytes).
+  size_t element_heap_bytes = 0;
+
+  // Bytes the node allocator holds but no node uses: freed and
+  // never-used slots of a pool, and slab bookkeeping.
+  size_t allocator_slack_bytes = 0;
+
+  // The depth of a node is the number of nodes on the path from the root
+  // to it, so the root has depth 1 and a find() that stops at a node
+  // compares against that many elements. max_depth is the height of the
+  // tree, and depth_histogram[d - 1] is the number of nodes at depth d.
+  size_t max_depth = 0;
+  double mean_depth = 0;
+  std::vector<size_t> depth_histogram;
+
+  // EFFECTS: Returns the total memory attributed to the tree: nodes,
+  //          allocator slack and the heap memory of the elements.
+  size_t total_bytes() const {
+    return node_bytes + element_heap_bytes + allocator_slack_bytes;
+  }
+};
+
+// EFFECTS: Prints the statistics in 'usage', one figure per line, with
+//          the depth histogram last.
+inline std::ostream &operator<<(std::ostream &os, const MemoryUsage &usage) {
+  os << "nodes = " << usage.node_count << '\n'
+     << "node bytes = " << usage.node_bytes << '\n'
+     << "element heap bytes = " << usage.element_heap_bytes << '\n'
+     << "allocator slack bytes = " << usage.allocator_slack_bytes << '\n'
+     << "total bytes = " << usage.total_bytes() << '\n'
+     << "max depth = " << usage.max_depth << '\n'
+     << "mean depth = " << usage.mean_depth << '\n'
+     << "depth histogram =";
+  for (size_t count : usage.depth_histogram) {
+    os << ' ' << count;
+  }
+  return os << '\n';
+}
+
+#endif // MEMORY_USAGE_HPP
@@ -0,0 +1,229 @@
+#ifndef NODE_ALLOCATOR_HPP
+#define NODE_ALLOCATOR_HPP
+/* NodeAllocator.hpp
+ *
+ * Node allocation policies for BinarySearchTree. A policy is a class
+ * template taking the node type, selected through the fourth template
+ * parameter of BinarySearchTree:
+ *
+ *   BinarySearchTree<int, std::less<int>, AVLBalance, PoolNodeAllocator>
+ *
+ * Every policy provides
+ *
+ *   template <typename... Args> Node *create(Args&&... args);
+ *   void destroy(Node *node);
+ *   void release_all();
+ *   void adopt(Allocator &other);
+ *   size_t slack_bytes(size_t live_nodes) const;
+ *   static const bool releases_in_bulk;
+ *
+ * create() constructs a node from the given arguments and destroy()
+ * destroys one previously created node. When releases_in_bulk is true,
+ * release_all() frees the storage of every node created so far at once;
+ * the tree then only runs the node destructors (and only when they are
+ * non-trivial) before calling it, instead of destroying nodes one by one.
+ * adopt() takes over every node created by 'other', which is left empty,
+ * so that a tree can keep nodes it took from another tree.
+ * slack_bytes() reports how much memory the allocator holds beyond the
+ * 'live_nodes' nodes currently in use, for memory accounting.
+ *
+ * Allocators are owned by a single tree and are never shared: copying a
+ * tree gives the copy a fresh, empty allocator, while moving a tree moves
+ * its allocator (and with it, ownership of every node) along with it.
+ */
+
+#include <cstddef> //size_t
+#include <new>     //placement new
+#include <utility> //forward, swap
+
+// Allocates every node individually with new and frees it with delete.
+template <typename Node>
+class HeapNodeAllocator {
+public:
+  static const bool releases_in_bulk = false;
+
+  template <typename... Args>
+  Node *create(Args&&... args) {
+    return new Node(std::forward<Args>(args)...);
+  }
+
+  void destroy(Node *node) {
+    delete node;
+  }
+
+  void release_all() { }
+
+  void adopt(HeapNodeAllocator &) { }
+
+  // Every node is its own allocation of exactly sizeof(Node) bytes.
+  size_t slack_bytes(size_t) const {
+    return 0;
+  }
+};
+
+// Carves nodes out of large contiguous slabs. Destroyed nodes go onto a
+// free list and are reused by later calls to create(). All slabs are
+// returned to the system at once by release_all() or when the allocator
+// is destroyed.
+template <typename Node>
+class PoolNodeAllocator {
+public:
+  static const bool releases_in_bulk = true;
+
+  PoolNodeAllocator()
+    : slabs(nullptr), free_list(nullptr), next_unused(0) { }
+
+  // A copy starts with its own empty pool
+  PoolNodeAllocator(const PoolNodeAllocator &)
+    : PoolNodeAllocator() { }
+
+  PoolNodeAllocator &operator=(const PoolNodeAllocator &) {
+    return *this;
+  }
+
+  // A moved-to pool takes over every slab of the moved-from pool
+  PoolNodeAllocator(PoolNodeAllocator &&other) noexcept
+    : slabs(other.slabs), free_list(other.free_list),
+      next_unused(other.next_unused) {
+    other.slabs = nullptr;
+    other.free_list = nullptr;
+    other.next_unused = 0;
+  }
+
+  // REQUIRES: every node created by this pool has been destroyed, or has
+  //           a trivial destructor
+  PoolNodeAllocator &operator=(PoolNodeAllocator &&other) noexcept {
+    if (this != &other) {
+      release_all();
+      std::swap(slabs, other.slabs);
+      std::swap(free_list, other.free_list);
+      std::swap(next_unused, other.next_unused);
+    }
+    return *this;
+  }
+
+  ~PoolNodeAllocator() {
+    release_all();
+  }
+
+  template <typename... Args>
+  Node *create(Args&&... args) {
+    Slot *slot = take_slot();
+    try {
+      return new (slot->storage) Node(std::forward<Args>(args)...);
+    }
+    catch (...) {
+      give_back(slot);
+      throw;
+    }
+  }
+
+  void destroy(Node *node) {
+    node->~Node();
+    give_back(reinterpret_cast<Slot *>(node));
+  }
+
+  // REQUIRES: every node created by this allocator has already been
+  //           destroyed, or has a trivial destructor
+  // EFFECTS:  Frees all slabs.
+  void release_all() {
+    while (slabs) {
+      Slab *next = slabs->next;
+      delete slabs;
+      slabs = next;
+    }
+    free_list = nullptr;
+    next_unused = 0;
+  }
+
+  // MODIFIES: this pool, other
+  // EFFECTS:  Takes over every slab of 'other', leaving it empty. The
+  //           never-used slots of its newest slab and its free list join
+  //           this pool's free list, and its slabs go behind this pool's
+  //           newest one, which keeps handing out its unused slots first.
+  void adopt(PoolNodeAllocator &other) {
+    if (this == &other || !other.slabs) {
+      return;
+    }
+    if (!slabs) {
+      std::swap(slabs, other.slabs);
+      std::swap(free_list, other.free_list);
+      std::swap(next_unused, other.next_unused);
+      return;
+    }
+    for (size_t i = other.next_unused; i < slots_per_slab; ++i) {
+      give_back(&other.slabs->slots[i]);
+    }
+    if (other.free_list) {
+      Slot *last_free = other.free_list;
+      while (last_free->next_free) {
+        last_free = last_free->next_free;
+      }
+      last_free->next_free = free_list;
+      free_list = other.free_list;
+    }
+    Slab *last_slab = other.slabs;
+    while (last_slab->next) {
+      last_slab = last_slab->next;
+    }
+    last_slab->next = slabs->next;
+    slabs->next = other.slabs;
+    other.slabs = nullptr;
+    other.free_list = nullptr;
+    other.next_unused = 0;
+  }
+
+  // EFFECTS: Returns the bytes of every slab minus those of the
+  //          'live_nodes' nodes in use: free and never-used slots, and
+  //          the bookkeeping of each slab.
+  size_t slack_bytes(size_t live_nodes) const {
+    size_t slab_count = 0;
+    for (const Slab *slab = slabs; slab; slab = slab->next) {
+      ++slab_count;
+    }
+    return slab_count * sizeof(Slab) - live_nodes * sizeof(Node);
+  }
+
+private:
+  // Storage for one node, or a link in the free list once it is released
+  union Slot {
+    Slot *next_free;
+    alignas(Node) unsigned char storage[sizeof(Node)];
+  };
+
+  // Slabs are sized to roughly 64 KiB so that allocating one is rare but
+  // a mostly empty tree does not waste much memory.
+  static const size_t slots_per_slab =
+    sizeof(Slot) < 65536 / 16 ? 65536 / sizeof(Slot) : 16;
+
+  struct Slab {
+    Slot slots[slots_per_slab];
+    Slab *next;
+  };
+
+  Slab *slabs;       // most recently allocated slab first
+  Slot *free_list;   // released slots, ready for reuse
+  size_t next_unused; // index of the first never-used slot in 'slabs'
+
+  Slot *take_slot() {
+    if (free_list) {
+      Slot *slot = free_list;
+      free_list = slot->next_free;
+      return slot;
+    }
+    if (!slabs || next_unused == slots_per_slab) {
+      Slab *slab = new Slab;
+      slab->next = slabs;
+      slabs = slab;
+      next_unused = 0;
+    }
+    return &slabs->slots[next_unused++];
+  }
+
+  void give_back(Slot *slot) {
+    slot->next_free = free_list;
+    free_list = slot;
+  }
+};
+
+#endif // NODE_ALLOCATOR_HPP
@@ -0,0 +1,521 @@
+#ifndef PERSISTENT_TREE_HPP
+#define PERSISTENT_TREE_HPP
+/* PersistentTree.hpp
+ *
+ * An AVL-balanced search tree whose copies share structure. Copying a
+ * PersistentTree takes O(1) time and memory: the copy just takes another
+ * reference to the root node. Modifying a tree copies only the nodes on
+ * the path from the root to the change, O(log n) of them, and only those
+ * that are still shared with some other copy (path copying). Nodes are
+ * reference counted and freed as soon as no tree uses them any more.
+ *
+ * This makes it cheap to hand a read-only version of a model to a query
+ * thread while training continues on the original:
+ *
+ *   PersistentTree<std::string> model;
+ *   ...
+ *   PersistentTree<std::string> snapshot = model; // O(1)
+ *   std::thread reader([snapshot] { ... snapshot.find("word") ... });
+ *   model.insert("new word");                     // copies O(log n) nodes
+ *
+ * Shared nodes are never modified, and reference counts are atomic, so
+ * different copies may be used and destroyed from different threads.
+ * A single PersistentTree object is not safe to modify from one thread
+ * while another thread uses that same object.
+ *
+ * Elements cannot be modified through iterators, since they may be
+ * shared with other copies. Modifying a tree invalidates its iterators;
+ * iterators of other copies stay valid.
+ *
+ * INVARIANTS: Like BinarySearchTree with AVLBalance: no duplicates, the
+ * sorting invariant, and subtree heights that differ by at most one at
+ * every node. No operation recurses.
+ */
+
+#include <atomic>     //atomic
+#include <cassert>    //assert
+#include <cstddef>    //size_t
+#include <functional> //less
+#include <iostream>   //ostream
+#include <iterator>   //forward_iterator_tag
+#include <utility>    //move, forward
+#include <vector>
+#include "CopyOnWriteAVL.hpp"
+
+template <typename T, typename Compare=std::less<T>>
+class PersistentTree {
+
+private:
+
+  // A Node is owned jointly by every parent node and tree root that
+  // points to it; 'refs' counts them. A node with a single reference is
+  // reachable only from its one owner and may be changed in place by it;
+  // a node with more is shared and is copied before any change.
+  struct Node {
+    template <typename... Args>
+    explicit Node(Args&&... args)
+      : datum(std::forward<Args>(args)...), left(nullptr), right(nullptr),
+        height(1), refs(1) { }
+
+    T datum;
+    Node *left;
+    Node *right;
+    int height;
+    std::atomic<int> refs;
+  };
+
+public:
+
+  // Default constructor
+  PersistentTree()
+    : root(nullptr), elt_count(0) { }
+
+  // Copy constructor
+  // EFFECTS: Shares all nodes of 'other' in O(1).
+  PersistentTree(const PersistentTree &other)
+    : root(retain(other.root)), elt_count(other.elt_count) { }
+
+  // Move constructor
+  PersistentTree(PersistentTree &&other) noexcept
+    : root(other.root), elt_count(other.elt_count) {
+    other.root = nullptr;
+    other.elt_count = 0;
+  }
+
+  // Assignment operator
+  // EFFECTS: Shares all nodes of 'rhs' in O(1), and releases the nodes
+  //          this tree used to hold.
+  PersistentTree &operator=(const PersistentTree &rhs) {
+    Node *old_root = root;
+    root = retain(rhs.root);
+    elt_count = rhs.elt_count;
+    release(old_root);
+    return *this;
+  }
+
+  // Move assignment operator
+  PersistentTree &operator=(PersistentTree &&rhs) noexcept {
+    if (this != &rhs) {
+      release(root);
+      root = rhs.root;
+      elt_count = rhs.elt_count;
+      rhs.root = nullptr;
+      rhs.elt_count = 0;
+    }
+    return *this;
+  }
+
+  // Destructor
+  // EFFECTS: Releases this tree's reference to its nodes. Nodes that no
+  //          other copy uses are destroyed.
+  ~PersistentTree() {
+    release(root);
+  }
+
+  // EFFECTS: Returns whether this tree is empty.
+  bool empty() const {
+    return root == nullptr;
+  }
+
+  // EFFECTS: Returns the number of elements in this tree.
+  size_t size() const {
+    return elt_count;
+  }
+
+  // EFFECTS: Returns the height of the tree, 0 if it is empty.
+  size_t height() const {
+    return static_cast<size_t>(CopyOnWriteAVL::height_of(root));
+  }
+
+  class Iterator {
+    // OVERVIEW: Iterates over the elements in ascending order. Since the
+    //           nodes have no parent pointers, an Iterator keeps the
+    //           stack of ancestors whose left subtree it is in, with the
+    //           current node on top.
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const T *;
+    using reference = const T &;
+
+    Iterator() { }
+
+    const T &operator*() const {
+      return path.back()->datum;
+    }
+
+    const T *operator->() const {
+      return &path.back()->datum;
+    }
+
+    // Prefix ++
+    Iterator &operator++() {
+      const Node *node = path.back();
+      path.pop_back();
+      push_left_spine(node->right);
+      return *this;
+    }
+
+    // Postfix ++
+    Iterator operator++(int) {
+      Iterator result(*this);
+      ++(*this);
+      return result;
+    }
+
+    bool operator==(const Iterator &rhs) const {
+      return current() == rhs.current();
+    }
+
+    bool operator!=(const Iterator &rhs) const {
+      return !(*this == rhs);
+    }
+
+  private:
+    friend class PersistentTree;
+
+    std::vector<const Node *> path;
+
+    const Node *current() const {
+      return path.empty() ? nullptr : path.back();
+    }
+
+    void push_left_spine(const Node *node) {
+      for (; node != nullptr; node = node->left) {
+        path.push_back(node);
+      }
+    }
+  }; // PersistentTree::Iterator
+
+  // EFFECTS: Returns an iterator to the first element.
+  Iterator begin() const {
+    Iterator result;
+    result.push_left_spine(root);
+    return result;
+  }
+
+  // EFFECTS: Returns an iterator to past-the-end.
+  Iterator end() const {
+    return Iterator();
+  }
+
+  // EFFECTS: Returns an Iterator to the maximum element, or an end
+  //          Iterator if the tree is empty.
+  Iterator max_element() const {
+    Iterator result;
+    for (const Node *node = root; node != nullptr; node = node->right) {
+      if (node->right == nullptr) {
+        result.path.push_back(node);
+      }
+    }
+    return result;
+  }
+
+  // EFFECTS: Returns an Iterator to the element equivalent to query,
+  //          which may be of any type Compare can compare against T, or
+  //          an end Iterator if there is none.
+  template <typename Key>
+  Iterator find(const Key &query) const {
+    Iterator result = lower_bound(query);
+    if (result != end() && less(query, *result)) {
+      return end();
+    }
+    return result;
+  }
+
+  // EFFECTS: Returns whether an element equivalent to query is contained.
+  //          Unlike find(), never allocates.
+  template <typename Key>
+  bool contains(const Key &query) const {
+    const Node *node = root;
+    while (node != nullptr) {
+      if (less(query, node->datum)) {
+        node = node->left;
+      }
+      else if (less(node->datum, query)) {
+        node = node->right;
+      }
+      else {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // EFFECTS: Returns an Iterator to the first element that is not less
+  //          than key, or an end Iterator if there is none.
+  template <typename Key>
+  Iterator lower_bound(const Key &key) const {
+    Iterator result;
+    const Node *node = root;
+    while (node != nullptr) {
+      if (less(node->datum, key)) {
+        node = node->right;
+      }
+      else {
+        // a candidate; the iteration continues with it after the left
+        // subtree, which is where anything smaller would be
+        result.path.push_back(node);
+        if (!less(key, node->datum)) {
+          break;
+        }
+        node = node->left;
+      }
+    }
+    return result;
+  }
+
+  // MODIFIES: this tree
+  // EFFECTS : Inserts a copy of item unless an equivalent element is
+  //           already contained. Returns whether it was inserted.
+  bool insert(const T &item) {
+    return try_emplace(item, item);
+  }
+
+  // MODIFIES: this tree
+  // EFFECTS : Same as above, but moves item into the tree.
+  bool insert(T &&item) {
+    return try_emplace(item, std::move(item));
+  }
+
+  // MODIFIES: this tree
+  // EFFECTS : Constructs an element from args and inserts it unless an
+  //           equivalent element is already contained. Returns whether it
+  //           was inserted.
+  template <typename... Args>
+  bool emplace(Args&&... args) {
+    T item(std::forward<Args>(args)...);
+    return try_emplace(item, std::move(item));
+  }
+
+  // MODIFIES: this tree
+  // EFFECTS : If no element is equivalent to key, inserts an element
+  //           constructed from args. Only the nodes on the path to the new
+  //           leaf that are shared with other copies are copied. Returns
+  //           whether the element was inserted.
+  // REQUIRES: The element constructed from args is equivalent to key.
+  template <typename Key, typename... Args>
+  bool try_emplace(const Key &key, Args&&... args) {
+    Node *path[CopyOnWriteAVL::max_depth];
+    int depth = 0;
+    bool go_left = false;
+    for (Node *node = root; node != nullptr; ) {
+      assert(depth < CopyOnWriteAVL::max_depth);
+      path[depth++] = node;
+      if (less(key, node->datum)) {
+        go_left = true;
+      }
+      else if (less(node->datum, key)) {
+        go_left = false;
+      }
+      else {
+        return false;
+      }
+      node = go_left ? node->left : node->right;
+    }
+
+    // key may refer to an argument that building the leaf moves from, so
+    // it is not used below
+    own_path(path, depth);
+    Node *leaf = new Node(std::forward<Args>(args)...);
+    if (depth == 0) {
+      root = leaf;
+    }
+    else {
+      Node *parent = path[depth - 1];
+      (go_left ? parent->left : parent->right) = leaf;
+    }
+    ++elt_count;
+    rebalance_path(path, depth);
+    return true;
+  }
+
+  // MODIFIES: this tree
+  // EFFECTS : Removes the element equivalent to key, if there is one, and
+  //           returns the number of elements removed (0 or 1). Only the
+  //           nodes on the path to it that are shared are copied.
+  template <typename Key>
+  size_t erase(const Key &key) {
+    Node *path[CopyOnWriteAVL::max_depth];
+    int depth = 0;
+    for (Node *node = root; ; ) {
+      if (node == nullptr) {
+        return 0;
+      }
+      assert(depth < CopyOnWriteAVL::max_depth);
+      path[depth++] = node;
+      if (less(key, node->datum)) {
+        node = node->left;
+      }
+      else if (less(node->datum, key)) {
+        node = node->right;
+      }
+      else {
+        break;
+      }
+    }
+    own_path(path, depth);
+
+    Node *target = path[depth - 1];
+    Node *removed = target;
+    Node *replacement;
+    if (target->left != nullptr && target->right != nullptr) {
+      // move the successor's element up and remove the successor instead
+      Node **slot = &target->right;
+      while (own(*slot)->left != nullptr) {
+        assert(depth < CopyOnWriteAVL::max_depth);
+        path[depth++] = *slot;
+        slot = &(*slot)->left;
+      }
+      removed = *slot;
+      target->datum = std::move(removed->datum);
+      replacement = removed->right;
+      *slot = replacement;
+    }
+    else {
+      replacement = target->left != nullptr ? target->left : target->right;
+      --depth;
+      child_slot(path, depth) = replacement;
+    }
+    // 'removed' is unshared and no longer linked; its child moved up
+    removed->left = removed->right = nullptr;
+    release(removed);
+    --elt_count;
+    rebalance_path(path, depth);
+    return 1;
+  }
+
+  // MODIFIES: this tree
+  // EFFECTS : Removes every element from this tree. Other copies keep
+  //           theirs.
+  void clear() {
+    release(root);
+    root = nullptr;
+    elt_count = 0;
+  }
+
+  // EFFECTS: Returns whether every element compares strictly less than
+  //          the next one in ascending order.
+  bool check_sorting_invariant() const {
+    Iterator prev = begin();
+    if (prev == end()) {
+      return true;
+    }
+    for (Iterator next = std::next(prev); next != end(); prev = next++) {
+      if (!less(*prev, *next)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+private:
+
+  // DATA REPRESENTATION
+  Node *root;
+  size_t elt_count;
+  Compare less;
+
+  // EFFECTS : Adds a reference to node, if it is not null, and returns it.
+  static Node *retain(Node *node) {
+    if (node != nullptr) {
+      node->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+    return node;
+  }
+
+  // EFFECTS : Drops a reference to node. If that was the last one,
+  //           destroys it and drops its references to its children in
+  //           turn, without recursing.
+  static void release(Node *node) {
+    std::vector<Node *> dead;
+    if (node != nullptr &&
+        node->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      dead.push_back(node);
+    }
+    while (!dead.empty()) {
+      Node *next = dead.back();
+      dead.pop_back();
+      for (Node *child : {next->left, next->right}) {
+        if (child != nullptr &&
+            child->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+          dead.push_back(child);
+        }
+      }
+      delete next;
+    }
+  }
+
+  // REQUIRES: slot is a child pointer of a node owned by this tree alone,
+  //           or the root pointer, and is not null
+  // MODIFIES: slot
+  // EFFECTS : Makes the node in slot owned by this tree alone, by
+  //           replacing it with a copy if it is shared, and returns it.
+  static Node *own(Node *&slot) {
+    Node *node = slot;
+    if (node->refs.load(std::memory_order_acquire) == 1) {
+      return node;
+    }
+    Node *copy = new Node(node->datum);
+    copy->left = retain(node->left);
+    copy->right = retain(node->right);
+    copy->height = node->height;
+    slot = copy;
+    release(node);
+    return copy;
+  }
+
+  // REQUIRES: path[0..depth) is a root-to-node path in this tree
+  // MODIFIES: this tree, path
+  // EFFECTS : Makes every node on the path owned by this tree alone,
+  //           top-down, updating path to point at the owned nodes.
+  void own_path(Node **path, int depth) {
+    for (int i = 0; i < depth; ++i) {
+      path[i] = own(child_slot(path, i));
+    }
+  }
+
+  // REQUIRES: path[0..i] is a root-to-node path in this tree
+  // EFFECTS : Returns the pointer that links path[i] into the tree: the
+  //           root pointer or a child pointer of path[i - 1].
+  Node *&child_slot(Node **path, int i) {
+    if (i == 0) {
+      return root;
+    }
+    Node *parent = path[i - 1];
+    return parent->left == path[i] ? parent->left : parent->right;
+  }
+
+  // REQUIRES: path[0..depth) is a root-to-node path of nodes owned by
+  //           this tree alone, and all subtrees below it are balanced
+  // MODIFIES: this tree
+  // EFFECTS : Restores the AVL invariant from path[depth - 1] up to the
+  //           root, rotating where needed.
+  void rebalance_path(Node **path, int depth) {
+    for (int i = depth - 1; i >= 0; --i) {
+      Node *&slot = child_slot(path, i);
+      int old_height = slot->height;
+      slot = CopyOnWriteAVL::rebalance(slot, own);
+      if (slot->height == old_height) {
+        return;
+      }
+    }
+  }
+
+};
+
+// MODIFIES: os
+// EFFECTS : Prints the elements in ascending order, in the same format as
+//           for a BinarySearchTree. Returns os.
+template <typename T, typename Compare>
+std::ostream &operator<<(std::ostream &os,
+                         const PersistentTree<T, Compare> &tree) {
+  os << "[ ";
+  for (const T &elt : tree) {
+    os << elt << " ";
+  }
+  return os << "]";
+}
+
+#endif // PERSISTENT_TREE_HPP
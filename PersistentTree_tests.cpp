@@ -0,0 +1,249 @@
+#include "PersistentTree.hpp"
+#include "unit_test_framework.hpp"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// An element that counts how many instances are alive
+struct Counted {
+  static int alive;
+  int value;
+
+  Counted(int value_in) : value(value_in) {
+    ++alive;
+  }
+
+  Counted(const Counted &other) : value(other.value) {
+    ++alive;
+  }
+
+  Counted &operator=(const Counted &) = default;
+
+  ~Counted() {
+    --alive;
+  }
+
+  bool operator<(const Counted &rhs) const {
+    return value < rhs.value;
+  }
+};
+
+int Counted::alive = 0;
+
+// EFFECTS: Returns how many elements of 'a' are stored at the same
+//          address in 'b'.
+template <typename Tree>
+int count_shared(const Tree &a, const Tree &b) {
+  int shared = 0;
+  for (auto it = a.begin(); it != a.end(); ++it) {
+    if (&*b.find(*it) == &*it) {
+      ++shared;
+    }
+  }
+  return shared;
+}
+
+TEST(empty_tree) {
+  PersistentTree<int> tree;
+  ASSERT_TRUE(tree.empty());
+  ASSERT_EQUAL(tree.size(), 0);
+  ASSERT_EQUAL(tree.height(), 0);
+  ASSERT_TRUE(tree.begin() == tree.end());
+  ASSERT_TRUE(tree.find(1) == tree.end());
+  ASSERT_TRUE(tree.max_element() == tree.end());
+  ASSERT_FALSE(tree.contains(1));
+  ASSERT_EQUAL(tree.erase(1), 0);
+}
+
+TEST(insert_find_and_iterate) {
+  PersistentTree<int> tree;
+  const int n = 1000;
+  for (int i = 0; i < n; ++i) {
+    ASSERT_TRUE(tree.insert(i * 2));
+  }
+  ASSERT_FALSE(tree.insert(10));
+  ASSERT_EQUAL(tree.size(), n);
+  // sorted inserts stay balanced
+  ASSERT_TRUE(tree.height() <= 1.44 * std::log2(n + 2));
+  ASSERT_TRUE(tree.check_sorting_invariant());
+
+  int expected = 0;
+  for (int elt : tree) {
+    ASSERT_EQUAL(elt, expected);
+    expected += 2;
+  }
+  for (int i = -1; i <= 2 * n; ++i) {
+    bool present = i >= 0 && i % 2 == 0 && i < 2 * n;
+    ASSERT_EQUAL(tree.contains(i), present);
+    if (present) {
+      ASSERT_EQUAL(*tree.find(i), i);
+    }
+    else {
+      ASSERT_TRUE(tree.find(i) == tree.end());
+    }
+    auto lower = tree.lower_bound(i);
+    int expected_lower = i < 0 ? 0 : i + i % 2;
+    ASSERT_TRUE(expected_lower < 2 * n ? *lower == expected_lower
+                                       : lower == tree.end());
+  }
+  ASSERT_EQUAL(*tree.max_element(), 2 * n - 2);
+  ASSERT_TRUE(++tree.max_element() == tree.end());
+
+  std::ostringstream oss;
+  PersistentTree<int> small;
+  small.emplace(2);
+  small.emplace(1);
+  oss << small;
+  ASSERT_EQUAL(oss.str(), "[ 1 2 ]");
+}
+
+TEST(copy_shares_every_node) {
+  PersistentTree<std::string> tree;
+  for (int i = 0; i < 500; ++i) {
+    tree.insert("word" + std::to_string(i));
+  }
+  PersistentTree<std::string> copy = tree;
+  ASSERT_EQUAL(copy.size(), 500);
+  ASSERT_EQUAL(count_shared(tree, copy), 500);
+
+  PersistentTree<std::string> assigned;
+  assigned.insert("replaced");
+  assigned = copy;
+  ASSERT_EQUAL(count_shared(tree, assigned), 500);
+}
+
+TEST(insert_into_copy_copies_only_the_path) {
+  PersistentTree<int> tree;
+  const int n = 10000;
+  for (int i = 0; i < n; ++i) {
+    tree.insert(i * 2);
+  }
+  PersistentTree<int> copy = tree;
+  copy.insert(5001);
+  ASSERT_EQUAL(copy.size(), n + 1);
+  ASSERT_EQUAL(tree.size(), n);
+  ASSERT_FALSE(tree.contains(5001));
+  ASSERT_TRUE(copy.contains(5001));
+  ASSERT_TRUE(tree.check_sorting_invariant());
+  ASSERT_TRUE(copy.check_sorting_invariant());
+
+  // only the nodes on the path to the new leaf were copied
+  int unshared = n - count_shared(tree, copy);
+  ASSERT_TRUE(unshared > 0);
+  ASSERT_TRUE(unshared <= static_cast<int>(tree.height()) + 2);
+
+  // once the copy owns its path, inserting nearby copies nothing more
+  int before = count_shared(tree, copy);
+  copy.insert(5003);
+  ASSERT_TRUE(before - count_shared(tree, copy) <= 3);
+}
+
+TEST(unshared_tree_is_modified_in_place) {
+  PersistentTree<int> tree;
+  for (int i = 0; i < 100; ++i) {
+    tree.insert(i);
+  }
+  const int *address = &*tree.find(50);
+  for (int i = 100; i < 200; ++i) {
+    tree.insert(i);
+  }
+  tree.erase(10);
+  ASSERT_EQUAL(&*tree.find(50), address);
+}
+
+TEST(erase_from_copy_leaves_original) {
+  PersistentTree<int> tree;
+  std::vector<int> expected;
+  for (int i = 0; i < 1000; ++i) {
+    tree.insert(i);
+    expected.push_back(i);
+  }
+  PersistentTree<int> copy = tree;
+  for (int i = 0; i < 1000; i += 3) {
+    ASSERT_EQUAL(copy.erase((i * 7) % 1000), 1);
+  }
+  ASSERT_EQUAL(copy.erase(-5), 0);
+  ASSERT_TRUE(std::vector<int>(tree.begin(), tree.end()) == expected);
+
+  std::vector<int> remaining;
+  for (int i = 0; i < 1000; ++i) {
+    bool erased = false;
+    for (int j = 0; j < 1000; j += 3) {
+      erased = erased || (j * 7) % 1000 == i;
+    }
+    if (!erased) {
+      remaining.push_back(i);
+    }
+  }
+  ASSERT_TRUE(std::vector<int>(copy.begin(), copy.end()) == remaining);
+  ASSERT_EQUAL(copy.size(), remaining.size());
+  ASSERT_TRUE(copy.height() <= 1.44 * std::log2(copy.size() + 2));
+
+  copy.clear();
+  ASSERT_TRUE(copy.empty());
+  ASSERT_EQUAL(tree.size(), 1000);
+}
+
+TEST(unshared_nodes_are_freed) {
+  {
+    PersistentTree<Counted> tree;
+    for (int i = 0; i < 300; ++i) {
+      tree.insert(Counted(i));
+    }
+    ASSERT_EQUAL(Counted::alive, 300);
+    {
+      PersistentTree<Counted> copy = tree;
+      copy.insert(Counted(1000));
+      copy.erase(Counted(5));
+      ASSERT_TRUE(Counted::alive > 301);
+      ASSERT_TRUE(Counted::alive < 330);
+    }
+    // the copy's private path is gone, the shared nodes remain
+    ASSERT_EQUAL(Counted::alive, 300);
+
+    PersistentTree<Counted> other = tree;
+    tree.clear();
+    ASSERT_EQUAL(Counted::alive, 300);
+    other = PersistentTree<Counted>();
+  }
+  ASSERT_EQUAL(Counted::alive, 0);
+}
+
+TEST(snapshot_read_by_another_thread) {
+  PersistentTree<int> model;
+  for (int i = 0; i < 20000; ++i) {
+    model.insert(i * 2);
+  }
+  PersistentTree<int> snapshot = model;
+  long long reader_sum = 0;
+  bool reader_consistent = true;
+  std::thread reader([snapshot, &reader_sum, &reader_consistent] {
+    for (int pass = 0; pass < 5; ++pass) {
+      long long sum = 0;
+      for (int elt : snapshot) {
+        sum += elt;
+      }
+      reader_consistent = reader_consistent &&
+                          (pass == 0 || sum == reader_sum);
+      reader_sum = sum;
+      for (int i = 0; i < 20000; ++i) {
+        reader_consistent = reader_consistent && snapshot.contains(i * 2) &&
+                            !snapshot.contains(i * 2 + 1);
+      }
+    }
+  });
+  for (int i = 0; i < 20000; ++i) {
+    model.insert(i * 2 + 1);
+    model.erase(i * 2);
+  }
+  reader.join();
+  ASSERT_TRUE(reader_consistent);
+  ASSERT_EQUAL(reader_sum, 2LL * 19999 * 20000 / 2);
+  ASSERT_EQUAL(model.size(), 20000);
+  ASSERT_EQUAL(*model.begin(), 1);
+}
+
+TEST_MAIN()
@@ -0,0 +1,510 @@
+#ifndef UNORDERED_MAP_HPP
+#define UNORDERED_MAP_HPP
+/* UnorderedMap.hpp
+ *
+ * A map of unique keys with the find, insert and operator[] interface of
+ * Map.hpp, for uses that count and look up but never need the keys in
+ * order. A lookup hashes the key once instead of comparing it O(log n)
+ * times.
+ *
+ *   UnorderedMap<std::string, int> counts;
+ *   counts.reserve(expected_words);
+ *   for (const std::string &word : words) {
+ *     ++counts[word];
+ *   }
+ *
+ * The table uses open addressing with Robin Hood probing. Elements live
+ * in one flat array of slots, and a parallel array holds one byte per
+ * slot: 0 if the slot is empty, otherwise one more than the distance of
+ * its element from the element's home slot. An insertion that reaches an
+ * element closer to its home than the new one would be takes that slot
+ * and shifts the rest of the run along by one, so elements stay sorted
+ * by home slot within each run. A lookup can therefore stop at the first
+ * element closer to its home than the key would be, and only compares
+ * the key against elements with the same home slot. Erasing shifts the
+ * rest of the run back, so no tombstones are left behind.
+ *
+ * The number of slots is a power of two, and the table doubles before it
+ * would be more than 7/8 full. Iteration visits the elements in table
+ * order, which is unrelated to key order. Insertion and erasure may move
+ * elements, so both invalidate all iterators and references into the map.
+ */
+
+#include <cstddef>    //size_t
+#include <cstdint>    //uint8_t, uint64_t
+#include <functional> //hash, equal_to
+#include <iterator>   //forward_iterator_tag
+#include <memory>     //allocator
+#include <new>        //placement new
+#include <stdexcept>  //length_error
+#include <tuple>      //forward_as_tuple
+#include <utility>    //pair, move, swap, piecewise_construct
+#include <vector>
+
+// NOTE: Key_type and Value_type should not throw when moved, since
+//       elements are moved around the table as it changes.
+template <typename Key_type, typename Value_type,
+          typename Key_hash=std::hash<Key_type>,
+          typename Key_equal=std::equal_to<Key_type>
+         >
+class UnorderedMap {
+
+private:
+  using Pair_type = std::pair<Key_type, Value_type>;
+
+  // Largest value a slot's distance byte can hold, so elements sit at
+  // most max_distance - 1 slots past their home.
+  static constexpr unsigned max_distance = 255;
+
+  // Fewest slots a table is allocated with
+  static constexpr size_t min_capacity = 8;
+
+public:
+
+  class Iterator {
+    // OVERVIEW: Iterates over the key-value pairs of an UnorderedMap in
+    //           table order.
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Pair_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = Pair_type *;
+    using reference = Pair_type &;
+
+    Iterator()
+      : slots(nullptr), distances(nullptr), index(0), capacity(0) { }
+
+    Pair_type &operator*() const {
+      return slots[index];
+    }
+
+    Pair_type *operator->() const {
+      return &slots[index];
+    }
+
+    // Prefix ++
+    Iterator &operator++() {
+      ++index;
+      skip_empty_slots();
+      return *this;
+    }
+
+    // Postfix ++
+    Iterator operator++(int) {
+      Iterator result(*this);
+      ++(*this);
+      return result;
+    }
+
+    bool operator==(const Iterator &rhs) const {
+      return slots == rhs.slots && index == rhs.index;
+    }
+
+    bool operator!=(const Iterator &rhs) const {
+      return !(*this == rhs);
+    }
+
+  private:
+    friend class UnorderedMap;
+
+    Iterator(Pair_type *slots_in, const uint8_t *distances_in,
+             size_t index_in, size_t capacity_in)
+      : slots(slots_in), distances(distances_in), index(index_in),
+        capacity(capacity_in) { }
+
+    void skip_empty_slots() {
+      while (index < capacity && distances[index] == 0) {
+        ++index;
+      }
+    }
+
+    Pair_type *slots;
+    const uint8_t *distances;
+    size_t index;
+    size_t capacity;
+  };
+
+  // EFFECTS : Creates an empty map. No table is allocated until the
+  //           first insertion or reserve().
+  UnorderedMap()
+    : slots(nullptr), shift(64), element_count(0) { }
+
+  UnorderedMap(const UnorderedMap &other)
+    : slots(nullptr), distances(other.distances), shift(other.shift),
+      element_count(0) {
+    // the copy keeps the same layout, so elements are copied slot by slot
+    slots = allocate_slots(capacity());
+    size_t i = 0;
+    try {
+      for (; i < capacity(); ++i) {
+        if (distances[i] != 0) {
+          ::new (static_cast<void *>(slots + i)) Pair_type(other.slots[i]);
+          ++element_count;
+        }
+      }
+    }
+    catch (...) {
+      distances.resize(i);
+      destroy_elements();
+      deallocate_slots(slots, other.capacity());
+      throw;
+    }
+  }
+
+  UnorderedMap(UnorderedMap &&other) noexcept
+    : slots(other.slots), distances(std::move(other.distances)),
+      shift(other.shift), element_count(other.element_count) {
+    other.slots = nullptr;
+    other.distances.clear();
+    other.shift = 64;
+    other.element_count = 0;
+  }
+
+  // Copies or moves, depending on how rhs is passed
+  UnorderedMap &operator=(UnorderedMap rhs) noexcept {
+    swap(rhs);
+    return *this;
+  }
+
+  ~UnorderedMap() {
+    destroy_elements();
+    deallocate_slots(slots, capacity());
+  }
+
+  // MODIFIES: this, other
+  // EFFECTS : Exchanges the contents of this map and other.
+  void swap(UnorderedMap &other) noexcept {
+    std::swap(slots, other.slots);
+    distances.swap(other.distances);
+    std::swap(shift, other.shift);
+    std::swap(element_count, other.element_count);
+  }
+
+  // EFFECTS : Returns whether this map is empty.
+  bool empty() const {
+    return element_count == 0;
+  }
+
+  // EFFECTS : Returns the number of elements in this map.
+  size_t size() const {
+    return element_count;
+  }
+
+  // EFFECTS : Returns the number of slots in the table, which is 0 or a
+  //           power of two.
+  size_t capacity() const {
+    return distances.size();
+  }
+
+  // EFFECTS : Searches this map for an element with key k. Returns an
+  //           iterator to the element if it is found. Otherwise, returns
+  //           end().
+  Iterator find(const Key_type &k) const {
+    size_t pos = 0;
+    unsigned distance = 0;
+    return probe(k, pos, distance) ? iterator_at(pos) : end();
+  }
+
+  // EFFECTS : Returns the number of elements with key k (0 or 1).
+  size_t count(const Key_type &k) const {
+    return contains(k);
+  }
+
+  // EFFECTS : Returns whether this map holds an element with key k.
+  bool contains(const Key_type &k) const {
+    size_t pos = 0;
+    unsigned distance = 0;
+    return probe(k, pos, distance);
+  }
+
+  // MODIFIES: this
+  // EFFECTS : Returns a reference to the mapped value for key k,
+  //           inserting an element with a value-initialized mapped value
+  //           first if k is not already in the map.
+  Value_type &operator[](const Key_type &k) {
+    return try_emplace(k).first->second;
+  }
+
+  // MODIFIES: this
+  // EFFECTS : Same as above, but moves k into the new element if one is
+  //           inserted.
+  Value_type &operator[](Key_type &&k) {
+    return try_emplace(std::move(k)).first->second;
+  }
+
+  // MODIFIES: this
+  // EFFECTS : Inserts val if its key is not already in the map. Returns
+  //           an iterator to the element with that key, along with
+  //           whether val was inserted.
+  std::pair<Iterator, bool> insert(const Pair_type &val) {
+    return emplace_unique(val.first, val);
+  }
+
+  // MODIFIES: this
+  // EFFECTS : Same as above, but moves val into the new element if one is
+  //           inserted. If the key is already in the map, val is left
+  //           untouched.
+  std::pair<Iterator, bool> insert(Pair_type &&val) {
+    return emplace_unique(val.first, std::move(val));
+  }
+
+  // MODIFIES: this
+  // EFFECTS : If k is already in the map, returns an iterator to the
+  //           existing element along with false and does not touch args.
+  //           Otherwise inserts an element with key k and a mapped value
+  //           constructed from args, and returns an iterator to it along
+  //           with true.
+  template <typename... Args>
+  std::pair<Iterator, bool> try_emplace(const Key_type &k, Args&&... args) {
+    return emplace_unique(k, std::piecewise_construct,
+                          std::forward_as_tuple(k),
+                          std::forward_as_tuple(std::forward<Args>(args)...));
+  }
+
+  // MODIFIES: this
+  // EFFECTS : Same as above, but moves k into the new element if one is
+  //           inserted.
+  template <typename... Args>
+  std::pair<Iterator, bool> try_emplace(Key_type &&k, Args&&... args) {
+    return emplace_unique(k, std::piecewise_construct,
+                          std::forward_as_tuple(std::move(k)),
+                          std::forward_as_tuple(std::forward<Args>(args)...));
+  }
+
+  // MODIFIES: this
+  // EFFECTS : Assigns std::forward<M>(obj) to the mapped value for key k
+  //           if k is in the map, and otherwise inserts it with that
+  //           mapped value. Returns an iterator to the element along with
+  //           whether it was inserted.
+  template <typename M>
+  std::pair<Iterator, bool> insert_or_assign(const Key_type &k, M &&obj) {
+    std::pair<Iterator, bool> result = try_emplace(k, std::forward<M>(obj));
+    if (!result.second) {
+      result.first->second = std::forward<M>(obj);
+    }
+    return result;
+  }
+
+  // MODIFIES: this
+  // EFFECTS : Removes the element with key k, if there is one, and
+  //           returns the number of elements removed (0 or 1). The
+  //           elements after it in its run move back one slot.
+  size_t erase(const Key_type &k) {
+    size_t pos = 0;
+    unsigned distance = 0;
+    if (!probe(k, pos, distance)) {
+      return 0;
+    }
+    size_t next = (pos + 1) & mask();
+    while (distances[next] > 1) {
+      slots[pos] = std::move(slots[next]);
+      distances[pos] = static_cast<uint8_t>(distances[next] - 1);
+      pos = next;
+      next = (next + 1) & mask();
+    }
+    slots[pos].~Pair_type();
+    distances[pos] = 0;
+    --element_count;
+    return 1;
+  }
+
+  // MODIFIES: this
+  // EFFECTS : Removes all elements. The table keeps its capacity.
+  void clear() {
+    destroy_elements();
+  }
+
+  // MODIFIES: this
+  // EFFECTS : Grows the table, if needed, so that it holds n elements
+  //           without growing again. Invalidates iterators if it grows.
+  void reserve(size_t n) {
+    size_t new_capacity = capacity() == 0 ? min_capacity : capacity();
+    while (over_max_load(n, new_capacity)) {
+      new_capacity *= 2;
+    }
+    if (new_capacity != capacity()) {
+      rehash(new_capacity);
+    }
+  }
+
+  // EFFECTS : Returns an iterator to the first element in table order,
+  //           or end() if the map is empty.
+  Iterator begin() const {
+    Iterator it(slots, distances.data(), 0, capacity());
+    it.skip_empty_slots();
+    return it;
+  }
+
+  // EFFECTS : Returns an iterator to "past the end".
+  Iterator end() const {
+    return iterator_at(capacity());
+  }
+
+private:
+  Pair_type *slots;
+  std::vector<uint8_t> distances;
+  // 64 - log2(capacity()): a hash mixed by home_slot() keeps its top bits
+  int shift;
+  size_t element_count;
+
+  static Pair_type * allocate_slots(size_t n) {
+    return n == 0 ? nullptr : std::allocator<Pair_type>().allocate(n);
+  }
+
+  static void deallocate_slots(Pair_type *slots_in, size_t n) {
+    if (slots_in != nullptr) {
+      std::allocator<Pair_type>().deallocate(slots_in, n);
+    }
+  }
+
+  // EFFECTS : Returns whether n elements exceed 7/8 of 'slot_count' slots.
+  static bool over_max_load(size_t n, size_t slot_count) {
+    return n > slot_count - slot_count / 8;
+  }
+
+  size_t mask() const {
+    return capacity() - 1;
+  }
+
+  Iterator iterator_at(size_t pos) const {
+    return Iterator(slots, distances.data(), pos, capacity());
+  }
+
+  // EFFECTS : Returns the slot where the element with key k would sit if
+  //           nothing else had the slot. The hash is multiplied by 2^64
+  //           divided by the golden ratio so that hashes differing only
+  //           in their low bits, like those of consecutive integers, land
+  //           far apart.
+  size_t home_slot(const Key_type &k) const {
+    uint64_t hash = static_cast<uint64_t>(Key_hash()(k));
+    return static_cast<size_t>((hash * 0x9E3779B97F4A7C15ull) >> shift);
+  }
+
+  // EFFECTS : Searches for the element with key k. If it is found, sets
+  //           pos to its slot and returns true. Otherwise sets pos to the
+  //           slot where it belongs and 'distance' to its distance byte
+  //           there, and returns false.
+  bool probe(const Key_type &k, size_t &pos, unsigned &distance) const {
+    if (element_count == 0) {
+      pos = capacity() == 0 ? 0 : home_slot(k);
+      distance = 1;
+      return false;
+    }
+    pos = home_slot(k);
+    for (distance = 1; distances[pos] >= distance; ++distance) {
+      if (distances[pos] == distance && Key_equal()(slots[pos].first, k)) {
+        return true;
+      }
+      pos = (pos + 1) & mask();
+    }
+    return false;
+  }
+
+  // EFFECTS : Returns the first empty slot at or after pos, or capacity()
+  //           if shifting the run before it would push an element past
+  //           max_distance.
+  size_t end_of_run(size_t pos) const {
+    while (distances[pos] != 0) {
+      if (distances[pos] == max_distance) {
+        return capacity();
+      }
+      pos = (pos + 1) & mask();
+    }
+    return pos;
+  }
+
+  // REQUIRES: pos was found by probe() for item's key with the given
+  //           distance, and 'empty_slot' = end_of_run(pos) is a slot
+  // MODIFIES: this
+  // EFFECTS : Moves the run from pos up to empty_slot along by one and
+  //           moves item into pos.
+  void shift_in(size_t pos, unsigned distance, size_t empty_slot,
+                Pair_type &&item) {
+    size_t prev = (empty_slot - 1) & mask();
+    ::new (static_cast<void *>(slots + empty_slot))
+      Pair_type(std::move(slots[prev]));
+    distances[empty_slot] = static_cast<uint8_t>(distances[prev] + 1);
+    for (size_t i = prev; i != pos; i = prev) {
+      prev = (i - 1) & mask();
+      slots[i] = std::move(slots[prev]);
+      distances[i] = static_cast<uint8_t>(distances[prev] + 1);
+    }
+    slots[pos] = std::move(item);
+    distances[pos] = static_cast<uint8_t>(distance);
+    ++element_count;
+  }
+
+  // MODIFIES: this
+  // EFFECTS : Implements insert() and try_emplace(): if key k is not in
+  //           the map, inserts an element constructed from args, which
+  //           must have key k. Probes for k once unless the table grows.
+  template <typename... Args>
+  std::pair<Iterator, bool> emplace_unique(const Key_type &k,
+                                           Args&&... args) {
+    size_t pos = 0;
+    unsigned distance = 0;
+    if (probe(k, pos, distance)) {
+      return std::make_pair(iterator_at(pos), false);
+    }
+    if (capacity() == 0 || over_max_load(element_count + 1, capacity())) {
+      rehash(capacity() == 0 ? min_capacity : 2 * capacity());
+      probe(k, pos, distance);
+    }
+    size_t empty_slot = 0;
+    while (distance > max_distance ||
+           (empty_slot = end_of_run(pos)) == capacity()) {
+      // A run is too long to shift. With a sound hash that only happens
+      // in a crowded table; otherwise too many keys share a home slot.
+      if (element_count < capacity() / 2) {
+        throw std::length_error("UnorderedMap: too many keys with the "
+                                "same hash");
+      }
+      rehash(2 * capacity());
+      probe(k, pos, distance);
+    }
+    if (empty_slot == pos) {
+      ::new (static_cast<void *>(slots + pos))
+        Pair_type(std::forward<Args>(args)...);
+      distances[pos] = static_cast<uint8_t>(distance);
+      ++element_count;
+    }
+    else {
+      shift_in(pos, distance, empty_slot,
+               Pair_type(std::forward<Args>(args)...));
+    }
+    return std::make_pair(iterator_at(pos), true);
+  }
+
+  // MODIFIES: this
+  // EFFECTS : Moves every element into a new table of new_capacity slots.
+  void rehash(size_t new_capacity) {
+    UnorderedMap bigger;
+    bigger.slots = allocate_slots(new_capacity);
+    bigger.distances.assign(new_capacity, 0);
+    int log2_capacity = 0;
+    while ((size_t(1) << log2_capacity) < new_capacity) {
+      ++log2_capacity;
+    }
+    bigger.shift = 64 - log2_capacity;
+    for (size_t i = 0; i < capacity(); ++i) {
+      if (distances[i] != 0) {
+        bigger.emplace_unique(slots[i].first, std::move(slots[i]));
+      }
+    }
+    swap(bigger);
+  }
+
+  // MODIFIES: this
+  // EFFECTS : Destroys every element and marks every slot empty.
+  void destroy_elements() {
+    for (size_t i = 0; i < capacity() && element_count > 0; ++i) {
+      if (distances[i] != 0) {
+        slots[i].~Pair_type();
+        distances[i] = 0;
+        --element_count;
+      }
+    }
+  }
+};
+
+#endif // UNORDERED_MAP_HPP
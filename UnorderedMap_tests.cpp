@@ -0,0 +1,244 @@
+#include "UnorderedMap.hpp"
+#include "unit_test_framework.hpp"
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// A hash that sends every key to one of a few home slots, so runs get
+// long and wrap around the end of the table
+struct Crowded_hash {
+  size_t operator()(int key) const {
+    return static_cast<size_t>(key % 3);
+  }
+};
+
+// A hash that sends every key to the same home slot
+struct Constant_hash {
+  size_t operator()(int) const {
+    return 0;
+  }
+};
+
+// A value that counts how many times it is constructed
+struct Tracked_value {
+  static int constructions;
+  int value;
+
+  Tracked_value() : value(0) {
+    ++constructions;
+  }
+
+  Tracked_value(int value_in) : value(value_in) {
+    ++constructions;
+  }
+
+  Tracked_value(const Tracked_value &other) : value(other.value) {
+    ++constructions;
+  }
+
+  Tracked_value(Tracked_value &&other) noexcept = default;
+  Tracked_value &operator=(const Tracked_value &) = default;
+  Tracked_value &operator=(Tracked_value &&) noexcept = default;
+};
+
+int Tracked_value::constructions = 0;
+
+// EFFECTS: Returns whether map holds exactly the elements of expected.
+template <typename Map_type>
+bool same_elements(const Map_type &map, const std::map<int, int> &expected) {
+  size_t seen = 0;
+  for (const auto &entry : map) {
+    auto it = expected.find(entry.first);
+    if (it == expected.end() || it->second != entry.second) {
+      return false;
+    }
+    ++seen;
+  }
+  return seen == expected.size() && map.size() == expected.size();
+}
+
+TEST(empty_map) {
+  UnorderedMap<int, int> map;
+  ASSERT_TRUE(map.empty());
+  ASSERT_EQUAL(map.size(), 0);
+  ASSERT_EQUAL(map.capacity(), 0);
+  ASSERT_TRUE(map.begin() == map.end());
+  ASSERT_TRUE(map.find(3) == map.end());
+  ASSERT_FALSE(map.contains(3));
+  ASSERT_EQUAL(map.count(3), 0);
+  ASSERT_EQUAL(map.erase(3), 0);
+  map.clear();
+  ASSERT_TRUE(map.empty());
+}
+
+TEST(count_words) {
+  UnorderedMap<std::string, int> counts;
+  std::vector<std::string> words = {"the", "cat", "sat", "on", "the",
+                                    "mat", "the", "end"};
+  for (const std::string &word : words) {
+    ++counts[word];
+  }
+  ASSERT_EQUAL(counts.size(), 6);
+  ASSERT_EQUAL(counts["the"], 3);
+  ASSERT_EQUAL(counts.find("cat")->second, 1);
+  ASSERT_TRUE(counts.find("dog") == counts.end());
+  ASSERT_EQUAL(counts.size(), 6);
+
+  int total = 0;
+  for (const auto &entry : counts) {
+    total += entry.second;
+  }
+  ASSERT_EQUAL(total, 8);
+}
+
+TEST(insert_try_emplace_and_insert_or_assign) {
+  UnorderedMap<std::string, Tracked_value> map;
+  auto result = map.insert({"a", 1});
+  ASSERT_TRUE(result.second);
+  ASSERT_EQUAL(result.first->second.value, 1);
+  result = map.insert({"a", 2});
+  ASSERT_FALSE(result.second);
+  ASSERT_EQUAL(result.first->second.value, 1);
+
+  Tracked_value::constructions = 0;
+  result = map.try_emplace("a", 3);
+  ASSERT_FALSE(result.second);
+  ASSERT_EQUAL(Tracked_value::constructions, 0);
+  ASSERT_EQUAL(map["a"].value, 1);
+  ASSERT_EQUAL(Tracked_value::constructions, 0);
+  result = map.try_emplace("b", 4);
+  ASSERT_TRUE(result.second);
+  ASSERT_EQUAL(result.first->second.value, 4);
+  ASSERT_EQUAL(Tracked_value::constructions, 1);
+
+  ASSERT_FALSE(map.insert_or_assign("b", 5).second);
+  ASSERT_EQUAL(map["b"].value, 5);
+  ASSERT_TRUE(map.insert_or_assign("c", 6).second);
+  ASSERT_EQUAL(map.size(), 3);
+}
+
+TEST(growth_keeps_every_element) {
+  UnorderedMap<int, int> map;
+  std::map<int, int> expected;
+  for (int i = 0; i < 20000; ++i) {
+    map[i * 16] = i;
+    expected[i * 16] = i;
+  }
+  ASSERT_TRUE(same_elements(map, expected));
+  ASSERT_EQUAL(map.capacity(), 32768);
+  for (int i = 0; i < 20000; ++i) {
+    ASSERT_EQUAL(map.find(i * 16)->second, i);
+    ASSERT_FALSE(map.contains(i * 16 + 1));
+  }
+}
+
+TEST(reserve_avoids_growth) {
+  UnorderedMap<int, int> map;
+  map.reserve(1000);
+  size_t capacity = map.capacity();
+  ASSERT_EQUAL(capacity, 2048);
+  for (int i = 0; i < 1000; ++i) {
+    map[i] = i;
+  }
+  ASSERT_EQUAL(map.capacity(), capacity);
+  map.reserve(10);
+  ASSERT_EQUAL(map.capacity(), capacity);
+  map.clear();
+  ASSERT_TRUE(map.empty());
+  ASSERT_EQUAL(map.capacity(), capacity);
+  ASSERT_FALSE(map.contains(5));
+}
+
+TEST(erase_shifts_runs_back) {
+  // keys crowd into three home slots, so erasing from the middle of a
+  // run has to move the rest of it
+  UnorderedMap<int, int, Crowded_hash> map;
+  std::map<int, int> expected;
+  for (int i = 0; i < 200; ++i) {
+    map[i] = -i;
+    expected[i] = -i;
+  }
+  ASSERT_TRUE(same_elements(map, expected));
+  for (int i = 0; i < 200; i += 3) {
+    ASSERT_EQUAL(map.erase(i), 1);
+    expected.erase(i);
+    ASSERT_EQUAL(map.erase(i), 0);
+  }
+  ASSERT_TRUE(same_elements(map, expected));
+  for (int i = 0; i < 200; ++i) {
+    ASSERT_EQUAL(map.contains(i), i % 3 != 0);
+  }
+}
+
+TEST(random_operations_match_std_map) {
+  UnorderedMap<int, int> map;
+  std::map<int, int> expected;
+  std::mt19937 rng(280);
+  for (int step = 0; step < 50000; ++step) {
+    int key = static_cast<int>(rng() % 2000);
+    switch (rng() % 3) {
+    case 0:
+      map[key] += step;
+      expected[key] += step;
+      break;
+    case 1:
+      ASSERT_EQUAL(map.erase(key), expected.erase(key));
+      break;
+    default:
+      ASSERT_EQUAL(map.count(key), expected.count(key));
+    }
+  }
+  ASSERT_TRUE(same_elements(map, expected));
+}
+
+TEST(copy_move_and_swap) {
+  UnorderedMap<std::string, int> map;
+  for (int i = 0; i < 100; ++i) {
+    map["k" + std::to_string(i)] = i;
+  }
+  UnorderedMap<std::string, int> copy(map);
+  map.erase("k5");
+  ASSERT_EQUAL(copy.size(), 100);
+  ASSERT_EQUAL(copy["k5"], 5);
+
+  UnorderedMap<std::string, int> moved(std::move(copy));
+  ASSERT_EQUAL(moved.size(), 100);
+  ASSERT_TRUE(copy.empty());
+  ASSERT_TRUE(copy.begin() == copy.end());
+  copy["x"] = 1;
+  ASSERT_EQUAL(copy.size(), 1);
+
+  copy = moved;
+  ASSERT_EQUAL(copy.size(), 100);
+  moved = std::move(map);
+  ASSERT_EQUAL(moved.size(), 99);
+  ASSERT_FALSE(moved.contains("k5"));
+
+  moved.swap(copy);
+  ASSERT_EQUAL(moved.size(), 100);
+  ASSERT_EQUAL(copy.size(), 99);
+}
+
+TEST(too_many_equal_hashes_throw) {
+  UnorderedMap<int, int, Constant_hash> map;
+  bool threw = false;
+  int inserted = 0;
+  try {
+    for (; inserted < 1000; ++inserted) {
+      map[inserted] = inserted;
+    }
+  }
+  catch (const std::length_error &) {
+    threw = true;
+  }
+  ASSERT_TRUE(threw);
+  // the keys inserted before the error are all still there
+  ASSERT_EQUAL(map.size(), inserted);
+  for (int i = 0; i < inserted; ++i) {
+    ASSERT_EQUAL(map.find(i)->second, i);
+  }
+}
+
+TEST_MAIN()
@@ -7,6 +7,7 @@
 #include <sstream>
 #include <string.h>
 #include "csvstream.hpp"
+#include "Map.hpp"
 #include <map>
 #include <set>
 #include <cmath>
@@ -60,11 +61,11 @@ private:
   set <string> words;
   bool debug;
 
-  map<string, int> num_posts_with_word;
+  Map<string, int> num_posts_with_word;
 
-  map<string, int> num_posts_with_label;
+  Map<string, int> num_posts_with_label;
 
-  map<pair<string, string>, int> num_posts_with_label_with_word;
+  Map<pair<string, string>, int> num_posts_with_label_with_word;
 
 public:
 
@@ -177,6 +178,18 @@ pair<string, double> calc_prob(const string &content) const{
     return {best_label, max_prob};
   }
 
+//OVERVIEW: This function prints the memory used by each map of the model
+//          and the shape of its tree
+  void print_memory_usage() const{
+    cout << "memory usage:" << '\n';
+    cout << "num_posts_with_word:" << '\n'
+         << num_posts_with_word.memory_usage() << '\n';
+    cout << "num_posts_with_label:" << '\n'
+         << num_posts_with_label.memory_usage() << '\n';
+    cout << "num_posts_with_label_with_word:" << '\n'
+         << num_posts_with_label_with_word.memory_usage() << '\n';
+  }
+
 private:
 
 //OVERVIEW: This function counts the number of words in the content
@@ -285,6 +298,11 @@ public:
      " posts predicted correctly" << '\n';
 }
 
+//OVERVIEW: This function prints the memory used by the trained model
+  void print_memory_usage() const{
+    model.print_memory_usage();
+  }
+
 
 
 };
@@ -294,22 +312,32 @@ int main(int argc, char* argv[]){
     cout.precision(3);
 
     bool debug = false;
+    bool memory = false;
 
     string testfile;
     string trainfile;
 
-    if(argc != 3 && argc != 4){
-      cout << "Usage: main.exe TRAIN_FILE TEST_FILE [--debug]" << endl;
+    if(argc < 3 || argc > 5){
+      cout << "Usage: main.exe TRAIN_FILE TEST_FILE [--debug] [--memory]"
+           << endl;
       return 10086;
     }
 
     if(argc == 4 && !strcmp(argv[3], " --debug")){
-      cout << "Usage: main.exe TRAIN_FILE TEST_FILE [--debug]" << endl;
+      cout << "Usage: main.exe TRAIN_FILE TEST_FILE [--debug] [--memory]"
+           << endl;
       return 10086;
     }
-    
-    if(argc == 4){
-      debug = true;
+
+    // --memory prints the memory used by the model after testing; any
+    // other option turns on debug output
+    for(int i = 3; i < argc; ++i){
+      if(!strcmp(argv[i], "--memory")){
+        memory = true;
+      }
+      else{
+        debug = true;
+      }
     }
     
     trainfile = argv[1];
@@ -331,5 +359,8 @@ int main(int argc, char* argv[]){
 
     Alex.train();
     Alex.test();
+    if(memory){
+      Alex.print_memory_usage();
+    }
 
 }
\ No newline at end of file